@@ -1,4 +1,5 @@
 #include "allocations_checker.h"
+#include "backend.h"
 
 #include <atomic>
 #include <new>
@@ -30,6 +31,14 @@ void ResetCounters() {
     deallocations_count.store(0);
 }
 
+const char* BackendName() {
+#ifdef HAS_SANITIZER
+    return "sanitizer";
+#else
+    return backend::kName;
+#endif
+}
+
 }  // namespace alloc_checker
 
 void MallocHook(const volatile void*, size_t) {
@@ -50,46 +59,46 @@ void FreeHook(const volatile void*) {
 }();
 #else
 void* operator new(size_t size) {
-    void* p = malloc(size);
+    void* p = alloc_checker::backend::Allocate(size);
     MallocHook(p, size);
     return p;
 }
 
 void* operator new(size_t size, const std::nothrow_t&) noexcept {
-    void* p = malloc(size);
+    void* p = alloc_checker::backend::Allocate(size);
     MallocHook(p, size);
     return p;
 }
 
 void* operator new[] (size_t size) {
-    void* p = malloc(size);
+    void* p = alloc_checker::backend::Allocate(size);
     MallocHook(p, size);
     return p;
 }
 
 void* operator new[] (size_t size, const std::nothrow_t&) noexcept {
-    void* p = malloc(size);
+    void* p = alloc_checker::backend::Allocate(size);
     MallocHook(p, size);
     return p;
 }
 
 void operator delete(void* p) noexcept {
     FreeHook(p);
-    free(p);
+    alloc_checker::backend::Free(p);
 }
 
 void operator delete(void* p, size_t) noexcept {
     FreeHook(p);
-    free(p);
+    alloc_checker::backend::Free(p);
 }
 
 void operator delete[] (void* p) noexcept {
     FreeHook(p);
-    free(p);
+    alloc_checker::backend::Free(p);
 }
 
 void operator delete[] (void* p, size_t) noexcept {
     FreeHook(p);
-    free(p);
+    alloc_checker::backend::Free(p);
 }
 #endif
@@ -10,6 +10,9 @@ std::size_t DeallocCount();
 
 void ResetCounters();
 
+// Allocator behind the replaced operator new ("malloc", "size_class" or "bump").
+const char* BackendName();
+
 }  // namespace alloc_checker
 
 #define EXPECT_ZERO_ALLOCATIONS(X)                     \
@@ -0,0 +1,205 @@
+#pragma once
+
+// Memory source behind the replaced operator new, selected at compile time:
+//   ALLOCATIONS_CHECKER_BACKEND_MALLOC      - plain malloc/free (default)
+//   ALLOCATIONS_CHECKER_BACKEND_SIZE_CLASS  - thread-caching size-class allocator
+//   ALLOCATIONS_CHECKER_BACKEND_BUMP        - bump allocation, free is a no-op
+// Only included by allocations_checker.cpp.
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include <stdlib.h>
+
+namespace alloc_checker::backend {
+
+#if defined(ALLOCATIONS_CHECKER_BACKEND_SIZE_CLASS)
+
+inline const char* const kName = "size_class";
+
+// Small blocks carry a 16-byte header with their size class and are recycled
+// through per-thread free lists; blocks above kMaxSmall go straight to malloc.
+constexpr size_t kHeader = 16;
+constexpr size_t kGranule = 16;
+constexpr size_t kMaxSmall = 1024;
+constexpr size_t kNumClasses = kMaxSmall / kGranule;
+constexpr size_t kLargeClass = kNumClasses;
+constexpr size_t kMaxCached = 64;
+constexpr size_t kChunkBytes = size_t{1} << 16;
+
+struct FreeBlock {
+    FreeBlock* next;
+};
+
+struct Central {
+    std::mutex mutex;
+    FreeBlock* lists[kNumClasses] = {};
+    char* chunk = nullptr;
+    char* chunk_end = nullptr;
+
+    // Moves up to `count` blocks of `cls` into `out`; returns the number moved.
+    size_t Take(size_t cls, FreeBlock*& out, size_t count) {
+        std::lock_guard lock(mutex);
+        size_t block = kHeader + (cls + 1) * kGranule;
+        size_t taken = 0;
+        for (; taken < count; ++taken) {
+            FreeBlock* head = lists[cls];
+            if (head) {
+                lists[cls] = head->next;
+            } else {
+                if (!chunk || chunk + block > chunk_end) {
+                    chunk = static_cast<char*>(malloc(kChunkBytes));
+                    if (!chunk) {
+                        break;
+                    }
+                    chunk_end = chunk + kChunkBytes;
+                }
+                *reinterpret_cast<size_t*>(chunk) = cls;
+                head = reinterpret_cast<FreeBlock*>(chunk + kHeader);
+                chunk += block;
+            }
+            head->next = out;
+            out = head;
+        }
+        return taken;
+    }
+
+    void Put(size_t cls, FreeBlock* first, FreeBlock* last) {
+        std::lock_guard lock(mutex);
+        last->next = lists[cls];
+        lists[cls] = first;
+    }
+};
+
+inline Central central;
+
+struct ThreadCache {
+    ~ThreadCache() {
+        for (size_t cls = 0; cls < kNumClasses; ++cls) {
+            Release(cls, counts[cls]);
+        }
+        dead = true;
+    }
+
+    // Returns `count` blocks from the top of the list to the central lists.
+    void Release(size_t cls, size_t count) {
+        if (!count) {
+            return;
+        }
+        FreeBlock* first = lists[cls];
+        FreeBlock* last = first;
+        for (size_t i = 1; i < count; ++i) {
+            last = last->next;
+        }
+        lists[cls] = last->next;
+        counts[cls] -= count;
+        central.Put(cls, first, last);
+    }
+
+    FreeBlock* lists[kNumClasses] = {};
+    size_t counts[kNumClasses] = {};
+    bool dead = false;
+};
+
+inline thread_local ThreadCache cache;
+
+inline void* Allocate(size_t size) {
+    if (size > kMaxSmall) {
+        auto* raw = static_cast<char*>(malloc(kHeader + size));
+        if (!raw) {
+            return nullptr;
+        }
+        *reinterpret_cast<size_t*>(raw) = kLargeClass;
+        return raw + kHeader;
+    }
+    size_t cls = size ? (size - 1) / kGranule : 0;
+    if (cache.dead) {
+        FreeBlock* block = nullptr;
+        return central.Take(cls, block, 1) ? block : nullptr;
+    }
+    if (!cache.lists[cls]) {
+        cache.counts[cls] += central.Take(cls, cache.lists[cls], kMaxCached / 2);
+        if (!cache.lists[cls]) {
+            return nullptr;
+        }
+    }
+    FreeBlock* block = cache.lists[cls];
+    cache.lists[cls] = block->next;
+    --cache.counts[cls];
+    return block;
+}
+
+inline void Free(void* p) {
+    if (!p) {
+        return;
+    }
+    char* raw = static_cast<char*>(p) - kHeader;
+    size_t cls = *reinterpret_cast<size_t*>(raw);
+    if (cls == kLargeClass) {
+        free(raw);
+        return;
+    }
+    auto* block = static_cast<FreeBlock*>(p);
+    if (cache.dead) {
+        central.Put(cls, block, block);
+        return;
+    }
+    block->next = cache.lists[cls];
+    cache.lists[cls] = block;
+    if (++cache.counts[cls] > kMaxCached) {
+        cache.Release(cls, kMaxCached / 2);
+    }
+}
+
+#elif defined(ALLOCATIONS_CHECKER_BACKEND_BUMP)
+
+inline const char* const kName = "bump";
+
+// Each thread carves 16-byte aligned blocks out of its own 1 MiB chunks.
+// Nothing is ever reused, so this measures the cost of the code under test alone.
+constexpr size_t kAlign = 16;
+constexpr size_t kChunkBytes = size_t{1} << 20;
+
+struct BumpChunk {
+    char* current = nullptr;
+    char* end = nullptr;
+};
+
+inline thread_local BumpChunk chunk;
+
+inline void* Allocate(size_t size) {
+    size = size ? (size + kAlign - 1) / kAlign * kAlign : kAlign;
+    if (size > kChunkBytes / 4) {
+        return malloc(size);
+    }
+    if (!chunk.current || chunk.current + size > chunk.end) {
+        chunk.current = static_cast<char*>(malloc(kChunkBytes));
+        if (!chunk.current) {
+            return nullptr;
+        }
+        chunk.end = chunk.current + kChunkBytes;
+    }
+    void* p = chunk.current;
+    chunk.current += size;
+    return p;
+}
+
+inline void Free(void*) {
+}
+
+#else
+
+inline const char* const kName = "malloc";
+
+inline void* Allocate(size_t size) {
+    return malloc(size);
+}
+
+inline void Free(void* p) {
+    free(p);
+}
+
+#endif
+
+}  // namespace alloc_checker::backend
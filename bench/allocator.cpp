@@ -0,0 +1,73 @@
+#include "bench.h"
+
+#include <allocations_checker.h>
+#include <intrusive/intrusive.h>
+#include <shared-from-this/shared.h>
+#include <shared-from-this/weak.h>
+#include <unique/unique.h>
+
+#include <string>
+#include <vector>
+
+// Allocation-heavy pointer workloads. The same source is linked against every
+// allocations_checker backend (bench_allocator_<backend>), so the difference
+// between the binaries is the allocator and the rest is the library itself.
+// Usage: bench_allocator_<backend> [iterations] [live_objects]
+
+namespace {
+
+struct Counted : SimpleRefCounted<Counted> {
+    Counted(int value) : value{value} {
+    }
+
+    int value;
+};
+
+template <typename F>
+void Measure(const char* name, size_t iterations, F&& body) {
+    size_t allocations = alloc_checker::AllocCount();
+    bench::Run(name, iterations, body);
+    allocations = alloc_checker::AllocCount() - allocations;
+    std::printf("%-48s %12.2f allocations/op\n", "", static_cast<double>(allocations) / iterations);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t iterations = bench::SizeArg(argc, argv, 1, 10'000'000);
+    const size_t live = bench::SizeArg(argc, argv, 2, 1024);
+    std::printf("backend: %s\n", alloc_checker::BackendName());
+
+    Measure("UniquePtr(new int) churn", iterations, [&] {
+        std::vector<UniquePtr<int>> slots(live);
+        for (size_t i = 0; i < iterations; ++i) {
+            slots[i % live].Reset(new int(i));
+        }
+    });
+    Measure("SharedPtr(new int) churn", iterations, [&] {
+        std::vector<SharedPtr<int>> slots(live);
+        for (size_t i = 0; i < iterations; ++i) {
+            slots[i % live].Reset(new int(i));
+        }
+    });
+    Measure("MakeShared<std::string> churn", iterations, [&] {
+        std::vector<SharedPtr<std::string>> slots(live);
+        for (size_t i = 0; i < iterations; ++i) {
+            slots[i % live] = MakeShared<std::string>("short");
+        }
+    });
+    Measure("MakeShared + WeakPtr churn", iterations, [&] {
+        std::vector<WeakPtr<int>> weak(live);
+        for (size_t i = 0; i < iterations; ++i) {
+            auto sp = MakeShared<int>(i);
+            weak[i % live] = sp;
+        }
+    });
+    Measure("MakeIntrusive churn", iterations, [&] {
+        std::vector<IntrusivePtr<Counted>> slots(live);
+        for (size_t i = 0; i < iterations; ++i) {
+            slots[i % live] = MakeIntrusive<Counted>(i);
+        }
+    });
+    return 0;
+}
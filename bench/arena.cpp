@@ -0,0 +1,120 @@
+#include "bench.h"
+
+#include <common/arena.h>
+#include <intrusive/intrusive.h>
+#include <shared-from-this/shared.h>
+
+#include <random>
+#include <vector>
+
+// Random walks over a large pointer graph whose nodes come from the global heap,
+// from an arena on regular pages and from an arena backed by huge pages.
+// Usage: bench_arena [num_nodes] [num_steps]
+
+namespace {
+
+constexpr size_t kDegree = 4;
+
+struct SharedNode {
+    SharedPtr<SharedNode> edges[kDegree];
+    uint64_t value = 0;
+};
+
+template <typename Deleter>
+struct IntrusiveNode : RefCounted<IntrusiveNode<Deleter>, SimpleCounter, Deleter> {
+    IntrusivePtr<IntrusiveNode> edges[kDegree];
+    uint64_t value = 0;
+};
+
+template <typename Node>
+void Connect(std::vector<Node>& nodes) {
+    std::mt19937_64 rng{1};
+    for (auto& node : nodes) {
+        node->value = rng() % 100;
+        for (auto& edge : node->edges) {
+            edge = nodes[rng() % nodes.size()];
+        }
+    }
+}
+
+template <typename Node>
+void Walk(const char* name, std::vector<Node>& nodes, size_t steps) {
+    bench::Run(name, steps, [&] {
+        uint64_t sum = 0;
+        uint64_t state = 88172645463325252ull;
+        auto* node = nodes[0].Get();
+        for (size_t i = 0; i < steps; ++i) {
+            sum += node->value;
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            node = node->edges[state % kDegree].Get();
+        }
+        bench::DoNotOptimize(sum);
+    });
+    for (auto& node : nodes) {
+        for (auto& edge : node->edges) {
+            edge.Reset();
+        }
+    }
+}
+
+void RunShared(const char* name, size_t num_nodes, size_t steps, HugePageArena* arena) {
+    std::vector<SharedPtr<SharedNode>> nodes;
+    nodes.reserve(num_nodes);
+    std::vector<SharedPtr<std::vector<char>>> noise;
+    for (size_t i = 0; i < num_nodes; ++i) {
+        if (arena) {
+            nodes.push_back(AllocateShared<SharedNode>(ArenaAllocator<SharedNode>(*arena)));
+        } else {
+            nodes.push_back(MakeShared<SharedNode>());
+            // Unrelated allocations interleave with the graph, as in a real heap.
+            noise.push_back(MakeShared<std::vector<char>>(i % 7 * 16));
+        }
+    }
+    Connect(nodes);
+    Walk(name, nodes, steps);
+}
+
+template <typename Deleter>
+void RunIntrusive(const char* name, size_t num_nodes, size_t steps) {
+    std::vector<IntrusivePtr<IntrusiveNode<Deleter>>> nodes;
+    nodes.reserve(num_nodes);
+    for (size_t i = 0; i < num_nodes; ++i) {
+        nodes.push_back(MakeIntrusive<IntrusiveNode<Deleter>>());
+    }
+    Connect(nodes);
+    Walk(name, nodes, steps);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t num_nodes = bench::SizeArg(argc, argv, 1, 4'000'000);
+    const size_t steps = bench::SizeArg(argc, argv, 2, 20'000'000);
+
+    RunShared("SharedPtr graph: global heap", num_nodes, steps, nullptr);
+    {
+        HugePageArena arena(false);
+        RunShared("SharedPtr graph: arena, 4 KiB pages", num_nodes, steps, &arena);
+    }
+    {
+        HugePageArena arena(true);
+        RunShared("SharedPtr graph: arena, huge pages", num_nodes, steps, &arena);
+        std::printf("  %zu of %zu chunks accepted MADV_HUGEPAGE\n", arena.HugePageChunkCount(),
+                    arena.ChunkCount());
+    }
+
+    RunIntrusive<DefaultDelete>("IntrusivePtr graph: global heap", num_nodes, steps);
+    {
+        HugePageArena arena(false);
+        ArenaScope scope(arena);
+        RunIntrusive<ArenaDelete>("IntrusivePtr graph: arena, 4 KiB pages", num_nodes, steps);
+    }
+    {
+        HugePageArena arena(true);
+        ArenaScope scope(arena);
+        RunIntrusive<ArenaDelete>("IntrusivePtr graph: arena, huge pages", num_nodes, steps);
+    }
+    return 0;
+}
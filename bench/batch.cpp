@@ -0,0 +1,103 @@
+#include "bench.h"
+
+#include <allocations_checker.h>
+#include <core/batch.h>
+
+#include <malloc.h>
+
+#include <cstdint>
+#include <vector>
+
+// "Parsed messages": `messages` groups of `nodes` small objects that live and die
+// together. Each node is either its own MakeShared allocation or an element of
+// one MakeSharedBatch per message. Reports allocations, heap bytes in use
+// (glibc mallinfo2) and the time to build, walk and free everything.
+// Usage: bench_batch [messages] [nodes]
+
+namespace {
+
+struct Node {
+    uint32_t tag;
+    uint32_t length;
+    uint64_t offset;
+};
+
+size_t HeapInUse() {
+    return mallinfo2().uordblks;
+}
+
+template <typename Build, typename Walk>
+void Measure(const char* name, size_t messages, size_t nodes, Build build, Walk walk) {
+    std::printf("%s\n", name);
+    size_t heap = HeapInUse();
+    size_t allocations = alloc_checker::AllocCount();
+    auto all = build();
+    allocations = alloc_checker::AllocCount() - allocations;
+    heap = HeapInUse() - heap;
+    std::printf("  %.2f allocations and %.1f heap bytes per node\n",
+                static_cast<double>(allocations) / (messages * nodes),
+                static_cast<double>(heap) / (messages * nodes));
+
+    uint64_t sum = 0;
+    bench::Run("  walk", messages * nodes, [&] {
+        for (int round = 0; round < 10; ++round) {
+            sum += walk(all);
+        }
+    });
+    bench::DoNotOptimize(sum);
+    bench::Run("  free", messages * nodes, [&] { all.clear(); });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t messages = bench::SizeArg(argc, argv, 1, 20'000);
+    const size_t nodes = bench::SizeArg(argc, argv, 2, 50);
+
+    Measure(
+        "MakeShared per node", messages, nodes,
+        [&] {
+            std::vector<std::vector<SharedPtr<Node>>> all(messages);
+            bench::Run("  build", messages * nodes, [&] {
+                for (auto& message : all) {
+                    message.reserve(nodes);
+                    for (size_t i = 0; i < nodes; ++i) {
+                        message.push_back(MakeShared<Node>(Node{uint32_t(i), 1, i}));
+                    }
+                }
+            });
+            return all;
+        },
+        [](const auto& all) {
+            uint64_t sum = 0;
+            for (const auto& message : all) {
+                for (const auto& node : message) {
+                    sum += node->offset + node->length;
+                }
+            }
+            return sum;
+        });
+
+    Measure(
+        "MakeSharedBatch per message", messages, nodes,
+        [&] {
+            std::vector<SharedBatch<Node>> all(messages);
+            bench::Run("  build", messages * nodes, [&] {
+                for (auto& message : all) {
+                    message = MakeSharedBatch<Node>(
+                        nodes, [](size_t i) { return Node{uint32_t(i), 1, i}; });
+                }
+            });
+            return all;
+        },
+        [](const auto& all) {
+            uint64_t sum = 0;
+            for (const auto& message : all) {
+                for (const auto& node : message) {
+                    sum += node.offset + node.length;
+                }
+            }
+            return sum;
+        });
+    return 0;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "perf_counters.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+namespace bench {
+
+// Prevents the compiler from optimizing away a computed value.
+template <typename T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+class Timer {
+public:
+    Timer() : start_(std::chrono::steady_clock::now()) {
+    }
+
+    double ElapsedNs() const {
+        auto elapsed = std::chrono::steady_clock::now() - start_;
+        return std::chrono::duration<double, std::nano>(elapsed).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Runs `body` once and prints total time and time per operation, followed by
+// the per-operation counters if there are any (see PerfCounters).
+template <typename F>
+double Run(const char* name, size_t ops, F&& body) {
+    PerfCounters& counters = PerfCounters::Instance();
+    counters.Start();
+    Timer timer;
+    body();
+    double ns = timer.ElapsedNs();
+    counters.Stop();
+    std::printf("%-48s %12.3f ms %10.2f ns/op\n", name, ns / 1e6, ops ? ns / ops : 0.0);
+    counters.Print(ops);
+    return ns;
+}
+
+// Reads a size from argv[index] or returns the default value.
+inline size_t SizeArg(int argc, char** argv, int index, size_t default_value) {
+    if (index < argc) {
+        return std::strtoull(argv[index], nullptr, 10);
+    }
+    return default_value;
+}
+
+// Peak resident set size in KiB (VmHWM), or 0 where /proc is not available.
+inline size_t PeakRssKb() {
+    FILE* status = std::fopen("/proc/self/status", "r");
+    if (!status) {
+        return 0;
+    }
+    char line[256];
+    size_t kb = 0;
+    while (std::fgets(line, sizeof(line), status)) {
+        if (std::sscanf(line, "VmHWM: %zu kB", &kb) == 1) {
+            break;
+        }
+    }
+    std::fclose(status);
+    return kb;
+}
+
+// Restarts the peak at the current RSS (Linux 4.0+); false if not supported.
+inline bool ResetPeakRss() {
+    FILE* clear_refs = std::fopen("/proc/self/clear_refs", "w");
+    if (!clear_refs) {
+        return false;
+    }
+    bool ok = std::fputs("5", clear_refs) >= 0;
+    return std::fclose(clear_refs) == 0 && ok;
+}
+
+}  // namespace bench
@@ -0,0 +1,78 @@
+#include "bench.h"
+
+#include <core/shared.h>
+#include <intrusive/intrusive.h>
+
+#include <cstdint>
+#include <vector>
+
+// Downcasting a pipeline of pointers: each stage casts Base -> Derived and hands
+// the pointer on. Copying casts pay an increment here and a decrement when the
+// source dies; moving casts only transfer the reference.
+// Usage: bench_casts [pointers] [rounds]
+
+namespace {
+
+struct Base {
+    virtual ~Base() = default;
+    uint64_t key = 1;
+};
+
+struct Derived : Base {};
+
+struct IntrusiveBase : AtomicRefCounted<IntrusiveBase> {
+    virtual ~IntrusiveBase() = default;
+    uint64_t key = 1;
+};
+
+struct IntrusiveDerived : IntrusiveBase {};
+
+template <bool Move, typename Ptr, typename Cast>
+void Measure(const char* name, std::vector<Ptr>& pointers, size_t rounds, Cast cast) {
+    uint64_t sum = 0;
+    bench::Run(name, pointers.size() * rounds, [&] {
+        for (size_t round = 0; round < rounds; ++round) {
+            for (auto& ptr : pointers) {
+                if constexpr (Move) {
+                    auto derived = cast(std::move(ptr));
+                    sum += derived->key;
+                    ptr = std::move(derived);
+                } else {
+                    auto derived = cast(ptr);
+                    sum += derived->key;
+                    ptr = derived;
+                }
+            }
+        }
+    });
+    bench::DoNotOptimize(sum);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t count = bench::SizeArg(argc, argv, 1, 100'000);
+    const size_t rounds = bench::SizeArg(argc, argv, 2, 100);
+
+    using Shared = SharedPtr<Base, AtomicCounting>;
+    std::vector<Shared> shared;
+    for (size_t i = 0; i < count; ++i) {
+        shared.push_back(MakeShared<Derived, AtomicCounting>());
+    }
+    auto shared_cast = [](auto&& ptr) {
+        return StaticPointerCast<Derived>(std::forward<decltype(ptr)>(ptr));
+    };
+    Measure<false>("SharedPtr StaticPointerCast(const&)", shared, rounds, shared_cast);
+    Measure<true>("SharedPtr StaticPointerCast(&&)", shared, rounds, shared_cast);
+
+    std::vector<IntrusivePtr<IntrusiveBase>> intrusive;
+    for (size_t i = 0; i < count; ++i) {
+        intrusive.push_back(MakeIntrusive<IntrusiveDerived>());
+    }
+    auto intrusive_cast = [](auto&& ptr) {
+        return StaticPointerCast<IntrusiveDerived>(std::forward<decltype(ptr)>(ptr));
+    };
+    Measure<false>("IntrusivePtr StaticPointerCast(const&)", intrusive, rounds, intrusive_cast);
+    Measure<true>("IntrusivePtr StaticPointerCast(&&)", intrusive, rounds, intrusive_cast);
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "bench.h"
+
+#include <core/shared.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+// Downcasts in a deep single-inheritance chain Level<0> <- Level<1> <- ... <- Level<kDepth>.
+// Objects of random depth are cast to the middle of the chain with dynamic_cast
+// (DynamicPointerCast) and with the class ids stored in the control block
+// (FastPointerCast). About half of the casts fail.
+// Usage: bench_fast_cast [objects] [rounds]
+
+namespace {
+
+constexpr uint32_t kDepth = 8;
+constexpr uint32_t kTarget = kDepth / 2;
+
+template <uint32_t N>
+struct Level : Level<N - 1> {};
+
+template <>
+struct Level<0> {
+    virtual ~Level() = default;
+    uint64_t key = 1;
+};
+
+}  // namespace
+
+// Pre-order numbering of the chain: Level<N> owns ids N+1 .. kDepth+1.
+template <uint32_t N>
+struct ClassIds<Level<N>> : ClassIdRange<N + 1, kDepth + 1> {};
+
+namespace {
+
+using Policies = StoreClassIds;
+using Root = SharedPtr<Level<0>, Policies>;
+
+template <uint32_t N>
+void Fill(std::vector<Root>& objects, uint32_t depth) {
+    if constexpr (N <= kDepth) {
+        if (depth == N) {
+            objects.push_back(MakeShared<Level<N>, Policies>());
+        } else {
+            Fill<N + 1>(objects, depth);
+        }
+    }
+}
+
+template <typename Cast>
+void Measure(const char* name, const std::vector<Root>& objects, size_t rounds, Cast cast) {
+    uint64_t hits = 0;
+    bench::Run(name, objects.size() * rounds, [&] {
+        for (size_t round = 0; round < rounds; ++round) {
+            for (const auto& object : objects) {
+                if (auto target = cast(object)) {
+                    hits += target->key;
+                }
+            }
+        }
+    });
+    bench::DoNotOptimize(hits);
+    std::printf("  %lu hits\n", static_cast<unsigned long>(hits));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t count = bench::SizeArg(argc, argv, 1, 10'000);
+    const size_t rounds = bench::SizeArg(argc, argv, 2, 1'000);
+
+    std::vector<Root> objects;
+    std::mt19937 rng{3};
+    for (size_t i = 0; i < count; ++i) {
+        Fill<0>(objects, rng() % (kDepth + 1));
+    }
+
+    Measure("DynamicPointerCast to Level<4>", objects, rounds,
+            [](const Root& p) { return DynamicPointerCast<Level<kTarget>>(p); });
+    Measure("FastPointerCast to Level<4>", objects, rounds,
+            [](const Root& p) { return FastPointerCast<Level<kTarget>>(p); });
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "bench.h"
+
+#include <allocations_checker.h>
+#include <intrusive/hash_set.h>
+#include <intrusive/list.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <list>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+// Objects that are already reference counted, kept in a list and in a hash
+// table. The std containers hold an IntrusivePtr per node and allocate that
+// node; the intrusive ones link the objects themselves. Erase goes by object in
+// random order (std::list through a stored iterator, as callers do).
+// Usage: bench_intrusive_containers [objects] [rounds]
+
+namespace {
+
+struct ByOrder;
+struct ById;
+
+struct Object : SimpleRefCounted<Object>, ListHook<ByOrder>, HashSetHook<ById> {
+    explicit Object(uint64_t id) : id(id) {
+    }
+
+    uint64_t id;
+    uint64_t payload = 1;
+    std::list<IntrusivePtr<Object>>::iterator position;
+};
+
+using Objects = std::vector<IntrusivePtr<Object>>;
+
+template <typename Insert, typename Iterate, typename Erase>
+void Measure(const char* name, const Objects& objects, const Objects& shuffled, size_t rounds, Insert insert,
+             Iterate iterate, Erase erase) {
+    std::printf("%s\n", name);
+    const size_t n = objects.size();
+    size_t allocations = alloc_checker::AllocCount();
+    bench::Run("  insert", n, [&] {
+        for (const auto& object : objects) {
+            insert(object);
+        }
+    });
+    std::printf("  %.2f allocations per element\n",
+                static_cast<double>(alloc_checker::AllocCount() - allocations) / n);
+
+    uint64_t sum = 0;
+    bench::Run("  iterate", n * rounds, [&] {
+        for (size_t round = 0; round < rounds; ++round) {
+            sum += iterate();
+        }
+    });
+    bench::DoNotOptimize(sum);
+
+    bench::Run("  erase", n, [&] {
+        for (const auto& object : shuffled) {
+            erase(*object);
+        }
+    });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t count = bench::SizeArg(argc, argv, 1, 1'000'000);
+    const size_t rounds = bench::SizeArg(argc, argv, 2, 10);
+
+    Objects objects;
+    for (size_t i = 0; i < count; ++i) {
+        objects.push_back(MakeIntrusive<Object>(i * 0x9E3779B97F4A7C15ull));
+    }
+    Objects shuffled = objects;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937_64(42));
+
+    {
+        std::list<IntrusivePtr<Object>> list;
+        Measure(
+            "std::list<IntrusivePtr>", objects, shuffled, rounds,
+            [&](const auto& object) { object->position = list.insert(list.end(), object); },
+            [&] {
+                uint64_t sum = 0;
+                for (const auto& object : list) {
+                    sum += object->payload;
+                }
+                return sum;
+            },
+            [&](Object& object) { list.erase(object.position); });
+    }
+    {
+        IntrusiveList<Object, ByOrder> list;
+        Measure(
+            "IntrusiveList", objects, shuffled, rounds, [&](const auto& object) { list.PushBack(object); },
+            [&] {
+                uint64_t sum = 0;
+                for (const auto& object : list) {
+                    sum += object.payload;
+                }
+                return sum;
+            },
+            [&](Object& object) { list.Erase(object); });
+    }
+    {
+        std::unordered_map<uint64_t, IntrusivePtr<Object>> map;
+        Measure(
+            "std::unordered_map<id, IntrusivePtr>", objects, shuffled, rounds,
+            [&](const auto& object) { map.emplace(object->id, object); },
+            [&] {
+                uint64_t sum = 0;
+                for (const auto& [id, object] : map) {
+                    sum += object->payload;
+                }
+                return sum;
+            },
+            [&](Object& object) { map.erase(object.id); });
+    }
+    {
+        IntrusiveHashSet<Object, &Object::id, ById> set;
+        Measure(
+            "IntrusiveHashSet", objects, shuffled, rounds, [&](const auto& object) { set.Insert(object); },
+            [&] {
+                uint64_t sum = 0;
+                for (const auto& object : set) {
+                    sum += object.payload;
+                }
+                return sum;
+            },
+            [&](Object& object) { set.Erase(object); });
+    }
+    return 0;
+}
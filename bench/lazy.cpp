@@ -0,0 +1,65 @@
+#include "bench.h"
+
+#include <shared-from-this/lazy.h>
+
+#include <cmath>
+#include <deque>
+#include <vector>
+
+// Startup latency of N expensive resources when only a fraction is used.
+// Usage: bench_lazy [num_resources] [table_size] [used_every]
+
+namespace {
+
+std::vector<double> BuildTable(size_t size) {
+    std::vector<double> table(size);
+    for (size_t i = 0; i < size; ++i) {
+        table[i] = std::sqrt(static_cast<double>(i));
+    }
+    return table;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t num_resources = bench::SizeArg(argc, argv, 1, 1000);
+    const size_t table_size = bench::SizeArg(argc, argv, 2, 10000);
+    const size_t used_every = bench::SizeArg(argc, argv, 3, 10);
+
+    bench::Run("eager: construct all", num_resources, [&] {
+        std::vector<SharedPtr<std::vector<double>>> tables;
+        tables.reserve(num_resources);
+        for (size_t i = 0; i < num_resources; ++i) {
+            tables.push_back(MakeShared<std::vector<double>>(BuildTable(table_size)));
+        }
+        double sum = 0;
+        for (size_t i = 0; i < num_resources; i += used_every) {
+            sum += tables[i]->back();
+        }
+        bench::DoNotOptimize(sum);
+    });
+
+    bench::Run("lazy: construct on first use", num_resources, [&] {
+        std::deque<LazySharedPtr<std::vector<double>>> tables;
+        for (size_t i = 0; i < num_resources; ++i) {
+            tables.emplace_back([table_size] { return BuildTable(table_size); });
+        }
+        double sum = 0;
+        for (size_t i = 0; i < num_resources; i += used_every) {
+            sum += tables[i]->back();
+        }
+        bench::DoNotOptimize(sum);
+    });
+
+    LazySharedPtr<std::vector<double>> ready([table_size] { return BuildTable(table_size); });
+    ready.Get();
+    const size_t reads = num_resources * 1000;
+    bench::Run("lazy: steady-state dereference", reads, [&] {
+        double sum = 0;
+        for (size_t i = 0; i < reads; ++i) {
+            sum += ready->front();
+        }
+        bench::DoNotOptimize(sum);
+    });
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "bench.h"
+
+#include <allocations_checker.h>
+#include <core/shared.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+// Create/destroy-heavy use of `SharedPtr(new T)` with the control block made
+// upfront (EagerBlock) or on the first copy (LazyBlock). Three workloads: objects
+// that are only created and destroyed, objects moved into a container and
+// dropped with it, and the worst case for LazyBlock where every object is copied
+// once. Reports time and allocations per object.
+// Usage: bench_lazy_block [objects]
+
+namespace {
+
+struct Node {
+    uint64_t key;
+    uint64_t value;
+};
+
+template <typename Body>
+void Measure(const char* name, size_t ops, Body body) {
+    size_t allocations = alloc_checker::AllocCount();
+    bench::Run(name, ops, body);
+    allocations = alloc_checker::AllocCount() - allocations;
+    std::printf("  %.2f allocations per object\n", static_cast<double>(allocations) / ops);
+}
+
+template <typename Policy>
+void Workloads(const char* policy, size_t objects) {
+    using Ptr = SharedPtr<Node, Policy>;
+    char label[64];
+
+    std::snprintf(label, sizeof(label), "%s: create and destroy", policy);
+    Measure(label, objects, [&] {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < objects; ++i) {
+            Ptr ptr(new Node{i, i});
+            sum += ptr->value;
+        }
+        bench::DoNotOptimize(sum);
+    });
+
+    std::snprintf(label, sizeof(label), "%s: move into a vector", policy);
+    Measure(label, objects, [&] {
+        std::vector<Ptr> all;
+        all.reserve(objects);
+        for (size_t i = 0; i < objects; ++i) {
+            Ptr ptr(new Node{i, i});
+            all.push_back(std::move(ptr));
+        }
+        bench::DoNotOptimize(all.data());
+    });
+
+    std::snprintf(label, sizeof(label), "%s: copy once", policy);
+    Measure(label, objects, [&] {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < objects; ++i) {
+            Ptr ptr(new Node{i, i});
+            Ptr copy = ptr;
+            sum += copy.UseCount();
+        }
+        bench::DoNotOptimize(sum);
+    });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t objects = bench::SizeArg(argc, argv, 1, 1'000'000);
+
+    Workloads<EagerBlock>("EagerBlock", objects);
+    Workloads<LazyBlock>("LazyBlock", objects);
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "bench.h"
+
+#include <intrusive/lock_free.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <thread>
+#include <vector>
+
+// Lock-free containers built on AtomicTaggedIntrusivePtr against their
+// mutex-protected standard counterparts, at 1..N threads.
+//  - stack: every thread pushes and pops in turn;
+//  - set: every thread inserts, looks up and erases keys from a shared range.
+// Usage: bench_lock_free [max threads] [ops per thread] [keys]
+
+namespace {
+
+class MutexStack {
+public:
+    void Push(uint64_t value) {
+        std::lock_guard lock(mutex_);
+        values_.push_back(value);
+    }
+
+    std::optional<uint64_t> Pop() {
+        std::lock_guard lock(mutex_);
+        if (values_.empty()) {
+            return std::nullopt;
+        }
+        uint64_t value = values_.back();
+        values_.pop_back();
+        return value;
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<uint64_t> values_;
+};
+
+class MutexSet {
+public:
+    bool Insert(uint64_t key) {
+        std::lock_guard lock(mutex_);
+        return keys_.insert(key).second;
+    }
+
+    bool Erase(uint64_t key) {
+        std::lock_guard lock(mutex_);
+        return keys_.erase(key);
+    }
+
+    bool Contains(uint64_t key) {
+        std::lock_guard lock(mutex_);
+        return keys_.count(key);
+    }
+
+private:
+    std::mutex mutex_;
+    std::set<uint64_t> keys_;
+};
+
+template <typename Body>
+void RunThreads(const char* name, size_t threads, size_t ops, Body body) {
+    char label[64];
+    std::snprintf(label, sizeof(label), "%s, %zu threads", name, threads);
+    bench::Run(label, threads * ops, [&] {
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back(body, t);
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    });
+}
+
+template <typename Stack>
+void MeasureStack(const char* name, size_t threads, size_t ops) {
+    Stack stack;
+    RunThreads(name, threads, ops, [&](size_t) {
+        uint64_t local = 0;
+        for (size_t i = 0; i < ops / 2; ++i) {
+            stack.Push(i);
+            local += stack.Pop().value_or(0);
+        }
+        bench::DoNotOptimize(local);
+    });
+}
+
+template <typename Set>
+void MeasureSet(const char* name, size_t threads, size_t ops, size_t keys) {
+    Set set;
+    for (uint64_t key = 0; key < keys; key += 2) {
+        set.Insert(key);
+    }
+    RunThreads(name, threads, ops, [&](size_t t) {
+        uint64_t hits = 0;
+        uint64_t key = t * 7919;
+        for (size_t i = 0; i < ops / 4; ++i) {
+            key = (key * 6364136223846793005ull + 1442695040888963407ull) >> 1;
+            uint64_t k = key % keys;
+            hits += set.Insert(k);
+            hits += set.Contains(k ^ 1);
+            hits += set.Contains(k);
+            hits += set.Erase(k);
+        }
+        bench::DoNotOptimize(hits);
+    });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t max_threads = bench::SizeArg(argc, argv, 1, 4);
+    const size_t ops = bench::SizeArg(argc, argv, 2, 200'000);
+    const size_t keys = bench::SizeArg(argc, argv, 3, 256);
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        MeasureStack<TreiberStack<uint64_t>>("TreiberStack push/pop", threads, ops);
+        MeasureStack<MutexStack>("mutex + std::vector push/pop", threads, ops);
+        MeasureSet<HarrisList<uint64_t>>("HarrisList insert/find/erase", threads, ops, keys);
+        MeasureSet<MutexSet>("mutex + std::set insert/find/erase", threads, ops, keys);
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+#include "bench.h"
+
+#include <core/lru_cache.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <list>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Read-mostly cache traffic: every thread looks up skewed keys and fills misses.
+// ShardedLruCache against one mutex around std::list + std::unordered_map that
+// splices the entry to the front on every hit. Reports lookups per second and
+// the hit rate at 1..N threads.
+// Usage: bench_lru_cache [max threads] [lookups per thread] [keys] [capacity]
+
+namespace {
+
+struct Value {
+    uint64_t data[8];
+};
+
+using ValuePtr = SharedPtr<const Value, AtomicCounting>;
+
+class MutexLruCache {
+public:
+    explicit MutexLruCache(size_t capacity) : capacity_(capacity) {
+    }
+
+    ValuePtr Get(uint64_t key) {
+        std::lock_guard lock(mutex_);
+        auto it = index_.find(key);
+        if (it == index_.end()) {
+            return {};
+        }
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return it->second->second;
+    }
+
+    ValuePtr Emplace(uint64_t key, const Value& value) {
+        ValuePtr ptr = MakeShared<Value, AtomicCounting>(value);
+        std::lock_guard lock(mutex_);
+        if (auto it = index_.find(key); it != index_.end()) {
+            it->second->second = ptr;
+            return ptr;
+        }
+        lru_.emplace_front(key, ptr);
+        index_.emplace(key, lru_.begin());
+        if (lru_.size() > capacity_) {
+            index_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+        return ptr;
+    }
+
+private:
+    std::mutex mutex_;
+    size_t capacity_;
+    std::list<std::pair<uint64_t, ValuePtr>> lru_;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, ValuePtr>>::iterator> index_;
+};
+
+template <typename Cache>
+void Measure(const char* name, size_t threads, size_t lookups, size_t keys, size_t capacity) {
+    Cache cache(capacity);
+    std::atomic<uint64_t> hits = 0;
+    char label[64];
+    std::snprintf(label, sizeof(label), "%s, %zu threads", name, threads);
+    double ns = bench::Run(label, threads * lookups, [&] {
+        std::vector<std::thread> workers;
+        for (size_t t = 0; t < threads; ++t) {
+            workers.emplace_back([&, t] {
+                std::mt19937_64 rng(t);
+                std::uniform_real_distribution<double> uniform;
+                uint64_t local_hits = 0;
+                uint64_t sum = 0;
+                for (size_t i = 0; i < lookups; ++i) {
+                    // Cubing skews the keys towards zero: a small hot set and a long tail.
+                    double x = uniform(rng);
+                    auto key = static_cast<uint64_t>(x * x * x * keys);
+                    if (auto value = cache.Get(key)) {
+                        ++local_hits;
+                        sum += value->data[0];
+                    } else {
+                        sum += cache.Emplace(key, Value{{key}})->data[0];
+                    }
+                }
+                bench::DoNotOptimize(sum);
+                hits += local_hits;
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    });
+    std::printf("  %.1f M lookups/s, %.1f%% hits\n", threads * lookups / ns * 1e3,
+                100.0 * hits / (threads * lookups));
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t max_threads = bench::SizeArg(argc, argv, 1, 4);
+    const size_t lookups = bench::SizeArg(argc, argv, 2, 1'000'000);
+    const size_t keys = bench::SizeArg(argc, argv, 3, 200'000);
+    const size_t capacity = bench::SizeArg(argc, argv, 4, 50'000);
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        Measure<ShardedLruCache<uint64_t, Value>>("ShardedLruCache", threads, lookups, keys, capacity);
+        Measure<MutexLruCache>("mutex + std::list LRU", threads, lookups, keys, capacity);
+    }
+    return 0;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+// Counters of the calling thread and the threads it starts meanwhile, read with
+// perf_event_open(2) around a benchmark region: cycles, instructions, cache and
+// branch misses. Without a PMU (VMs, containers, perf_event_paranoid > 2) falls
+// back to software counters, and to none if those fail too. BENCH_COUNTERS=0
+// turns them off.
+class PerfCounters {
+public:
+    enum class Source { kNone, kSoftware, kHardware };
+
+    static constexpr size_t kMaxEvents = 4;
+
+    PerfCounters() {
+        const char* env = std::getenv("BENCH_COUNTERS");
+        if (env && !std::strcmp(env, "0")) {
+            return;
+        }
+#ifdef __linux__
+        static constexpr Event kHardware[] = {
+            {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {"cache misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {"branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+        static constexpr Event kSoftware[] = {
+            {"ns task clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+            {"page faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+            {"context switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+        };
+        // The first event of each set decides whether the set is usable.
+        if (Open(kHardware)) {
+            source_ = Source::kHardware;
+        } else if (Open(kSoftware)) {
+            source_ = Source::kSoftware;
+        }
+#endif
+    }
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (size_t i = 0; i < size_; ++i) {
+            close(events_[i].fd);
+        }
+#endif
+    }
+
+    // Shared by every Run() of the process; says once on stderr what it counts.
+    static PerfCounters& Instance() {
+        static PerfCounters counters;
+        static const bool kReported = [] {
+            static constexpr const char* kSources[] = {"timing only", "software counters",
+                                                       "hardware counters"};
+            std::fprintf(stderr, "perf counters: %s\n", kSources[static_cast<int>(counters.source_)]);
+            return true;
+        }();
+        (void)kReported;
+        return counters;
+    }
+
+    Source GetSource() const {
+        return source_;
+    }
+
+    void Start() {
+#ifdef __linux__
+        for (size_t i = 0; i < size_; ++i) {
+            ioctl(events_[i].fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(events_[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    void Stop() {
+#ifdef __linux__
+        for (size_t i = 0; i < size_; ++i) {
+            ioctl(events_[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+        for (size_t i = 0; i < size_; ++i) {
+            // Scaled up if the kernel multiplexed the event with others.
+            uint64_t read_format[3] = {};
+            if (read(events_[i].fd, read_format, sizeof(read_format)) != sizeof(read_format)) {
+                values_[i] = 0;
+            } else if (read_format[2] && read_format[2] < read_format[1]) {
+                values_[i] = static_cast<double>(read_format[0]) * read_format[1] / read_format[2];
+            } else {
+                values_[i] = static_cast<double>(read_format[0]);
+            }
+        }
+#endif
+    }
+
+    // The value of `name` from the last Start()..Stop(), or a negative number if
+    // it is not counted.
+    double Value(const char* name) const {
+        for (size_t i = 0; i < size_; ++i) {
+            if (!std::strcmp(events_[i].name, name)) {
+                return values_[i];
+            }
+        }
+        return -1;
+    }
+
+    // One line of per-operation values, nothing without counters.
+    void Print(size_t ops) const {
+        if (!size_ || !ops) {
+            return;
+        }
+        std::printf("  per op:");
+        for (size_t i = 0; i < size_; ++i) {
+            std::printf("%s %.2f %s", i ? "," : "", values_[i] / ops, events_[i].name);
+        }
+        double cycles = Value("cycles");
+        double instructions = Value("instructions");
+        if (cycles > 0 && instructions >= 0) {
+            std::printf(" (IPC %.2f)", instructions / cycles);
+        }
+        std::printf("\n");
+    }
+
+private:
+    struct Event {
+        const char* name;
+        uint32_t type;
+        uint64_t config;
+    };
+
+    struct OpenEvent {
+        const char* name;
+        int fd;
+    };
+
+#ifdef __linux__
+    template <size_t N>
+    bool Open(const Event (&events)[N]) {
+        static_assert(N <= kMaxEvents);
+        for (const Event& event : events) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = event.type;
+            attr.config = event.config;
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (fd >= 0) {
+                events_[size_++] = {event.name, fd};
+            } else if (!size_) {
+                return false;
+            }
+        }
+        return true;
+    }
+#endif
+
+    Source source_ = Source::kNone;
+    OpenEvent events_[kMaxEvents] = {};
+    double values_[kMaxEvents] = {};
+    size_t size_ = 0;
+};
+
+}  // namespace bench
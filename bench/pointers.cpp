@@ -0,0 +1,170 @@
+#include "bench.h"
+
+#include <core/shared.h>
+#include <intrusive/intrusive.h>
+#include <unique/unique.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+// The basic operations of each pointer type against its std:: counterpart, over
+// a working set visited in random order: create, copy (or move), dereference and
+// destroy, plus weak references for the shared pointers, whose objects are then
+// destroyed while the weak references still hold the blocks. The per-operation
+// PerfCounters show what each layout costs: fat or thin SharedPtr, a separate or
+// an embedded control block. Every SharedPtr layout runs with single-threaded and
+// with atomic counting; std::shared_ptr always counts atomically, so the atomic
+// rows are the like-for-like comparison.
+// Usage: bench_pointers [objects]
+
+namespace {
+
+struct Payload {
+    uint64_t data[4] = {};
+};
+
+struct CountedPayload : SimpleRefCounted<CountedPayload> {
+    uint64_t data[4] = {};
+};
+
+template <typename Ptr, typename Make>
+std::vector<Ptr> MeasureOwning(const char* name, const std::vector<uint32_t>& order, Make&& make) {
+    const size_t count = order.size();
+    char label[96];
+    std::vector<Ptr> pointers;
+    pointers.reserve(count);
+
+    std::snprintf(label, sizeof(label), "%s: create", name);
+    bench::Run(label, count, [&] {
+        for (size_t i = 0; i < count; ++i) {
+            pointers.push_back(make());
+        }
+    });
+
+    std::vector<Ptr> others(count);
+    if constexpr (std::is_copy_constructible_v<Ptr>) {
+        std::snprintf(label, sizeof(label), "%s: copy", name);
+        bench::Run(label, count, [&] {
+            for (uint32_t i : order) {
+                others[i] = pointers[i];
+            }
+        });
+    } else {
+        std::snprintf(label, sizeof(label), "%s: move", name);
+        bench::Run(label, count, [&] {
+            for (uint32_t i : order) {
+                others[i] = std::move(pointers[i]);
+            }
+        });
+        pointers.swap(others);
+    }
+
+    std::snprintf(label, sizeof(label), "%s: dereference", name);
+    uint64_t sum = 0;
+    bench::Run(label, count, [&] {
+        for (uint32_t i : order) {
+            sum += pointers[i]->data[i % 4];
+        }
+    });
+    bench::DoNotOptimize(sum);
+
+    others.clear();
+    return pointers;
+}
+
+template <typename Ptr>
+void MeasureDestroy(const char* name, std::vector<Ptr> pointers, const std::vector<uint32_t>& order) {
+    char label[96];
+    std::snprintf(label, sizeof(label), "%s: destroy", name);
+    bench::Run(label, order.size(), [&] {
+        for (uint32_t i : order) {
+            pointers[i] = Ptr();
+        }
+    });
+}
+
+template <typename Weak, typename Ptr, typename Lock>
+void MeasureWeak(const char* name, std::vector<Ptr> pointers, const std::vector<uint32_t>& order,
+                 Lock&& lock) {
+    const size_t count = order.size();
+    char label[96];
+    std::vector<Weak> weak(count);
+
+    std::snprintf(label, sizeof(label), "%s: weak from shared", name);
+    bench::Run(label, count, [&] {
+        for (uint32_t i : order) {
+            weak[i] = pointers[i];
+        }
+    });
+
+    std::snprintf(label, sizeof(label), "%s: lock", name);
+    uint64_t sum = 0;
+    bench::Run(label, count, [&] {
+        for (uint32_t i : order) {
+            sum += lock(weak[i])->data[i % 4];
+        }
+    });
+
+    MeasureDestroy(name, std::move(pointers), order);
+    std::snprintf(label, sizeof(label), "%s: lock expired", name);
+    bench::Run(label, count, [&] {
+        for (uint32_t i : order) {
+            sum += static_cast<bool>(lock(weak[i]));
+        }
+    });
+    bench::DoNotOptimize(sum);
+
+    std::snprintf(label, sizeof(label), "%s: destroy weak", name);
+    bench::Run(label, count, [&] { weak.clear(); });
+}
+
+template <typename... Policies>
+void MeasureShared(const char* name, const std::vector<uint32_t>& order) {
+    auto shared = MeasureOwning<SharedPtr<Payload, Policies...>>(name, order,
+                                                                 [] { return MakeShared<Payload, Policies...>(); });
+    MeasureWeak<WeakPtr<Payload, Policies...>>(name, std::move(shared), order,
+                                               [](auto& weak) { return weak.Lock(); });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t count = bench::SizeArg(argc, argv, 1, 1'000'000);
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937(42));
+    {
+        // Grow the heap first, or the first pointer type pays for its page faults.
+        std::vector<std::shared_ptr<Payload>> warm_up(count);
+        for (auto& ptr : warm_up) {
+            ptr = std::make_shared<Payload>();
+        }
+    }
+
+    auto unique = MeasureOwning<UniquePtr<Payload>>("UniquePtr", order,
+                                                    [] { return UniquePtr<Payload>(new Payload); });
+    MeasureDestroy("UniquePtr", std::move(unique), order);
+    auto std_unique = MeasureOwning<std::unique_ptr<Payload>>(
+        "std::unique_ptr", order, [] { return std::make_unique<Payload>(); });
+    MeasureDestroy("std::unique_ptr", std::move(std_unique), order);
+
+    MeasureShared<SingleThreadedCounting>("SharedPtr<SingleThreadedCounting>", order);
+    MeasureShared<ThinLayout, SingleThreadedCounting>("SharedPtr<ThinLayout, SingleThreadedCounting>", order);
+    MeasureShared<AtomicCounting>("SharedPtr<AtomicCounting>", order);
+    MeasureShared<ThinLayout, AtomicCounting>("SharedPtr<ThinLayout, AtomicCounting>", order);
+    auto std_shared = MeasureOwning<std::shared_ptr<Payload>>(
+        "std::shared_ptr", order, [] { return std::make_shared<Payload>(); });
+    MeasureWeak<std::weak_ptr<Payload>>("std::shared_ptr", std::move(std_shared), order,
+                                        [](auto& weak) { return weak.lock(); });
+
+    auto intrusive = MeasureOwning<IntrusivePtr<CountedPayload>>(
+        "IntrusivePtr<SimpleCounter>", order, [] { return MakeIntrusive<CountedPayload>(); });
+    MeasureDestroy("IntrusivePtr<SimpleCounter>", std::move(intrusive), order);
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "bench.h"
+
+#include <core/shared.h>
+#include <core/weak.h>
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+// Every counting x layout x allocation combination of SharedPtr on the same
+// workload: build a working set with MakeShared, replace random members of it,
+// then copy, lock and dereference random members.
+// Usage: bench_policies [working_set] [operations]
+
+namespace {
+
+struct Payload {
+    Payload(uint64_t key) : key{key} {
+    }
+
+    uint64_t key;
+    uint64_t data[3] = {};
+};
+
+std::string Name(const char* counting, const char* layout, const char* allocation) {
+    return std::string(counting) + " / " + layout + " / " + allocation;
+}
+
+template <typename... Policies>
+void Measure(const std::string& name, size_t working_set, size_t operations) {
+    // Arena-backed blocks are only reclaimed with the arena.
+    HugePageArena arena;
+    ArenaScope scope(arena);
+
+    std::vector<SharedPtr<Payload, Policies...>> nodes;
+    nodes.reserve(working_set);
+    bench::Run((name + ": churn").c_str(), working_set + operations, [&] {
+        for (size_t i = 0; i < working_set; ++i) {
+            nodes.push_back(MakeShared<Payload, Policies...>(i));
+        }
+        std::mt19937_64 rng{7};
+        for (size_t i = 0; i < operations; ++i) {
+            nodes[rng() % working_set] = MakeShared<Payload, Policies...>(i);
+        }
+    });
+
+    std::vector<WeakPtr<Payload, Policies...>> weak(nodes.begin(), nodes.end());
+    uint64_t sum = 0;
+    bench::Run((name + ": copy + lock").c_str(), operations, [&] {
+        std::mt19937_64 rng{11};
+        for (size_t i = 0; i < operations; ++i) {
+            size_t index = rng() % working_set;
+            SharedPtr<Payload, Policies...> copy = nodes[index];
+            sum += copy->key + weak[index].Lock()->key;
+        }
+    });
+    bench::DoNotOptimize(sum);
+}
+
+template <typename Counting, typename Layout>
+void MeasureAllocations(const char* counting, const char* layout, size_t working_set,
+                        size_t operations) {
+    Measure<Counting, Layout, GlobalAllocation>(Name(counting, layout, "global"), working_set,
+                                                operations);
+    Measure<Counting, Layout, PoolAllocation>(Name(counting, layout, "pool"), working_set,
+                                              operations);
+    Measure<Counting, Layout, ArenaAllocation>(Name(counting, layout, "arena"), working_set,
+                                               operations);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t working_set = bench::SizeArg(argc, argv, 1, 200'000);
+    const size_t operations = bench::SizeArg(argc, argv, 2, 2'000'000);
+
+    MeasureAllocations<SingleThreadedCounting, FatLayout>("single", "fat", working_set, operations);
+    MeasureAllocations<SingleThreadedCounting, ThinLayout>("single", "thin", working_set, operations);
+    MeasureAllocations<AtomicCounting, FatLayout>("atomic", "fat", working_set, operations);
+    MeasureAllocations<AtomicCounting, ThinLayout>("atomic", "thin", working_set, operations);
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include "bench.h"
+
+#include <common/prefetch.h>
+#include <intrusive/intrusive.h>
+#include <shared-from-this/shared.h>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Pointer-chasing list traversal with and without prefetching.
+// Nodes are linked in a random permutation of their allocation order so that the
+// hardware prefetcher cannot follow the chain.
+// Usage: bench_prefetch [num_nodes] (the 100M-node run needs ~10 GiB of memory)
+
+namespace {
+
+struct Payload {
+    uint64_t values[6] = {};
+};
+
+struct SharedNode {
+    SharedPtr<SharedNode> next;
+    SharedPtr<Payload> payload;
+};
+
+struct IntrusiveNode : SimpleRefCounted<IntrusiveNode> {
+    IntrusivePtr<IntrusiveNode> next;
+    Payload payload;
+};
+
+std::vector<size_t> RandomOrder(size_t size) {
+    std::vector<size_t> order(size);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), std::mt19937_64{42});
+    return order;
+}
+
+template <typename Node, typename Make>
+Node BuildList(size_t size, Make make) {
+    std::vector<Node> nodes;
+    nodes.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        nodes.push_back(make(i));
+    }
+    auto order = RandomOrder(size);
+    for (size_t i = 0; i + 1 < size; ++i) {
+        nodes[order[i]]->next = nodes[order[i + 1]];
+    }
+    return nodes[order[0]];
+}
+
+template <typename Node>
+void DestroyList(Node head) {
+    while (head) {
+        auto next = std::move(head->next);
+        head = std::move(next);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t num_nodes = bench::SizeArg(argc, argv, 1, 4'000'000);
+
+    {
+        auto head = BuildList<SharedPtr<SharedNode>>(num_nodes, [](size_t i) {
+            auto node = MakeShared<SharedNode>();
+            node->payload = MakeShared<Payload>();
+            node->payload->values[0] = i;
+            return node;
+        });
+        bench::Run("SharedPtr list: plain", num_nodes, [&] {
+            uint64_t sum = 0;
+            for (SharedNode* node = head.Get(); node; node = node->next.Get()) {
+                sum += node->payload->values[0];
+            }
+            bench::DoNotOptimize(sum);
+        });
+        bench::Run("SharedPtr list: prefetch 8 ahead", num_nodes, [&] {
+            uint64_t sum = 0;
+            ForEachPrefetched<8>(
+                head.Get(),
+                [](SharedNode* node) {
+                    node->payload.Prefetch();
+                    return node->next.Get();
+                },
+                [&sum](SharedNode* node) { sum += node->payload->values[0]; });
+            bench::DoNotOptimize(sum);
+        });
+        DestroyList(std::move(head));
+    }
+
+    {
+        auto head = BuildList<IntrusivePtr<IntrusiveNode>>(num_nodes, [](size_t i) {
+            auto node = MakeIntrusive<IntrusiveNode>();
+            node->payload.values[5] = i;
+            return node;
+        });
+        bench::Run("IntrusivePtr list: plain", num_nodes, [&] {
+            uint64_t sum = 0;
+            for (IntrusiveNode* node = head.Get(); node; node = node->next.Get()) {
+                sum += node->payload.values[5];
+            }
+            bench::DoNotOptimize(sum);
+        });
+        bench::Run("IntrusivePtr list: prefetch 8 ahead", num_nodes, [&] {
+            uint64_t sum = 0;
+            ForEachPrefetched<8>(
+                head.Get(), [](IntrusiveNode* node) { return node->next.Get(); },
+                [&sum](IntrusiveNode* node) { sum += node->payload.values[5]; });
+            bench::DoNotOptimize(sum);
+        });
+
+        std::vector<IntrusivePtr<IntrusiveNode>> shuffled;
+        shuffled.reserve(num_nodes);
+        for (IntrusiveNode* node = head.Get(); node; node = node->next.Get()) {
+            shuffled.emplace_back(node);
+        }
+        bench::Run("vector<IntrusivePtr>: plain", num_nodes, [&] {
+            uint64_t sum = 0;
+            for (const auto& node : shuffled) {
+                sum += node->payload.values[5];
+            }
+            bench::DoNotOptimize(sum);
+        });
+        bench::Run("vector<IntrusivePtr>: PrefetchAhead<16>", num_nodes, [&] {
+            uint64_t sum = 0;
+            for (const auto& node : PrefetchAhead<16>(shuffled)) {
+                sum += node->payload.values[5];
+            }
+            bench::DoNotOptimize(sum);
+        });
+        shuffled.clear();
+        DestroyList(std::move(head));
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "bench.h"
+
+#include <allocations_checker.h>
+#include <core/shared.h>
+#include <intrusive/shared_string.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Copy, hash and compare of SharedString against SharedPtr<std::string> and
+// std::string, for short (inline) and long strings. Compares are between equal
+// strings with separate storage, the worst case for every representation.
+// Usage: bench_shared_string [strings] [short length] [long length]
+
+namespace {
+
+struct PlainString {
+    static std::string Make(const std::string& str) {
+        return str;
+    }
+    static bool Equal(const std::string& a, const std::string& b) {
+        return a == b;
+    }
+    static size_t Hash(const std::string& str) {
+        return std::hash<std::string>{}(str);
+    }
+};
+
+struct SharedStdString {
+    static SharedPtr<std::string> Make(const std::string& str) {
+        return MakeShared<std::string>(str);
+    }
+    static bool Equal(const SharedPtr<std::string>& a, const SharedPtr<std::string>& b) {
+        return *a == *b;
+    }
+    static size_t Hash(const SharedPtr<std::string>& str) {
+        return std::hash<std::string>{}(*str);
+    }
+};
+
+template <typename String>
+struct Refcounted {
+    static String Make(const std::string& str) {
+        return String(str);
+    }
+    static bool Equal(const String& a, const String& b) {
+        return a == b;
+    }
+    static size_t Hash(const String& str) {
+        return str.Hash();
+    }
+};
+
+template <typename Ops>
+void Measure(const char* name, size_t count, size_t length) {
+    std::vector<std::string> texts;
+    for (size_t i = 0; i < count; ++i) {
+        std::string text(length, 'a');
+        text.replace(0, std::min(length, size_t{8}), std::to_string(i).substr(0, length));
+        texts.push_back(std::move(text));
+    }
+    using String = decltype(Ops::Make(texts[0]));
+    std::vector<String> a, b;
+    a.reserve(count);
+    b.reserve(count);
+    for (const auto& text : texts) {
+        a.push_back(Ops::Make(text));
+        b.push_back(Ops::Make(text));
+    }
+
+    char label[96];
+    std::snprintf(label, sizeof(label), "%s, %zu chars: copy", name, length);
+    size_t allocations = alloc_checker::AllocCount();
+    std::vector<String> copies;
+    copies.reserve(count);
+    bench::Run(label, count, [&] {
+        for (const auto& str : a) {
+            copies.push_back(str);
+        }
+    });
+    std::printf("  %.2f allocations per copy\n",
+                static_cast<double>(alloc_checker::AllocCount() - allocations) / count);
+
+    std::snprintf(label, sizeof(label), "%s, %zu chars: hash", name, length);
+    size_t sum = 0;
+    bench::Run(label, count * 10, [&] {
+        for (int round = 0; round < 10; ++round) {
+            for (const auto& str : a) {
+                sum += Ops::Hash(str);
+            }
+        }
+    });
+
+    std::snprintf(label, sizeof(label), "%s, %zu chars: compare", name, length);
+    bench::Run(label, count * 10, [&] {
+        for (int round = 0; round < 10; ++round) {
+            for (size_t i = 0; i < count; ++i) {
+                sum += Ops::Equal(a[i], b[i]);
+            }
+        }
+    });
+    bench::DoNotOptimize(sum);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t count = bench::SizeArg(argc, argv, 1, 100'000);
+    const size_t short_length = bench::SizeArg(argc, argv, 2, 12);
+    const size_t long_length = bench::SizeArg(argc, argv, 3, 64);
+
+    for (size_t length : {short_length, long_length}) {
+        Measure<PlainString>("std::string", count, length);
+        Measure<SharedStdString>("SharedPtr<std::string>", count, length);
+        Measure<Refcounted<SharedString>>("SharedString", count, length);
+        Measure<Refcounted<AtomicSharedString>>("AtomicSharedString", count, length);
+    }
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include "bench.h"
+
+#include <core/batch.h>
+#include <core/shared_vector.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// SharedPtrVector against std::vector<SharedPtr> on the same objects, created in
+// shuffled order so that neighbouring elements point far apart:
+//  - iterate: sum a field of every object;
+//  - scan: find the holes left by resetting every 64th element;
+//  - filter: erase a quarter of the elements by a predicate on the object;
+//  - compact: erase the holes;
+//  - clear: release distinct objects, and aliases of a few MakeSharedBatch blocks
+//    pushed in runs of 16.
+// Usage: bench_shared_vector [elements]
+
+namespace {
+
+struct Item {
+    uint64_t key;
+    uint64_t padding[3];
+};
+
+using ItemPtr = SharedPtr<Item>;
+
+std::vector<ItemPtr> MakeItems(size_t count) {
+    std::vector<ItemPtr> items;
+    items.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        items.push_back(MakeShared<Item>(Item{i, {}}));
+    }
+    std::shuffle(items.begin(), items.end(), std::mt19937_64(count));
+    return items;
+}
+
+// The same operations on both containers.
+struct StdVector {
+    using Container = std::vector<ItemPtr>;
+
+    static void PushBack(Container& container, ItemPtr ptr) {
+        container.push_back(std::move(ptr));
+    }
+    static uint64_t Sum(const Container& container) {
+        uint64_t sum = 0;
+        for (const auto& item : container) {
+            sum += item->key;
+        }
+        return sum;
+    }
+    static void Reset(Container& container, size_t index) {
+        container[index].Reset();
+    }
+    static size_t CountNull(const Container& container) {
+        size_t nulls = 0;
+        auto is_null = [](const ItemPtr& item) { return !item; };
+        for (auto it = container.begin(); (it = std::find_if(it, container.end(), is_null)) != container.end();
+             ++it) {
+            ++nulls;
+        }
+        return nulls;
+    }
+    template <typename Pred>
+    static size_t EraseIf(Container& container, Pred pred) {
+        return std::erase_if(container, [&](const ItemPtr& item) { return pred(item.Get()); });
+    }
+    static size_t EraseNull(Container& container) {
+        return std::erase_if(container, [](const ItemPtr& item) { return !item; });
+    }
+    static void Clear(Container& container) {
+        container.clear();
+    }
+};
+
+struct SoAVector {
+    using Container = SharedPtrVector<Item>;
+
+    static void PushBack(Container& container, ItemPtr ptr) {
+        container.PushBack(std::move(ptr));
+    }
+    static uint64_t Sum(const Container& container) {
+        uint64_t sum = 0;
+        for (const Item* item : container) {
+            sum += item->key;
+        }
+        return sum;
+    }
+    static void Reset(Container& container, size_t index) {
+        container.Reset(index);
+    }
+    static size_t CountNull(const Container& container) {
+        size_t nulls = 0;
+        for (size_t index = 0; (index = container.FindNull(index)) != container.Size(); ++index) {
+            ++nulls;
+        }
+        return nulls;
+    }
+    template <typename Pred>
+    static size_t EraseIf(Container& container, Pred pred) {
+        return container.EraseIf(pred);
+    }
+    static size_t EraseNull(Container& container) {
+        return container.EraseNull();
+    }
+    static void Clear(Container& container) {
+        container.Clear();
+    }
+};
+
+template <typename Ops>
+void Measure(const char* name, const std::vector<ItemPtr>& items) {
+    const size_t count = items.size();
+    char label[96];
+    typename Ops::Container container;
+    for (const auto& item : items) {
+        Ops::PushBack(container, item);
+    }
+
+    std::snprintf(label, sizeof(label), "%s: iterate", name);
+    uint64_t sum = 0;
+    bench::Run(label, count * 10, [&] {
+        for (int round = 0; round < 10; ++round) {
+            sum += Ops::Sum(container);
+        }
+    });
+
+    for (size_t i = 0; i < count; i += 64) {
+        Ops::Reset(container, i);
+    }
+    std::snprintf(label, sizeof(label), "%s: scan for holes", name);
+    bench::Run(label, count * 10, [&] {
+        for (int round = 0; round < 10; ++round) {
+            sum += Ops::CountNull(container);
+        }
+    });
+
+    std::snprintf(label, sizeof(label), "%s: filter", name);
+    size_t erased = 0;
+    bench::Run(label, count, [&] {
+        erased += Ops::EraseIf(container, [](const Item* item) { return item && item->key % 4 == 1; });
+    });
+
+    std::snprintf(label, sizeof(label), "%s: compact", name);
+    bench::Run(label, count, [&] { erased += Ops::EraseNull(container); });
+
+    std::snprintf(label, sizeof(label), "%s: clear distinct objects", name);
+    bench::Run(label, count, [&] { Ops::Clear(container); });
+    bench::DoNotOptimize(sum + erased);
+
+    // Aliases of 16-element batches, pushed batch by batch
+    std::vector<SharedBatch<Item>> batches;
+    for (size_t i = 0; i < count / 16; ++i) {
+        batches.push_back(MakeSharedBatch<Item>(16, [i](size_t j) { return Item{i * 16 + j, {}}; }));
+    }
+    std::shuffle(batches.begin(), batches.end(), std::mt19937_64(count));
+    for (const auto& batch : batches) {
+        for (size_t j = 0; j < batch.Size(); ++j) {
+            Ops::PushBack(container, batch.Share(j));
+        }
+    }
+    batches.clear();
+    std::snprintf(label, sizeof(label), "%s: clear batch aliases", name);
+    bench::Run(label, count / 16 * 16, [&] { Ops::Clear(container); });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t count = bench::SizeArg(argc, argv, 1, 1'000'000);
+    auto items = MakeItems(count);
+    Measure<StdVector>("std::vector<SharedPtr>", items);
+    Measure<SoAVector>("SharedPtrVector", items);
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "bench.h"
+
+#include <intrusive/intrusive.h>
+#include <intrusive/slab.h>
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+// Allocation-heavy churn: keep a working set of objects and repeatedly replace
+// random members of it. Compares global new/delete with slab allocation and
+// reports slab fragmentation at the end of each phase. Then a pool that fills up
+// and empties again, with and without a cache of empty slabs.
+// Usage: bench_slab [working_set] [replacements]
+
+namespace {
+
+struct HeapNode : SimpleRefCounted<HeapNode> {
+    HeapNode(uint64_t key) : key{key} {
+    }
+
+    uint64_t key;
+    uint64_t data[3] = {};
+};
+
+struct SlabNode : SlabRefCounted<SlabNode> {
+    SlabNode(uint64_t key) : key{key} {
+    }
+
+    uint64_t key;
+    uint64_t data[3] = {};
+};
+
+template <typename Node>
+void Churn(const char* name, size_t working_set, size_t replacements) {
+    std::vector<IntrusivePtr<Node>> nodes;
+    bench::Run(name, working_set + replacements, [&] {
+        for (size_t i = 0; i < working_set; ++i) {
+            nodes.push_back(MakeIntrusive<Node>(i));
+        }
+        std::mt19937_64 rng{7};
+        for (size_t i = 0; i < replacements; ++i) {
+            nodes[rng() % working_set] = MakeIntrusive<Node>(i);
+        }
+    });
+    if constexpr (std::is_same_v<Node, SlabNode>) {
+        SlabAllocatorFor<SlabNode>::Instance().Flush();
+        auto stats = SlabAllocatorFor<SlabNode>::Instance().Stats();
+        std::printf("  after churn: %zu slabs, %zu/%zu slots used, fragmentation %.2f%%\n",
+                    stats.slabs, stats.in_use, stats.capacity, 100 * stats.Fragmentation());
+        std::mt19937_64 rng{11};
+        for (size_t i = 0; i < working_set; ++i) {
+            if (rng() % 4) {
+                nodes[i].Reset();
+            }
+        }
+        SlabAllocatorFor<SlabNode>::Instance().Flush();
+        stats = SlabAllocatorFor<SlabNode>::Instance().Stats();
+        std::printf("  after freeing ~75%%: %zu slabs, %zu/%zu slots used, fragmentation %.2f%%\n",
+                    stats.slabs, stats.in_use, stats.capacity, 100 * stats.Fragmentation());
+    }
+}
+
+// Each round allocates `batch` objects and frees them all.
+void Pulse(const char* name, size_t cached_slabs, size_t batch, size_t rounds) {
+    auto& slab = SlabAllocatorFor<SlabNode>::Instance();
+    slab.SetCachedSlabLimit(cached_slabs);
+    const SlabStats before = slab.Stats();
+    std::vector<IntrusivePtr<SlabNode>> nodes;
+    nodes.reserve(batch);
+    bench::Run(name, batch * rounds, [&] {
+        for (size_t round = 0; round < rounds; ++round) {
+            for (size_t i = 0; i < batch; ++i) {
+                nodes.push_back(MakeIntrusive<SlabNode>(i));
+            }
+            nodes.clear();
+        }
+    });
+    slab.Flush();
+    SlabStats stats = slab.Stats();
+    std::printf("  %zu slabs from the cache, %zu from the system, %zu cached\n", stats.hits - before.hits,
+                stats.misses - before.misses, stats.cached);
+    if (size_t released = slab.Trim(std::chrono::seconds(0))) {
+        std::printf("  Trim released %zu KiB\n", released >> 10);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t working_set = bench::SizeArg(argc, argv, 1, 1'000'000);
+    const size_t replacements = bench::SizeArg(argc, argv, 2, 10'000'000);
+
+    Churn<HeapNode>("MakeIntrusive: global new", working_set, replacements);
+    Churn<SlabNode>("MakeIntrusive: SlabDelete", working_set, replacements);
+
+    const size_t batch = 8 * SlabAllocatorFor<SlabNode>::kSlotsPerSlab;
+    const size_t rounds = replacements / batch + 1;
+    Pulse("Fill and empty: no slab cache", 0, batch, rounds);
+    Pulse("Fill and empty: 16 cached slabs", 16, batch, rounds);
+    return 0;
+}
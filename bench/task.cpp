@@ -0,0 +1,126 @@
+#include "bench.h"
+
+#include <allocations_checker.h>
+#include <core/shared.h>
+#include <core/task.h>
+
+#include <cstdio>
+#include <functional>
+#include <utility>
+#include <vector>
+
+// A chain of async steps on a local executor: SharedTask coroutines awaiting one
+// pooled frame per step, with and without an IfAlive check of the owner, against
+// continuations that capture SharedFromThis() in a std::function.
+// Usage: bench_task [steps]
+
+namespace {
+
+SharedTask<int> Step(LocalExecutor& executor, int value) {
+    co_await executor.Schedule();
+    co_return value + 1;
+}
+
+// Runs std::function continuations in FIFO order, like LocalExecutor.
+class CallbackExecutor {
+public:
+    void Post(std::function<void()> callback) {
+        queue_.push_back(std::move(callback));
+    }
+
+    size_t Run() {
+        size_t resumed = 0;
+        while (!queue_.empty()) {
+            running_.swap(queue_);
+            for (auto& callback : running_) {
+                callback();
+            }
+            resumed += running_.size();
+            running_.clear();
+        }
+        return resumed;
+    }
+
+private:
+    std::vector<std::function<void()>> queue_;
+    std::vector<std::function<void()>> running_;
+};
+
+class Connection : public EnableSharedFromThis<Connection> {
+public:
+    SharedTask<int> Chain(LocalExecutor& executor, size_t steps) {
+        int value = 0;
+        for (size_t i = 0; i < steps; ++i) {
+            value = co_await Step(executor, value);
+        }
+        co_return value;
+    }
+
+    SharedTask<int> GuardedChain(LocalExecutor& executor, size_t steps) {
+        auto weak = WeakFromThis();
+        int value = 0;
+        for (size_t i = 0; i < steps; ++i) {
+            value = co_await Step(executor, value);
+            auto self = co_await IfAlive(weak);
+            self->value_ = value;
+        }
+        co_return value;
+    }
+
+    void CallbackChain(CallbackExecutor& executor, size_t steps) {
+        if (steps == 0) {
+            return;
+        }
+        executor.Post([self = SharedFromThis(), &executor, steps] {
+            ++self->value_;
+            self->CallbackChain(executor, steps - 1);
+        });
+    }
+
+    int Value() const {
+        return value_;
+    }
+
+private:
+    int value_ = 0;
+};
+
+template <typename F>
+void Measure(const char* name, size_t steps, F&& body) {
+    size_t allocations = alloc_checker::AllocCount();
+    bench::Run(name, steps, body);
+    std::printf("  %.2f allocations per step\n",
+                static_cast<double>(alloc_checker::AllocCount() - allocations) / steps);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t steps = bench::SizeArg(argc, argv, 1, 1'000'000);
+    auto connection = MakeShared<Connection>();
+
+    // Warm up the frame pool and the queues.
+    LocalExecutor executor;
+    connection->Chain(executor, 1000);
+    executor.Run();
+    CallbackExecutor callbacks;
+    connection->CallbackChain(callbacks, 1000);
+    callbacks.Run();
+
+    Measure("SharedTask chain", steps, [&] {
+        auto task = connection->Chain(executor, steps);
+        executor.Run();
+        bench::DoNotOptimize(task.Result());
+    });
+    Measure("SharedTask chain with IfAlive", steps, [&] {
+        auto task = connection->GuardedChain(executor, steps);
+        executor.Run();
+        bench::DoNotOptimize(task.Result());
+    });
+    Measure("std::function capturing SharedFromThis", steps, [&] {
+        connection->CallbackChain(callbacks, steps);
+        callbacks.Run();
+        bench::DoNotOptimize(connection->Value());
+    });
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "bench.h"
+
+#include <core/weak_set.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <random>
+#include <vector>
+
+// Sweeps over weak references to objects created in shuffled order, half of them
+// destroyed: WeakPtrSet against std::vector<WeakPtr> and std::vector<std::weak_ptr>.
+//  - count: how many are alive;
+//  - lock all: lock the live ones into a preallocated buffer;
+//  - erase expired: drop the dead ones, keeping the order of the rest.
+// Usage: bench_weak_set [references]
+
+namespace {
+
+struct Item {
+    uint64_t key;
+    uint64_t padding[3];
+};
+
+template <template <typename> class Owner, typename Make>
+std::vector<Owner<Item>> MakeOwners(size_t count, Make make) {
+    std::vector<Owner<Item>> owners;
+    owners.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        owners.push_back(make(i));
+    }
+    std::shuffle(owners.begin(), owners.end(), std::mt19937_64(count));
+    return owners;
+}
+
+template <typename T>
+using Shared = SharedPtr<T>;
+
+template <typename T>
+using StdShared = std::shared_ptr<T>;
+
+struct VectorOfWeak {
+    using Owner = SharedPtr<Item>;
+    using Container = std::vector<WeakPtr<Item>>;
+
+    static void Insert(Container& container, const Owner& owner) {
+        container.emplace_back(owner);
+    }
+    static size_t CountAlive(const Container& container) {
+        size_t alive = 0;
+        for (const auto& weak : container) {
+            alive += !weak.Expired();
+        }
+        return alive;
+    }
+    static size_t LockAll(const Container& container, Owner* out) {
+        size_t locked = 0;
+        for (const auto& weak : container) {
+            if (auto ptr = weak.Lock()) {
+                out[locked++] = std::move(ptr);
+            }
+        }
+        return locked;
+    }
+    static size_t EraseExpired(Container& container) {
+        return std::erase_if(container, [](const WeakPtr<Item>& weak) { return weak.Expired(); });
+    }
+};
+
+struct WeakSet {
+    using Owner = SharedPtr<Item>;
+    using Container = WeakPtrSet<Item>;
+
+    static void Insert(Container& container, const Owner& owner) {
+        container.Insert(owner);
+    }
+    static size_t CountAlive(const Container& container) {
+        static std::vector<size_t> counts;
+        counts.resize(container.Size());
+        return container.UseCounts(counts.data());
+    }
+    static size_t LockAll(const Container& container, Owner* out) {
+        return container.LockAll(out);
+    }
+    static size_t EraseExpired(Container& container) {
+        return container.EraseExpired();
+    }
+};
+
+struct StdVectorOfWeak {
+    using Owner = std::shared_ptr<Item>;
+    using Container = std::vector<std::weak_ptr<Item>>;
+
+    static void Insert(Container& container, const Owner& owner) {
+        container.emplace_back(owner);
+    }
+    static size_t CountAlive(const Container& container) {
+        size_t alive = 0;
+        for (const auto& weak : container) {
+            alive += !weak.expired();
+        }
+        return alive;
+    }
+    static size_t LockAll(const Container& container, Owner* out) {
+        size_t locked = 0;
+        for (const auto& weak : container) {
+            if (auto ptr = weak.lock()) {
+                out[locked++] = std::move(ptr);
+            }
+        }
+        return locked;
+    }
+    static size_t EraseExpired(Container& container) {
+        return std::erase_if(container, [](const std::weak_ptr<Item>& weak) { return weak.expired(); });
+    }
+};
+
+template <typename Ops>
+void Measure(const char* name, std::vector<typename Ops::Owner> owners) {
+    const size_t count = owners.size();
+    char label[96];
+    typename Ops::Container container;
+    for (const auto& owner : owners) {
+        Ops::Insert(container, owner);
+    }
+    // Every other object in memory order dies.
+    for (auto& owner : owners) {
+        if (owner->key % 2) {
+            owner = {};
+        }
+    }
+
+    size_t sum = 0;
+    std::snprintf(label, sizeof(label), "%s: count alive", name);
+    bench::Run(label, count * 10, [&] {
+        for (int round = 0; round < 10; ++round) {
+            sum += Ops::CountAlive(container);
+        }
+    });
+
+    std::vector<typename Ops::Owner> buffer(count);
+    std::snprintf(label, sizeof(label), "%s: lock all", name);
+    bench::Run(label, count, [&] { sum += Ops::LockAll(container, buffer.data()); });
+    buffer = {};
+
+    std::snprintf(label, sizeof(label), "%s: erase expired", name);
+    bench::Run(label, count, [&] { sum += Ops::EraseExpired(container); });
+    bench::DoNotOptimize(sum);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const size_t count = bench::SizeArg(argc, argv, 1, 1'000'000);
+    Measure<StdVectorOfWeak>("std::vector<std::weak_ptr>", MakeOwners<StdShared>(count, [](size_t i) {
+                                 return std::make_shared<Item>(Item{i, {}});
+                             }));
+    Measure<VectorOfWeak>("std::vector<WeakPtr>",
+                          MakeOwners<Shared>(count, [](size_t i) { return MakeShared<Item>(Item{i, {}}); }));
+    Measure<WeakSet>("WeakPtrSet",
+                     MakeOwners<Shared>(count, [](size_t i) { return MakeShared<Item>(Item{i, {}}); }));
+    return 0;
+}
@@ -0,0 +1,582 @@
+#include "bench.h"
+
+#include <allocations_checker.h>
+#include <core/lru_cache.h>
+#include <core/shared.h>
+#include <intrusive/intrusive.h>
+#include <unique/unique.h>
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// End-to-end workloads, each run on this library and on the std:: smart pointers:
+//
+//  - ast:    random expression trees of UniquePtr nodes, built and interpreted;
+//            `size` nodes are alive per thread, ten rounds
+//  - lru:    skewed lookups of SharedPtr values in a ShardedLruCache of `size`
+//            entries, with clients revalidating WeakPtr handles before asking it
+//  - graph:  BFS over one DAG of `size` IntrusivePtr nodes shared by all threads
+//  - pubsub: fan-out of shared messages to `size / 10` subscribers per thread
+//            whose callbacks hold SharedFromThis(), with one subscriber replaced
+//            per message
+//
+// Reports throughput, allocations per operation and the peak RSS of the workload
+// (with its growth over the RSS at the start). Run one workload per process for
+// peaks that do not include memory the allocator kept from the previous one.
+// Usage: bench_workloads [ast|lru|graph|pubsub|all] [threads] [size]
+
+namespace {
+
+// `setup()` builds the state the threads share, `work(state, thread)` runs one
+// thread's share and returns its operation count.
+template <typename Setup, typename Work>
+void Measure(const char* name, size_t threads, Setup&& setup, Work&& work) {
+    bench::ResetPeakRss();
+    const size_t start_rss = bench::PeakRssKb();
+    auto state = setup();
+
+    std::atomic<size_t> ops = 0;
+    const size_t allocations = alloc_checker::AllocCount();
+    bench::PerfCounters& counters = bench::PerfCounters::Instance();
+    counters.Start();
+    bench::Timer timer;
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] { ops += work(state, t); });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    const double ns = timer.ElapsedNs();
+    counters.Stop();
+    const double allocated = static_cast<double>(alloc_checker::AllocCount() - allocations);
+    const size_t peak_rss = bench::PeakRssKb();
+
+    char label[64];
+    std::snprintf(label, sizeof(label), "%s, %zu threads", name, threads);
+    std::printf("%-48s %12.3f ms %10.2f ns/op\n", label, ns / 1e6, ns / ops);
+    std::printf("  %.2f Mops/s, %.2f allocations per op, peak RSS %zu KiB (+%zu)\n",
+                ops * 1e3 / ns, allocated / ops, peak_rss, peak_rss - start_rss);
+    counters.Print(ops);
+}
+
+template <typename T>
+using StdUnique = std::unique_ptr<T>;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// ast
+
+template <template <typename> typename Unique>
+class Interpreter {
+public:
+    static constexpr size_t kVariables = 8;
+
+    struct Expr {
+        virtual ~Expr() = default;
+        virtual uint64_t Eval(const uint64_t* vars) const = 0;
+    };
+
+    using ExprPtr = Unique<Expr>;
+
+    // A tree of up to `depth` levels whose branches stop early at random.
+    static ExprPtr Build(std::mt19937_64& rng, int depth, size_t& nodes) {
+        ++nodes;
+        uint64_t bits = rng();
+        if (depth == 0 || bits % 8 == 0) {
+            if (bits & 16) {
+                return ExprPtr(new Const(bits >> 32));
+            }
+            return ExprPtr(new Var((bits >> 8) % kVariables));
+        }
+        auto lhs = Build(rng, depth - 1, nodes);
+        auto rhs = Build(rng, depth - 1, nodes);
+        return ExprPtr(new Binary(static_cast<Op>((bits >> 8) % 3), std::move(lhs), std::move(rhs)));
+    }
+
+    static size_t Run(size_t thread, size_t size) {
+        std::mt19937_64 rng(thread);
+        uint64_t vars[kVariables] = {};
+        uint64_t sum = 0;
+        size_t nodes = 0;
+        for (int round = 0; round < 10; ++round) {
+            std::vector<ExprPtr> forest;
+            for (size_t alive = 0; alive < size;) {
+                forest.push_back(Build(rng, 12, alive));
+            }
+            nodes += size;
+            for (auto& var : vars) {
+                var = rng();
+            }
+            for (const auto& tree : forest) {
+                sum += tree->Eval(vars);
+            }
+        }
+        bench::DoNotOptimize(sum);
+        return nodes;
+    }
+
+private:
+    enum class Op { kAdd, kSub, kMul };
+
+    struct Const : Expr {
+        explicit Const(uint64_t value) : value(value) {
+        }
+        uint64_t Eval(const uint64_t*) const override {
+            return value;
+        }
+
+        uint64_t value;
+    };
+
+    struct Var : Expr {
+        explicit Var(size_t index) : index(index) {
+        }
+        uint64_t Eval(const uint64_t* vars) const override {
+            return vars[index];
+        }
+
+        size_t index;
+    };
+
+    struct Binary : Expr {
+        Binary(Op op, ExprPtr lhs, ExprPtr rhs) : op(op), lhs(std::move(lhs)), rhs(std::move(rhs)) {
+        }
+        uint64_t Eval(const uint64_t* vars) const override {
+            uint64_t a = lhs->Eval(vars);
+            uint64_t b = rhs->Eval(vars);
+            switch (op) {
+                case Op::kAdd:
+                    return a + b;
+                case Op::kSub:
+                    return a - b;
+                default:
+                    return a * b;
+            }
+        }
+
+        Op op;
+        ExprPtr lhs;
+        ExprPtr rhs;
+    };
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// lru
+
+struct Value {
+    explicit Value(uint64_t key) {
+        for (auto& word : data) {
+            word = key;
+        }
+    }
+
+    uint64_t data[8];
+};
+
+struct OurCache {
+    using ValuePtr = SharedPtr<const Value, AtomicCounting>;
+    using Handle = WeakPtr<const Value, AtomicCounting>;
+
+    explicit OurCache(size_t capacity) : cache(capacity) {
+    }
+
+    ValuePtr Get(uint64_t key) {
+        return cache.Get(key);
+    }
+
+    ValuePtr Emplace(uint64_t key) {
+        return cache.Emplace(key, key);
+    }
+
+    static ValuePtr Lock(const Handle& handle) {
+        return handle.Lock();
+    }
+
+    ShardedLruCache<uint64_t, Value> cache;
+};
+
+// std::list in recency order and an index into it, under one mutex
+struct StdCache {
+    using ValuePtr = std::shared_ptr<const Value>;
+    using Handle = std::weak_ptr<const Value>;
+
+    explicit StdCache(size_t capacity) : capacity(capacity) {
+    }
+
+    ValuePtr Get(uint64_t key) {
+        std::lock_guard lock(mutex);
+        auto it = index.find(key);
+        if (it == index.end()) {
+            return {};
+        }
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->second;
+    }
+
+    ValuePtr Emplace(uint64_t key) {
+        auto value = std::make_shared<const Value>(key);
+        std::lock_guard lock(mutex);
+        if (auto it = index.find(key); it != index.end()) {
+            it->second->second = value;
+            return value;
+        }
+        lru.emplace_front(key, value);
+        index.emplace(key, lru.begin());
+        if (lru.size() > capacity) {
+            index.erase(lru.back().first);
+            lru.pop_back();
+        }
+        return value;
+    }
+
+    static ValuePtr Lock(const Handle& handle) {
+        return handle.lock();
+    }
+
+    std::mutex mutex;
+    size_t capacity;
+    std::list<std::pair<uint64_t, ValuePtr>> lru;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, ValuePtr>>::iterator> index;
+};
+
+// Each client remembers the values it used last and asks the cache only when the
+// handle has expired.
+template <typename Cache>
+size_t RunLru(Cache& cache, size_t thread, size_t size) {
+    constexpr size_t kHandles = 256;
+    struct Slot {
+        uint64_t key = ~uint64_t{0};
+        typename Cache::Handle handle;
+    };
+    std::vector<Slot> slots(kHandles);
+    std::mt19937_64 rng(thread);
+    std::uniform_real_distribution<double> uniform;
+    const size_t keys = size * 4;
+    const size_t lookups = size * 10;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < lookups; ++i) {
+        double u = uniform(rng);
+        uint64_t key = static_cast<uint64_t>(u * u * u * keys);
+        Slot& slot = slots[key % kHandles];
+        typename Cache::ValuePtr value;
+        if (slot.key == key) {
+            value = Cache::Lock(slot.handle);
+        }
+        if (!value) {
+            value = cache.Get(key);
+            if (!value) {
+                value = cache.Emplace(key);
+            }
+            slot.key = key;
+            slot.handle = value;
+        }
+        sum += value->data[i % 8];
+    }
+    bench::DoNotOptimize(sum);
+    return lookups;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// graph
+
+struct IntrusiveNodes {
+    struct Node : AtomicRefCounted<Node> {
+        explicit Node(uint32_t id) : id(id) {
+        }
+
+        uint32_t id;
+        std::vector<IntrusivePtr<Node>> edges;
+    };
+
+    using NodePtr = IntrusivePtr<Node>;
+
+    static NodePtr New(uint32_t id) {
+        return MakeIntrusive<Node>(id);
+    }
+};
+
+struct StdNodes {
+    struct Node {
+        explicit Node(uint32_t id) : id(id) {
+        }
+
+        uint32_t id;
+        std::vector<std::shared_ptr<Node>> edges;
+    };
+
+    using NodePtr = std::shared_ptr<Node>;
+
+    static NodePtr New(uint32_t id) {
+        return std::make_shared<Node>(id);
+    }
+};
+
+// Edges only lead to later nodes, so the counts never form cycles.
+template <typename Nodes>
+std::vector<typename Nodes::NodePtr> BuildGraph(size_t size) {
+    constexpr size_t kDegree = 8;
+    std::vector<typename Nodes::NodePtr> nodes;
+    nodes.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        nodes.push_back(Nodes::New(static_cast<uint32_t>(i)));
+    }
+    std::mt19937_64 rng(size);
+    for (size_t i = 0; i + 1 < size; ++i) {
+        for (size_t e = 0; e < kDegree; ++e) {
+            size_t span = std::min<size_t>(size - i - 1, 1024);
+            nodes[i]->edges.push_back(nodes[i + 1 + rng() % span]);
+        }
+    }
+    return nodes;
+}
+
+// The frontier holds owning pointers, as traversals that may outlive an unlink do.
+template <typename Nodes>
+size_t RunBfs(const std::vector<typename Nodes::NodePtr>& nodes, size_t thread) {
+    constexpr int kTraversals = 16;
+    std::vector<uint32_t> visited(nodes.size(), 0);
+    std::vector<typename Nodes::NodePtr> frontier, next;
+    std::mt19937_64 rng(thread);
+    size_t edges = 0;
+    for (uint32_t epoch = 1; epoch <= kTraversals; ++epoch) {
+        frontier.push_back(nodes[rng() % (nodes.size() / 16 + 1)]);
+        visited[frontier.back()->id] = epoch;
+        while (!frontier.empty()) {
+            for (const auto& node : frontier) {
+                for (const auto& edge : node->edges) {
+                    ++edges;
+                    if (visited[edge->id] != epoch) {
+                        visited[edge->id] = epoch;
+                        next.push_back(edge);
+                    }
+                }
+            }
+            frontier.clear();
+            frontier.swap(next);
+        }
+    }
+    return edges;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// pubsub
+
+struct Message {
+    uint64_t id;
+    char payload[56];
+};
+
+// Atomic counting, as std::shared_ptr always does.
+struct OurPointers {
+    template <typename T>
+    using Shared = SharedPtr<T, AtomicCounting>;
+
+    template <typename T>
+    using EnableShared = EnableSharedFromThis<T, AtomicCounting>;
+
+    template <typename T, typename... Args>
+    static Shared<T> Make(Args&&... args) {
+        return MakeShared<T, AtomicCounting>(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    static Shared<T> Self(T* object) {
+        return object->SharedFromThis();
+    }
+};
+
+struct StdPointers {
+    template <typename T>
+    using Shared = std::shared_ptr<T>;
+
+    template <typename T>
+    using EnableShared = std::enable_shared_from_this<T>;
+
+    template <typename T, typename... Args>
+    static Shared<T> Make(Args&&... args) {
+        return std::make_shared<T>(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    static Shared<T> Self(T* object) {
+        return object->shared_from_this();
+    }
+};
+
+template <typename Pointers>
+class PubSub {
+public:
+    using MessagePtr = typename Pointers::template Shared<const Message>;
+    using Callback = std::function<void(const MessagePtr&)>;
+
+    static constexpr size_t kTopics = 16;
+
+    struct Subscription {
+        uint64_t token;
+        Callback callback;
+    };
+
+    class Broker {
+    public:
+        uint64_t Subscribe(size_t topic, Callback callback) {
+            topics_[topic].push_back({++last_token_, std::move(callback)});
+            return last_token_;
+        }
+
+        void Unsubscribe(size_t topic, uint64_t token) {
+            auto& subscriptions = topics_[topic];
+            for (auto& subscription : subscriptions) {
+                if (subscription.token == token) {
+                    std::swap(subscription, subscriptions.back());
+                    subscriptions.pop_back();
+                    return;
+                }
+            }
+        }
+
+        size_t Publish(size_t topic, const MessagePtr& message) {
+            for (auto& subscription : topics_[topic]) {
+                subscription.callback(message);
+            }
+            return topics_[topic].size();
+        }
+
+    private:
+        std::vector<Subscription> topics_[kTopics];
+        uint64_t last_token_ = 0;
+    };
+
+    class Subscriber : public Pointers::template EnableShared<Subscriber> {
+    public:
+        // The subscription keeps the subscriber alive until it is cancelled.
+        void Subscribe(Broker& broker, size_t topic) {
+            topic_ = topic;
+            token_ = broker.Subscribe(topic, [self = Pointers::Self(this)](const MessagePtr& message) {
+                self->OnMessage(message);
+            });
+        }
+
+        void Unsubscribe(Broker& broker) {
+            broker.Unsubscribe(topic_, token_);
+        }
+
+        uint64_t Received() const {
+            return received_;
+        }
+
+    private:
+        void OnMessage(const MessagePtr& message) {
+            received_ += message->id;
+            recent_[received_ % 4] = message;
+        }
+
+        size_t topic_ = 0;
+        uint64_t token_ = 0;
+        uint64_t received_ = 0;
+        MessagePtr recent_[4];
+    };
+
+    using SubscriberPtr = typename Pointers::template Shared<Subscriber>;
+
+    static size_t Run(size_t thread, size_t size) {
+        constexpr size_t kMessages = 1000;
+        std::mt19937_64 rng(thread);
+        Broker broker;
+        // Only the subscriptions own the subscribers; these are for churn.
+        std::vector<Subscriber*> subscribers;
+        auto subscribe = [&] {
+            auto subscriber = Pointers::template Make<Subscriber>();
+            subscriber->Subscribe(broker, rng() % kTopics);
+            return &*subscriber;
+        };
+        for (size_t i = 0; i < size / 10; ++i) {
+            subscribers.push_back(subscribe());
+        }
+
+        size_t deliveries = 0;
+        for (size_t id = 0; id < kMessages; ++id) {
+            Message message{id, {}};
+            std::memset(message.payload, static_cast<int>(id), sizeof(message.payload));
+            deliveries += broker.Publish(rng() % kTopics, Pointers::template Make<const Message>(message));
+
+            if (!subscribers.empty()) {
+                Subscriber*& victim = subscribers[rng() % subscribers.size()];
+                bench::DoNotOptimize(victim->Received());
+                victim->Unsubscribe(broker);
+                victim = subscribe();
+            }
+        }
+        return deliveries;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+void Ast(size_t threads, size_t size) {
+    auto none = [] { return 0; };
+    Measure("ast, UniquePtr", threads, none,
+            [&](int, size_t t) { return Interpreter<UniquePtr>::Run(t, size); });
+    Measure("ast, std::unique_ptr", threads, none,
+            [&](int, size_t t) { return Interpreter<StdUnique>::Run(t, size); });
+}
+
+void Lru(size_t threads, size_t size) {
+    Measure("lru, ShardedLruCache + WeakPtr", threads,
+            [&] { return std::make_unique<OurCache>(size); },
+            [&](auto& cache, size_t t) { return RunLru(*cache, t, size); });
+    Measure("lru, std::list + std::weak_ptr", threads,
+            [&] { return std::make_unique<StdCache>(size); },
+            [&](auto& cache, size_t t) { return RunLru(*cache, t, size); });
+}
+
+void Graph(size_t threads, size_t size) {
+    Measure("graph, IntrusivePtr", threads, [&] { return BuildGraph<IntrusiveNodes>(size); },
+            [](const auto& nodes, size_t t) { return RunBfs<IntrusiveNodes>(nodes, t); });
+    Measure("graph, std::shared_ptr", threads, [&] { return BuildGraph<StdNodes>(size); },
+            [](const auto& nodes, size_t t) { return RunBfs<StdNodes>(nodes, t); });
+}
+
+void PubSubFanOut(size_t threads, size_t size) {
+    auto none = [] { return 0; };
+    Measure("pubsub, SharedFromThis + AtomicCounting", threads, none,
+            [&](int, size_t t) { return PubSub<OurPointers>::Run(t, size); });
+    Measure("pubsub, std::shared_from_this", threads, none,
+            [&](int, size_t t) { return PubSub<StdPointers>::Run(t, size); });
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    const char* workload = argc > 1 ? argv[1] : "all";
+    const size_t threads = bench::SizeArg(argc, argv, 2, 1);
+    const size_t size = bench::SizeArg(argc, argv, 3, 100'000);
+
+    const struct {
+        const char* name;
+        void (*run)(size_t, size_t);
+    } workloads[] = {{"ast", Ast}, {"lru", Lru}, {"graph", Graph}, {"pubsub", PubSubFanOut}};
+
+    bool found = false;
+    for (const auto& entry : workloads) {
+        if (!std::strcmp(workload, "all") || !std::strcmp(workload, entry.name)) {
+            entry.run(threads, size);
+            found = true;
+        }
+    }
+    if (!found) {
+        std::fprintf(stderr, "Unknown workload %s: use ast, lru, graph, pubsub or all\n", workload);
+        return 1;
+    }
+    return 0;
+}
@@ -1,6 +1,6 @@
 function(add_max_flow_executable NAME)
     add_executable(${NAME} ${ARGN})
-    target_include_directories(${NAME} PRIVATE ${CMAKE_CURRENT_SOURCE_DIR})
+    target_link_libraries(${NAME} smart_pointers)
 endfunction()
 
 function(add_catch TARGET)
@@ -0,0 +1,244 @@
+#pragma once
+
+#include "trim.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Bump allocator that reserves memory in 2 MiB chunks and asks the kernel to back
+// them with transparent huge pages. If THP is disabled (or the platform has no
+// madvise) the chunks simply stay on regular pages.
+// Individual deallocations are no-ops; memory is returned when the arena dies.
+// The only part that can go back earlier is the unused end of the current chunk,
+// which a huge page backs as soon as the chunk is touched: see Trim.
+class HugePageArena : public Trimmable {
+public:
+    static constexpr size_t kChunkBytes = size_t{2} << 20;
+
+    explicit HugePageArena(bool use_huge_pages = true) : use_huge_pages_(use_huge_pages) {
+    }
+
+    HugePageArena(const HugePageArena&) = delete;
+    HugePageArena& operator=(const HugePageArena&) = delete;
+
+    ~HugePageArena() {
+        for (auto [chunk, size] : chunks_) {
+            ReleaseChunk(chunk, size);
+        }
+    }
+
+    void* Allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        std::lock_guard lock(mutex_);
+        uintptr_t start = (current_ + align - 1) & ~(uintptr_t{align} - 1);
+        if (!current_ || start + size > end_) {
+            size_t chunk_size = (size + align + kChunkBytes - 1) / kChunkBytes * kChunkBytes;
+            current_ = reinterpret_cast<uintptr_t>(ReserveChunk(chunk_size));
+            end_ = current_ + chunk_size;
+            start = (current_ + align - 1) & ~(uintptr_t{align} - 1);
+        }
+        current_ = start + size;
+        return reinterpret_cast<void*>(start);
+    }
+
+    void Deallocate(void*, size_t) {
+    }
+
+    // Releases the pages past the last allocation of a huge-page chunk if nothing
+    // has been allocated since the previous Trim at least `idle` ago. Allocating
+    // there later faults in regular pages.
+    size_t Trim(Clock::duration idle) override {
+        std::lock_guard lock(mutex_);
+        const auto now = Clock::now();
+        if (current_ != trim_mark_) {
+            trim_mark_ = current_;
+            trim_mark_time_ = now;
+        }
+        if (now - trim_mark_time_ < idle) {
+            return 0;
+        }
+        size_t released = 0;
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+        const uintptr_t page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        const uintptr_t from = (current_ + page - 1) & ~(page - 1);
+        if (current_huge_ && from < released_from_ &&
+            madvise(reinterpret_cast<void*>(from), released_from_ - from, MADV_DONTNEED) == 0) {
+            released = released_from_ - from;
+            released_from_ = from;
+            trimmed_bytes_ += released;
+        }
+#endif
+        return released;
+    }
+
+    // Bytes given back by Trim over the life of the arena
+    size_t TrimmedBytes() const {
+        std::lock_guard lock(mutex_);
+        return trimmed_bytes_;
+    }
+
+    size_t ChunkCount() const {
+        std::lock_guard lock(mutex_);
+        return chunks_.size();
+    }
+
+    // Chunks for which the kernel accepted the huge page hint.
+    size_t HugePageChunkCount() const {
+        std::lock_guard lock(mutex_);
+        return huge_chunks_;
+    }
+
+    // Process-wide arena used when no ArenaScope is active.
+    static HugePageArena& Default() {
+        static HugePageArena arena;
+        return arena;
+    }
+
+    // Arena selected by the innermost ArenaScope of the calling thread.
+    static HugePageArena& Current() {
+        return current_arena ? *current_arena : Default();
+    }
+
+private:
+    friend class ArenaScope;
+
+    void* ReserveChunk(size_t size) {
+#ifdef __linux__
+        // Over-reserve so the chunk can be aligned to the huge page size.
+        size_t reserved = size + kChunkBytes;
+        void* raw = mmap(nullptr, reserved, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        auto begin = reinterpret_cast<uintptr_t>(raw);
+        auto aligned = (begin + kChunkBytes - 1) & ~(uintptr_t{kChunkBytes} - 1);
+        if (aligned != begin) {
+            munmap(raw, aligned - begin);
+        }
+        if (aligned + size != begin + reserved) {
+            munmap(reinterpret_cast<void*>(aligned + size), begin + reserved - aligned - size);
+        }
+        void* chunk = reinterpret_cast<void*>(aligned);
+        current_huge_ = false;
+        released_from_ = aligned + size;
+#ifdef MADV_HUGEPAGE
+        if (use_huge_pages_ && madvise(chunk, size, MADV_HUGEPAGE) == 0) {
+            ++huge_chunks_;
+            current_huge_ = true;
+        }
+#endif
+#else
+        void* chunk = ::operator new(size, std::align_val_t{kChunkBytes});
+#endif
+        chunks_.emplace_back(chunk, size);
+        return chunk;
+    }
+
+    static void ReleaseChunk(void* chunk, size_t size) {
+#ifdef __linux__
+        munmap(chunk, size);
+#else
+        ::operator delete(chunk, size, std::align_val_t{kChunkBytes});
+#endif
+    }
+
+    static inline thread_local HugePageArena* current_arena = nullptr;
+
+    mutable std::mutex mutex_;
+    bool use_huge_pages_;
+    uintptr_t current_ = 0;
+    uintptr_t end_ = 0;
+    size_t huge_chunks_ = 0;
+    bool current_huge_ = false;
+    uintptr_t released_from_ = 0;  // end of the current chunk, or where Trim cut it
+    uintptr_t trim_mark_ = 0;      // `current_` when Trim last saw it change
+    Clock::time_point trim_mark_time_;
+    size_t trimmed_bytes_ = 0;
+    std::vector<std::pair<void*, size_t>> chunks_;
+};
+
+// Makes `arena` the current arena of this thread until the scope ends.
+class ArenaScope {
+public:
+    explicit ArenaScope(HugePageArena& arena) : previous_(HugePageArena::current_arena) {
+        HugePageArena::current_arena = &arena;
+    }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+    ~ArenaScope() {
+        HugePageArena::current_arena = previous_;
+    }
+
+private:
+    HugePageArena* previous_;
+};
+
+template <typename T, typename... Args>
+T* ArenaNew(HugePageArena& arena, Args&&... args) {
+    return new (arena.Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+}
+
+// Standard allocator interface, e.g. for AllocateShared.
+template <typename T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator(HugePageArena& arena = HugePageArena::Current()) : arena_(&arena) {
+    }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena_) {
+    }
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(arena_->Allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T* p, size_t n) {
+        arena_->Deallocate(p, n * sizeof(T));
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const {
+        return arena_ == other.arena_;
+    }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+
+    HugePageArena* arena_;
+};
+
+// UniquePtr deleter for objects created with ArenaNew: runs the destructor only.
+template <typename T>
+struct ArenaDeleter {
+    void operator()(T* p) const {
+        if (p) {
+            p->~T();
+        }
+    }
+};
+
+// RefCounted deleter: MakeIntrusive places objects in the current arena.
+struct ArenaDelete {
+    template <typename T, typename... Args>
+    static T* Create(Args&&... args) {
+        return ArenaNew<T>(HugePageArena::Current(), std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    static void Destroy(T* object) {
+        object->~T();
+    }
+};
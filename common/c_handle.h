@@ -0,0 +1,27 @@
+#pragma once
+
+// A C library that counts its handles itself, for tests of external reference
+// counting.
+struct c_handle {
+    int refs;
+    int value;
+};
+
+inline int c_handles_alive = 0;
+
+inline c_handle* c_handle_new(int value) {
+    ++c_handles_alive;
+    return new c_handle{1, value};
+}
+inline void c_handle_ref(c_handle* handle) {
+    ++handle->refs;
+}
+inline void c_handle_unref(c_handle* handle) {
+    if (!--handle->refs) {
+        --c_handles_alive;
+        delete handle;
+    }
+}
+inline int c_handle_refcount(c_handle* handle) {
+    return handle->refs;
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+enum class PrefetchMode { kRead = 0, kWrite = 1 };
+
+// Mirrors the locality argument of __builtin_prefetch: kNone means "no temporal
+// locality" (evict soon), kHigh keeps the line in all cache levels.
+enum class PrefetchLocality { kNone = 0, kLow = 1, kModerate = 2, kHigh = 3 };
+
+template <PrefetchMode Mode = PrefetchMode::kRead, PrefetchLocality Locality = PrefetchLocality::kHigh>
+inline void PrefetchAddress(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, static_cast<int>(Mode), static_cast<int>(Locality));
+#else
+    (void)address;
+#endif
+}
+
+// Prefetches whatever `value` points to: smart pointers use their own `Prefetch()`,
+// raw pointers are prefetched directly.
+template <PrefetchMode Mode = PrefetchMode::kRead, PrefetchLocality Locality = PrefetchLocality::kHigh,
+          typename Pointer>
+inline void PrefetchPointee(const Pointer& value) {
+    if constexpr (requires { value.template Prefetch<Mode, Locality>(); }) {
+        value.template Prefetch<Mode, Locality>();
+    } else {
+        PrefetchAddress<Mode, Locality>(&*value);
+    }
+}
+
+// Forward iterator adaptor over a range of pointers that keeps a second iterator
+// `Distance` elements ahead and prefetches its pointee on every step.
+template <typename Iterator, size_t Distance = 8>
+class PrefetchingIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = typename std::iterator_traits<Iterator>::value_type;
+    using difference_type = typename std::iterator_traits<Iterator>::difference_type;
+    using pointer = typename std::iterator_traits<Iterator>::pointer;
+    using reference = typename std::iterator_traits<Iterator>::reference;
+
+    PrefetchingIterator() = default;
+
+    PrefetchingIterator(Iterator current, Iterator end) : current_(current), lead_(current), end_(end) {
+        for (size_t i = 0; i < Distance && lead_ != end_; ++i, ++lead_) {
+            PrefetchPointee(*lead_);
+        }
+    }
+
+    reference operator*() const {
+        return *current_;
+    }
+
+    pointer operator->() const {
+        return std::to_address(current_);
+    }
+
+    PrefetchingIterator& operator++() {
+        if (lead_ != end_) {
+            PrefetchPointee(*lead_);
+            ++lead_;
+        }
+        ++current_;
+        return *this;
+    }
+
+    PrefetchingIterator operator++(int) {
+        PrefetchingIterator copy = *this;
+        ++*this;
+        return copy;
+    }
+
+    bool operator==(const PrefetchingIterator& other) const {
+        return current_ == other.current_;
+    }
+
+private:
+    Iterator current_{}, lead_{}, end_{};
+};
+
+// Range wrapper: `for (auto& p : PrefetchAhead<8>(nodes)) { ... }`.
+template <size_t Distance = 8, typename Range>
+auto PrefetchAhead(Range& range) {
+    using Iterator = decltype(std::begin(range));
+    struct View {
+        PrefetchingIterator<Iterator, Distance> begin() const {
+            return {first, last};
+        }
+        PrefetchingIterator<Iterator, Distance> end() const {
+            return {last, last};
+        }
+        Iterator first, last;
+    };
+    return View{std::begin(range), std::end(range)};
+}
+
+// Walks a pointer-chasing list (`next(node)` returns the successor or a null pointer).
+// Successors are resolved `Distance` nodes ahead of the visited one, so the payload of
+// the visited node is already in flight by the time `visit` runs.
+template <size_t Distance = 8, typename Node, typename Next, typename Visit>
+void ForEachPrefetched(Node head, Next next, Visit visit) {
+    Node window[Distance + 1];
+    size_t size = 0;
+    Node lead = std::move(head);
+    for (; size <= Distance && lead; ++size) {
+        PrefetchPointee(lead);
+        window[size] = lead;
+        lead = next(lead);
+    }
+    for (size_t pos = 0; size; pos = (pos + 1) % (Distance + 1), --size) {
+        visit(window[pos]);
+        if (lead) {
+            PrefetchPointee(lead);
+            window[pos] = lead;
+            lead = next(lead);
+            ++size;
+        }
+    }
+}
+
+// Level-order traversal of a tree: a whole level is prefetched before any of its
+// nodes is visited, then `children(node, out)` appends the next level.
+template <typename Node, typename Children, typename Visit>
+void ForEachLevelPrefetched(std::vector<Node> level, Children children, Visit visit) {
+    std::vector<Node> next_level;
+    while (!level.empty()) {
+        for (const auto& node : level) {
+            PrefetchPointee(node);
+        }
+        for (const auto& node : level) {
+            visit(node);
+            children(node, next_level);
+        }
+        level.swap(next_level);
+        next_level.clear();
+    }
+}
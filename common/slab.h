@@ -0,0 +1,294 @@
+#pragma once
+
+#include "trim.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+
+// Occupancy of one size class.
+struct SlabStats {
+    size_t slabs = 0;
+    size_t capacity = 0;  // slots in all live slabs
+    size_t in_use = 0;    // slots held by objects or parked in thread caches
+    size_t cached = 0;    // empty slabs kept for reuse, see SetCachedSlabLimit
+    size_t hits = 0;      // slabs taken from the cache
+    size_t misses = 0;    // slabs allocated from the system
+    size_t trimmed = 0;   // cached slabs released by Trim
+
+    // Share of reserved slots that hold no object.
+    double Fragmentation() const {
+        return capacity ? 1.0 - static_cast<double>(in_use) / capacity : 0.0;
+    }
+};
+
+class SlabAllocatorBase {
+public:
+    // Slabs are aligned to their size, so the owning slab of a slot is found by masking.
+    static constexpr size_t kSlabBytes = size_t{1} << 16;
+
+    // Returns a slot obtained from any SlabAllocator to its slab.
+    static void Free(void* slot) {
+        auto address = reinterpret_cast<uintptr_t>(slot) & ~(kSlabBytes - 1);
+        auto* slab = reinterpret_cast<SlabHeader*>(address);
+        slab->owner->Deallocate(slab, slot);
+    }
+
+protected:
+    struct SlabHeader {
+        SlabAllocatorBase* owner;
+    };
+
+    virtual void Deallocate(SlabHeader* slab, void* slot) = 0;
+
+    ~SlabAllocatorBase() = default;
+};
+
+// Fixed-size slot allocator: slabs of contiguous slots with a free bitmap
+// (bit set = slot free). A slab is returned to the system as soon as all of its
+// slots are back, including those parked in per-thread caches, unless the cache
+// of empty slabs has room (none by default); Trim releases the cached ones.
+template <size_t Size, size_t Align>
+class SlabAllocator : public SlabAllocatorBase, public Trimmable {
+    static_assert(Size % Align == 0);
+    static_assert(Size <= kSlabBytes / 8, "object is too large for slab allocation");
+
+    static constexpr size_t kMaxSlots = kSlabBytes / Size;
+    static constexpr size_t kWords = (kMaxSlots + 63) / 64;
+
+    struct Slab : SlabHeader {
+        Slab* prev;
+        Slab* next;
+        size_t free;
+        size_t first_word;  // no free slots below this bitmap word
+        Clock::time_point emptied;  // while cached
+        uint64_t bitmap[kWords];
+    };
+
+    static constexpr size_t kHeaderBytes = (sizeof(Slab) + Align - 1) / Align * Align;
+
+public:
+    static constexpr size_t kSlotsPerSlab = (kSlabBytes - kHeaderBytes) / Size;
+
+    static SlabAllocator& Instance() {
+        static SlabAllocator instance;
+        return instance;
+    }
+
+    void* Allocate() {
+        auto& cache = ThreadCache();
+        if (!cache.size) {
+            // Filled top-down so that slots are handed out in slab order.
+            std::lock_guard lock(mutex_);
+            cache.size = kCacheSize / 2;
+            for (size_t i = cache.size; i-- > 0;) {
+                cache.slots[i] = TakeSlot();
+            }
+        }
+        return cache.slots[--cache.size];
+    }
+
+    // Returns slots cached by the calling thread to their slabs.
+    void Flush() {
+        auto& cache = ThreadCache();
+        std::lock_guard lock(mutex_);
+        while (cache.size) {
+            PutSlot(cache.slots[--cache.size]);
+        }
+    }
+
+    SlabStats Stats() const {
+        std::lock_guard lock(mutex_);
+        return {slabs_, slabs_ * kSlotsPerSlab, in_use_, cached_, hits_, misses_, trimmed_};
+    }
+
+    // Keeps up to `slabs` empty slabs for reuse instead of freeing them at once,
+    // so that a pool shrinking and growing around one size does not go to the
+    // system every time.
+    void SetCachedSlabLimit(size_t slabs) {
+        std::lock_guard lock(mutex_);
+        cached_limit_ = slabs;
+        while (cached_ > cached_limit_) {
+            DeleteSlab(PopCached());
+        }
+    }
+
+    // Returns the slots cached by the calling thread (other threads keep theirs
+    // until they Flush or exit) and frees the slabs cached for at least `idle`.
+    size_t Trim(Clock::duration idle) override {
+        Flush();
+        std::lock_guard lock(mutex_);
+        const auto deadline = Clock::now() - idle;
+        // Newest first: everything after the first old enough slab is older.
+        Slab** link = &cached_top_;
+        while (*link && (*link)->emptied > deadline) {
+            link = &(*link)->next;
+        }
+        size_t released = 0;
+        for (Slab* slab = std::exchange(*link, nullptr); slab;) {
+            Slab* next = slab->next;
+            DeleteSlab(slab);
+            ++released;
+            slab = next;
+        }
+        cached_ -= released;
+        trimmed_ += released;
+        return released * kSlabBytes;
+    }
+
+private:
+    SlabAllocator() = default;
+
+    // Each thread keeps a small stack of free slots so that most allocations
+    // and deallocations do not touch the slabs or the lock.
+    static constexpr size_t kCacheSize = 64;
+
+    struct Cache {
+        ~Cache() {
+            Instance().Flush();
+        }
+
+        size_t size = 0;
+        void* slots[kCacheSize];
+    };
+
+    static Cache& ThreadCache() {
+        static thread_local Cache cache;
+        return cache;
+    }
+
+    void Deallocate(SlabHeader*, void* slot) override {
+        auto& cache = ThreadCache();
+        if (cache.size == kCacheSize) {
+            std::lock_guard lock(mutex_);
+            while (cache.size > kCacheSize / 2) {
+                PutSlot(cache.slots[--cache.size]);
+            }
+        }
+        cache.slots[cache.size++] = slot;
+    }
+
+    void* TakeSlot() {
+        if (!partial_) {
+            Link(cached_top_ ? ReuseSlab() : NewSlab());
+        }
+        Slab* slab = partial_;
+        size_t word = slab->first_word;
+        while (!slab->bitmap[word]) {
+            ++word;
+        }
+        slab->first_word = word;
+        size_t bit = std::countr_zero(slab->bitmap[word]);
+        slab->bitmap[word] &= slab->bitmap[word] - 1;
+        if (!--slab->free) {
+            Unlink(slab);
+        }
+        ++in_use_;
+        return reinterpret_cast<char*>(slab) + kHeaderBytes + (word * 64 + bit) * Size;
+    }
+
+    void PutSlot(void* slot) {
+        auto address = reinterpret_cast<uintptr_t>(slot) & ~(kSlabBytes - 1);
+        auto* slab = reinterpret_cast<Slab*>(address);
+        size_t index = (static_cast<char*>(slot) - reinterpret_cast<char*>(slab) - kHeaderBytes) / Size;
+        slab->bitmap[index / 64] |= uint64_t{1} << (index % 64);
+        slab->first_word = std::min(slab->first_word, index / 64);
+        --in_use_;
+        if (!slab->free++) {
+            Link(slab);
+        }
+        if (slab->free == kSlotsPerSlab) {
+            Unlink(slab);
+            --slabs_;
+            if (cached_ < cached_limit_) {
+                slab->emptied = Clock::now();
+                slab->next = cached_top_;
+                cached_top_ = slab;
+                ++cached_;
+            } else {
+                DeleteSlab(slab);
+            }
+        }
+    }
+
+    Slab* PopCached() {
+        Slab* slab = cached_top_;
+        cached_top_ = slab->next;
+        slab->next = nullptr;
+        --cached_;
+        return slab;
+    }
+
+    // All of its slots are free already.
+    Slab* ReuseSlab() {
+        ++hits_;
+        ++slabs_;
+        Slab* slab = PopCached();
+        slab->first_word = 0;
+        return slab;
+    }
+
+    static void DeleteSlab(Slab* slab) {
+        ::operator delete(slab, std::align_val_t{kSlabBytes});
+    }
+
+    Slab* NewSlab() {
+        auto* slab = static_cast<Slab*>(::operator new(kSlabBytes, std::align_val_t{kSlabBytes}));
+        slab->owner = this;
+        slab->prev = slab->next = nullptr;
+        slab->free = kSlotsPerSlab;
+        slab->first_word = 0;
+        for (size_t word = 0; word < kWords; ++word) {
+            size_t first = word * 64;
+            size_t count = first >= kSlotsPerSlab ? 0 : std::min<size_t>(64, kSlotsPerSlab - first);
+            slab->bitmap[word] = count == 64 ? ~uint64_t{0} : (uint64_t{1} << count) - 1;
+        }
+        ++slabs_;
+        ++misses_;
+        return slab;
+    }
+
+    void Link(Slab* slab) {
+        slab->prev = nullptr;
+        slab->next = partial_;
+        if (partial_) {
+            partial_->prev = slab;
+        }
+        partial_ = slab;
+    }
+
+    void Unlink(Slab* slab) {
+        if (slab->prev) {
+            slab->prev->next = slab->next;
+        } else {
+            partial_ = slab->next;
+        }
+        if (slab->next) {
+            slab->next->prev = slab->prev;
+        }
+        slab->prev = slab->next = nullptr;
+    }
+
+    mutable std::mutex mutex_;
+    Slab* partial_ = nullptr;  // slabs with at least one free slot
+    size_t slabs_ = 0;
+    size_t in_use_ = 0;  // slots handed out to objects or thread caches
+    Slab* cached_top_ = nullptr;  // empty slabs linked through `next`, newest first
+    size_t cached_ = 0;
+    size_t cached_limit_ = 0;
+    size_t hits_ = 0;
+    size_t misses_ = 0;
+    size_t trimmed_ = 0;
+};
+
+template <typename T>
+constexpr size_t kSlabAlign = alignof(T) > 16 ? alignof(T) : 16;
+
+// Types of similar size share a size class rounded up to 16 bytes.
+template <typename T>
+using SlabAllocatorFor =
+    SlabAllocator<(sizeof(T) + kSlabAlign<T> - 1) / kSlabAlign<T> * kSlabAlign<T>, kSlabAlign<T>>;
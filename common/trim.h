@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// Memory that a pool or an arena keeps after its objects are gone.
+class Trimmable {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Gives back what has been cached for at least `idle`, everything when it is
+    // zero. Returns the number of bytes released.
+    virtual size_t Trim(Clock::duration idle) = 0;
+
+protected:
+    ~Trimmable() = default;
+};
+
+// "some avg10" of a Linux pressure stall file: the share of the last 10 seconds in
+// which some task waited for memory, in percent. Negative if it cannot be read
+// (kernels without PSI, other systems).
+inline double ReadMemoryPressure(const char* path = "/proc/pressure/memory") {
+    FILE* file = std::fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+    double avg10 = -1;
+    if (std::fscanf(file, "some avg10=%lf", &avg10) != 1) {
+        avg10 = -1;
+    }
+    std::fclose(file);
+    return avg10;
+}
+
+// Resident set size of the process, 0 if unknown.
+inline size_t ReadResidentBytes() {
+#ifdef __linux__
+    FILE* file = std::fopen("/proc/self/statm", "r");
+    if (!file) {
+        return 0;
+    }
+    unsigned long pages = 0;
+    unsigned long resident = 0;
+    if (std::fscanf(file, "%lu %lu", &pages, &resident) != 2) {
+        resident = 0;
+    }
+    std::fclose(file);
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#else
+    return 0;
+#endif
+}
+
+struct TrimOptions {
+    // Cached memory unused for this long is released in any case.
+    std::chrono::milliseconds idle = std::chrono::seconds(30);
+    // How often the background thread checks.
+    std::chrono::milliseconds period = std::chrono::seconds(1);
+    // Everything cached is released when memory pressure reaches this percentage ...
+    double pressure_percent = 10;
+    // ... or the resident set grows beyond this many bytes (0: no limit).
+    size_t rss_limit = 0;
+    std::string pressure_path = "/proc/pressure/memory";
+};
+
+struct TrimStats {
+    size_t checks = 0;
+    size_t idle_trims = 0;      // checks that released idle memory
+    size_t pressure_trims = 0;  // checks that found pressure and released everything
+    size_t bytes_released = 0;
+};
+
+// Trims a set of pools: memory idle for `idle` on every check, all cached memory
+// when PSI or RSS signal pressure. Checks run on Poll() or, after Start(), on a
+// background thread every `period`. Pools must be removed before they die.
+class MemoryTrimmer {
+public:
+    explicit MemoryTrimmer(TrimOptions options = {}) : options_(std::move(options)) {
+    }
+
+    MemoryTrimmer(const MemoryTrimmer&) = delete;
+    MemoryTrimmer& operator=(const MemoryTrimmer&) = delete;
+
+    ~MemoryTrimmer() {
+        Stop();
+    }
+
+    void Add(Trimmable& pool) {
+        std::lock_guard lock(mutex_);
+        pools_.push_back(&pool);
+    }
+
+    // Waits for a check that is trimming `pool`.
+    void Remove(Trimmable& pool) {
+        std::lock_guard lock(mutex_);
+        pools_.erase(std::remove(pools_.begin(), pools_.end(), &pool), pools_.end());
+    }
+
+    bool UnderPressure() const {
+        if (options_.pressure_percent > 0 &&
+            ReadMemoryPressure(options_.pressure_path.c_str()) >= options_.pressure_percent) {
+            return true;
+        }
+        return options_.rss_limit && ReadResidentBytes() > options_.rss_limit;
+    }
+
+    // One check. Returns whether it found pressure.
+    bool Poll() {
+        bool pressure = UnderPressure();
+        std::lock_guard lock(mutex_);
+        size_t released = 0;
+        for (Trimmable* pool : pools_) {
+            released += pool->Trim(pressure ? Trimmable::Clock::duration::zero() : options_.idle);
+        }
+        ++stats_.checks;
+        if (pressure) {
+            ++stats_.pressure_trims;
+        } else if (released) {
+            ++stats_.idle_trims;
+        }
+        stats_.bytes_released += released;
+        return pressure;
+    }
+
+    void Start() {
+        std::lock_guard lock(mutex_);
+        if (thread_.joinable()) {
+            return;
+        }
+        stop_ = false;
+        thread_ = std::thread([this] {
+            std::unique_lock lock(mutex_);
+            while (!wake_.wait_for(lock, options_.period, [this] { return stop_; })) {
+                lock.unlock();
+                Poll();
+                lock.lock();
+            }
+        });
+    }
+
+    void Stop() {
+        {
+            std::lock_guard lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    TrimStats Stats() const {
+        std::lock_guard lock(mutex_);
+        return stats_;
+    }
+
+private:
+    const TrimOptions options_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::vector<Trimmable*> pools_;
+    TrimStats stats_;
+    bool stop_ = false;
+    std::thread thread_;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "shared.h"
+
+#include <cstddef>
+#include <type_traits>
+
+// `n` objects that live and die together, e.g. the nodes of one parsed message.
+// They share one allocation and one control block; every SharedPtr handed out
+// by the batch aliases that block, so the whole batch stays alive while any
+// element is referenced.
+template <typename T, typename... Policies>
+class SharedBatch {
+public:
+    SharedBatch() = default;
+
+    size_t Size() const {
+        return size_;
+    }
+
+    bool Empty() const {
+        return !size_;
+    }
+
+    // Plain access; the reference is valid while the batch (or any shared element) lives.
+    T& operator[](size_t index) const {
+        return first_.Get()[index];
+    }
+
+    T* begin() const {  // NOLINT
+        return first_.Get();
+    }
+
+    T* end() const {  // NOLINT
+        return first_.Get() + size_;
+    }
+
+    // Owning pointer to one element
+    SharedPtr<T, Policies...> Share(size_t index) const {
+        return SharedPtr<T, Policies...>(first_, first_.Get() + index);
+    }
+
+    size_t UseCount() const {
+        return first_.UseCount();
+    }
+
+    template <typename Y, typename... P, typename Init>
+    friend SharedBatch<Y, P...> MakeSharedBatch(size_t size, Init init);
+
+private:
+    SharedBatch(SharedPtr<T, Policies...> first, size_t size) : first_(std::move(first)), size_(size) {
+    }
+
+    SharedPtr<T, Policies...> first_;
+    size_t size_ = 0;
+};
+
+// Builds element `i` from `init(i)`; one allocation for all `size` elements.
+template <typename T, typename... Policies, typename Init>
+SharedBatch<T, Policies...> MakeSharedBatch(size_t size, Init init) {
+    static_assert(!SharedPolicies<Policies...>::kThin, "batch elements alias the block");
+    static_assert(!std::is_const_v<T>, "use SharedBatch<T> and share `const T` from it");
+    if (!size) {
+        return {};
+    }
+    using Allocation = typename SharedPolicies<Policies...>::Allocation;
+    using Block = ControlBlockArray<T, SharedControlBlock<Policies...>, Allocation>;
+    Block* block = Block::New(size, init);
+    T* objects = block->Objects();
+    auto first = SharedPtrAccess::Adopt<T, Policies...>(block, objects);
+    for (size_t i = 1; i < size; ++i) {
+        SharedPtrAccess::InitWeakThis(first, objects + i);
+    }
+    return SharedBatch<T, Policies...>(std::move(first), size);
+}
+
+template <typename T, typename... Policies>
+SharedBatch<T, Policies...> MakeSharedBatch(size_t size) {
+    return MakeSharedBatch<T, Policies...>(size, [](size_t) { return T(); });
+}
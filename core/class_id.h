@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+// Compile-time class ids for RTTI-free downcasts (see FastPointerCast).
+// Number a hierarchy in pre-order and give every class the range of ids of its
+// subtree; the class itself owns the first id of its range:
+//
+//   template <> struct ClassIds<Message> : ClassIdRange<1, 4> {};
+//   template <> struct ClassIds<Request> : ClassIdRange<2, 3> {};  // Request : Message
+//   template <> struct ClassIds<Get> : ClassIdRange<3, 3> {};      // Get : Request
+//   template <> struct ClassIds<Reply> : ClassIdRange<4, 4> {};    // Reply : Message
+//
+// "Is a T" is then `ClassIds<T>::Contains(id)`. Id 0 means "not registered".
+
+template <uint32_t First, uint32_t Last>
+struct ClassIdRange {
+    static_assert(0 < First && First <= Last, "class ids start at 1");
+
+    static constexpr uint32_t kFirst = First;
+    static constexpr uint32_t kLast = Last;
+
+    static constexpr bool Contains(uint32_t id) {
+        return kFirst <= id && id <= kLast;
+    }
+};
+
+// Specialized per class; deliberately not inherited by derived classes.
+template <typename T>
+struct ClassIds;
+
+template <typename T>
+concept HasClassIds = requires {
+    ClassIds<std::remove_cv_t<T>>::kFirst;
+};
+
+// Id stored for an object created as `T`.
+template <typename T>
+constexpr uint32_t ClassIdOf() {
+    if constexpr (HasClassIds<T>) {
+        return ClassIds<std::remove_cv_t<T>>::kFirst;
+    } else {
+        return 0;
+    }
+}
+
+// Checks that a derived class was numbered inside its base.
+template <typename Derived, typename Base>
+constexpr bool kClassIdsNested =
+    ClassIds<std::remove_cv_t<Base>>::kFirst < ClassIds<std::remove_cv_t<Derived>>::kFirst &&
+    ClassIds<std::remove_cv_t<Derived>>::kLast <= ClassIds<std::remove_cv_t<Base>>::kLast;
@@ -0,0 +1,359 @@
+#pragma once
+
+#include "policies.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>  // std::allocator_traits
+#include <type_traits>
+#include <utility>
+
+// Thin-layout pointers read the object pointer from the block.
+template <bool Thin>
+class ControlBlockObjectSlot {
+public:
+    void SetObject(void*) {
+    }
+};
+
+template <>
+class ControlBlockObjectSlot<true> {
+public:
+    void* GetObject() const {
+        return object_;
+    }
+
+    void SetObject(void* object) {
+        object_ = object;
+    }
+
+private:
+    void* object_ = nullptr;
+};
+
+template <bool Stored>
+class ControlBlockClassId {
+public:
+    void SetClassId(uint32_t) {
+    }
+};
+
+template <>
+class ControlBlockClassId<true> {
+public:
+    uint32_t GetClassId() const {
+        return class_id_;
+    }
+
+    void SetClassId(uint32_t class_id) {
+        class_id_ = class_id;
+    }
+
+private:
+    uint32_t class_id_ = 0;
+};
+
+// Address that identifies a concrete block type without RTTI
+template <typename Block>
+inline constexpr char kBlockTag = 0;
+
+// Counters live in the base and are not virtual; only destruction is dispatched.
+// The weak counter holds one extra reference on behalf of all shared owners, so the
+// block dies exactly when the last shared or weak owner releases it.
+template <typename Counting, bool Thin, bool ClassIds = false>
+class ControlBlock : public ControlBlockObjectSlot<Thin>, public ControlBlockClassId<ClassIds> {
+public:
+    void IncreaseSharedCounter() {
+        Counting::Increment(shared_cnt_);
+    }
+
+    void DecreaseSharedCounter() {
+        if (!Counting::Decrement(shared_cnt_)) {
+            DestroyObject();
+            DecreaseWeakCounter();
+        }
+    }
+
+    // Drops `count` (> 0) references in one update if the policy can subtract.
+    void DecreaseSharedCounter(size_t count) {
+        if constexpr (requires(typename Counting::Counter& counter) { Counting::Subtract(counter, count); }) {
+            if (Counting::Subtract(shared_cnt_, count)) {
+                return;
+            }
+            DestroyObject();
+            DecreaseWeakCounter();
+        } else {
+            while (--count) {
+                Counting::Decrement(shared_cnt_);
+            }
+            DecreaseSharedCounter();
+        }
+    }
+
+    // Used to promote weak references: fails once the object is gone.
+    bool TryIncreaseSharedCounter() {
+        return Counting::IncrementIfNotZero(shared_cnt_);
+    }
+
+    void IncreaseWeakCounter() {
+        Counting::Increment(weak_cnt_);
+    }
+
+    void DecreaseWeakCounter() {
+        if (!Counting::Decrement(weak_cnt_)) {
+            DestroyBlock();
+        }
+    }
+
+    size_t GetSharedCounter() const {
+        return Counting::Load(shared_cnt_);
+    }
+
+    // Only the caller refers to the block: one shared owner and no weak references.
+    bool IsUnique() const {
+        return Counting::Load(shared_cnt_) == 1 && Counting::Load(weak_cnt_) == 1;
+    }
+
+    // `&kBlockTag<Type of this block>`, lets owners reuse a block they recognize.
+    virtual const void* Tag() const = 0;
+
+protected:
+    ControlBlock() = default;
+    ~ControlBlock() = default;
+
+    virtual void DestroyObject() = 0;
+    virtual void DestroyBlock() = 0;
+
+private:
+    typename Counting::Counter shared_cnt_{1};
+    typename Counting::Counter weak_cnt_{1};
+};
+
+// Allocates a block through the allocation policy.
+template <typename Block, typename Allocation, typename... Args>
+Block* NewControlBlock(Args&&... args) {
+    void* memory = Allocation::template Allocate<Block>();
+    try {
+        return new (memory) Block(std::forward<Args>(args)...);
+    } catch (...) {
+        Allocation::template Deallocate<Block>(memory);
+        throw;
+    }
+}
+
+// Owns an object allocated elsewhere (`SharedPtr(new Y)`)
+template <typename Y, typename Base, typename Allocation>
+class ControlBlockPointer final : public Base {
+public:
+    explicit ControlBlockPointer(Y* ptr) : ptr_(ptr) {
+    }
+
+    const void* Tag() const override {
+        return &kBlockTag<ControlBlockPointer>;
+    }
+
+    // Makes the block own `ptr` instead; returns the previous object.
+    Y* Exchange(Y* ptr) {
+        return std::exchange(ptr_, ptr);
+    }
+
+private:
+    void DestroyObject() override {
+        delete ptr_;
+    }
+
+    void DestroyBlock() override {
+        this->~ControlBlockPointer();
+        Allocation::template Deallocate<ControlBlockPointer>(this);
+    }
+
+    Y* ptr_;
+};
+
+// Object and block share one allocation (`MakeShared`)
+template <typename T, typename Base, typename Allocation>
+class ControlBlockObject final : public Base {
+public:
+    template <typename... Args>
+    explicit ControlBlockObject(Args&&... args) {
+        Construct(std::forward<Args>(args)...);
+    }
+
+    T* Object() {
+        return reinterpret_cast<T*>(&obj_);
+    }
+
+    const void* Tag() const override {
+        return &kBlockTag<ControlBlockObject>;
+    }
+
+    // Re-creates the object in place; the caller must be the only owner.
+    // If the constructor throws, the block is freed and the exception propagates.
+    template <typename... Args>
+    void Reconstruct(Args&&... args) {
+        Object()->~T();
+        try {
+            Construct(std::forward<Args>(args)...);
+        } catch (...) {
+            DestroyBlock();
+            throw;
+        }
+    }
+
+private:
+    template <typename... Args>
+    void Construct(Args&&... args) {
+        new (&obj_) std::remove_cv_t<T>(std::forward<Args>(args)...);
+    }
+
+    void DestroyObject() override {
+        Object()->~T();
+    }
+
+    void DestroyBlock() override {
+        this->~ControlBlockObject();
+        Allocation::template Deallocate<ControlBlockObject>(this);
+    }
+
+    std::aligned_storage_t<sizeof(T), alignof(T)> obj_;
+};
+
+// `size` objects stored right after the block, in the same allocation (`MakeSharedBatch`)
+template <typename T, typename Base, typename Allocation>
+class ControlBlockArray final : public Base {
+public:
+    static constexpr size_t kAlign = std::max(alignof(T), alignof(Base));
+
+    static size_t ObjectsOffset() {
+        return (sizeof(ControlBlockArray) + alignof(T) - 1) / alignof(T) * alignof(T);
+    }
+
+    static size_t Bytes(size_t size) {
+        return ObjectsOffset() + size * sizeof(T);
+    }
+
+    // Allocates a block for `size` objects and builds object `i` from `init(i)`.
+    template <typename Init>
+    static ControlBlockArray* New(size_t size, Init& init) {
+        void* memory = Allocation::AllocateBytes(Bytes(size), kAlign);
+        auto* block = new (memory) ControlBlockArray(size);
+        size_t built = 0;
+        try {
+            for (; built < size; ++built) {
+                new (block->Objects() + built) T(init(built));
+            }
+        } catch (...) {
+            block->DestroyObjects(built);
+            block->~ControlBlockArray();
+            Allocation::DeallocateBytes(memory, Bytes(size), kAlign);
+            throw;
+        }
+        return block;
+    }
+
+    T* Objects() {
+        return reinterpret_cast<T*>(reinterpret_cast<char*>(this) + ObjectsOffset());
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    const void* Tag() const override {
+        return &kBlockTag<ControlBlockArray>;
+    }
+
+private:
+    explicit ControlBlockArray(size_t size) : size_(size) {
+    }
+
+    void DestroyObjects(size_t count) {
+        while (count) {
+            Objects()[--count].~T();
+        }
+    }
+
+    void DestroyObject() override {
+        DestroyObjects(size_);
+    }
+
+    void DestroyBlock() override {
+        size_t bytes = Bytes(size_);
+        this->~ControlBlockArray();
+        Allocation::DeallocateBytes(this, bytes, kAlign);
+    }
+
+    size_t size_;
+};
+
+// Object and block share one allocation obtained from `Alloc` (`AllocateShared`)
+template <typename T, typename Base, typename Alloc>
+class ControlBlockAllocated final : public Base {
+public:
+    using BlockAlloc =
+        typename std::allocator_traits<Alloc>::template rebind_alloc<ControlBlockAllocated>;
+
+    template <typename... Args>
+    explicit ControlBlockAllocated(const Alloc& alloc, Args&&... args) : alloc_(alloc) {
+        new (&obj_) T(std::forward<Args>(args)...);
+    }
+
+    T* Object() {
+        return reinterpret_cast<T*>(&obj_);
+    }
+
+    const void* Tag() const override {
+        return &kBlockTag<ControlBlockAllocated>;
+    }
+
+private:
+    void DestroyObject() override {
+        Object()->~T();
+    }
+
+    void DestroyBlock() override {
+        BlockAlloc alloc(alloc_);
+        this->~ControlBlockAllocated();
+        std::allocator_traits<BlockAlloc>::deallocate(alloc, this, 1);
+    }
+
+    BlockAlloc alloc_;
+    std::aligned_storage_t<sizeof(T), alignof(T)> obj_;
+};
+
+// Object and block live inside a ScopedShared, usually on the stack: there is
+// nothing to free, the owner only learns when the last weak reference is gone.
+template <typename T, typename Base>
+class ControlBlockScoped final : public Base {
+public:
+    template <typename... Args>
+    explicit ControlBlockScoped(Args&&... args) {
+        new (&obj_) std::remove_cv_t<T>(std::forward<Args>(args)...);
+    }
+
+    T* Object() {
+        return reinterpret_cast<T*>(&obj_);
+    }
+
+    const void* Tag() const override {
+        return &kBlockTag<ControlBlockScoped>;
+    }
+
+    // No pointer refers to the block any more.
+    bool Released() const {
+        return released_.load(std::memory_order_acquire);
+    }
+
+private:
+    void DestroyObject() override {
+        Object()->~T();
+    }
+
+    void DestroyBlock() override {
+        released_.store(true, std::memory_order_release);
+    }
+
+    std::aligned_storage_t<sizeof(T), alignof(T)> obj_;
+    std::atomic<bool> released_ = false;
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "shared.h"
+
+#include <intrusive/intrusive.h>
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+// SharedPtr for objects that count their own references: RefCounted types (see
+// intrusive.h) take the EmbeddedCounting policy,
+//
+//     struct Node : SimpleRefCounted<Node> { ... };
+//     SharedPtr<Node, EmbeddedCounting> node(new Node);  // One allocation, sizeof(void*)
+//
+// and handles of a C library the ExternalCounting policy (see ExternalRefTraits):
+//
+//     using FooTraits = ExternalRefTraits<&foo_ref, &foo_unref, &foo_refcount>;
+//     SharedPtr<foo, ExternalCounting<FooTraits>> foo(foo_new(), kAdoptRef);
+//
+// A raw handle says whether the pointer takes over the reference the caller owns
+// (kAdoptRef) or adds its own (kRetainRef); a bare `SharedPtr(T*)` is only for
+// RefCounted objects, which start without references.
+//
+// There is no control block: the pointer is the object pointer, and copies call
+// the object's own IncRef/DecRef instead of keeping a second count next to it.
+// Without the policy, SharedPtr<Node> is the ordinary pointer with a control block.
+// Embedded counts have no weak count, so there is no WeakPtr or aliasing; types
+// that need WeakPtr derive from WeakRefCounted instead, which keeps the ordinary
+// SharedPtr.
+struct AdoptRef {};
+struct RetainRef {};
+
+inline constexpr AdoptRef kAdoptRef;
+inline constexpr RetainRef kRetainRef;
+
+template <typename T, typename... Policies>
+requires(!std::is_void_v<EmbeddedCountTraits<T, Policies...>>)
+class SharedPtr<T, Policies...> {
+    using Traits = EmbeddedCountTraits<T, Policies...>;
+
+    static constexpr bool kRefCounted = std::is_same_v<Traits, IntrusiveTraits>;
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    SharedPtr() {
+    }
+    SharedPtr(std::nullptr_t) {
+    }
+
+    // Adds the first reference of a RefCounted object.
+    explicit SharedPtr(T* ptr) requires kRefCounted : ptr_(ptr) {
+    }
+
+    // A library handle needs kAdoptRef or kRetainRef.
+    SharedPtr(T* ptr) requires(!kRefCounted) = delete;
+
+    SharedPtr(T* ptr, AdoptRef) : ptr_(AdoptIntrusive<Traits>(ptr)) {
+    }
+
+    SharedPtr(T* ptr, RetainRef) : ptr_(ptr) {
+    }
+
+    explicit SharedPtr(IntrusivePtr<T, Traits> ptr) : ptr_(std::move(ptr)) {
+    }
+
+    template <typename Y, typename... P>
+    friend class SharedPtr;
+
+    template <typename Y>
+    requires std::is_convertible_v<Y*, T*>
+    SharedPtr(const SharedPtr<Y, Policies...>& other) : ptr_(other.ptr_) {
+    }
+
+    template <typename Y>
+    requires std::is_convertible_v<Y*, T*>
+    SharedPtr(SharedPtr<Y, Policies...>&& other) : ptr_(std::move(other.ptr_)) {
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        ptr_.Reset();
+    }
+
+    void Reset(T* ptr) requires kRefCounted {
+        ptr_.Reset(ptr);
+    }
+
+    void Swap(SharedPtr& other) {
+        ptr_.Swap(other.ptr_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return ptr_.Get();
+    }
+    T& operator*() const {
+        return *Get();
+    }
+    T* operator->() const {
+        return Get();
+    }
+    size_t UseCount() const {
+        return ptr_.UseCount();
+    }
+    explicit operator bool() const {
+        return Get() != nullptr;
+    }
+
+    template <PrefetchMode Mode = PrefetchMode::kRead, PrefetchLocality Locality = PrefetchLocality::kHigh>
+    void Prefetch() const {
+        PrefetchAddress<Mode, Locality>(Get());
+    }
+
+    // The same reference, for code written against IntrusivePtr
+    const IntrusivePtr<T, Traits>& AsIntrusive() const {
+        return ptr_;
+    }
+
+private:
+    IntrusivePtr<T, Traits> ptr_;
+};
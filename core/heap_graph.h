@@ -0,0 +1,357 @@
+#pragma once
+
+#include "shared.h"
+
+#include <intrusive/intrusive.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#endif
+
+// Offline analysis of object graphs built from SharedPtr and IntrusivePtr: which
+// root keeps how much memory alive. Nothing here touches the pointers' hot paths;
+// the graph is walked only when HeapGraph or RetainedSize is called.
+//
+// Types with owning pointers describe them by specializing HeapTraits:
+//
+//     template <>
+//     struct HeapTraits<Node> {
+//         template <typename Visitor>
+//         static void ForEachChild(const Node& node, Visitor& visit) {
+//             visit(node.left);   // SharedPtr, IntrusivePtr or WeakPtr
+//             visit(node.right);
+//         }
+//         // Optional: memory the object owns directly (strings, vectors).
+//         static size_t ExtraBytes(const Node& node) {
+//             return node.name.capacity();
+//         }
+//     };
+//
+// Types without a specialization are leaves.
+template <typename T>
+struct HeapTraits {
+    template <typename Visitor>
+    static void ForEachChild(const T&, Visitor&) {
+    }
+};
+
+// Nodes are allocations: control blocks for SharedPtr (aliases of one block are
+// one node, expanded through the first alias seen) and objects for IntrusivePtr.
+// A node's shallow size is sizeof the object, its control block header and
+// ExtraBytes. Its retained size is what would be freed if its dominator tree went
+// away: the node plus every node that is reachable only through it.
+//
+// An object is also held from outside the graph (locals, other containers) when
+// its use count exceeds the number of graph edges into it; such objects are
+// treated as roots of their own rather than as retained by their parents.
+class HeapGraph {
+public:
+    struct Node {
+        const void* address = nullptr;
+        const char* type = "<roots>";
+        std::string name;  // Given to AddRoot
+        size_t shallow = 0;
+        size_t retained = 0;
+        size_t dominator = 0;  // Index of the immediate dominator; 0 is the outside world.
+    };
+
+    class Visitor {
+    public:
+        template <typename T, typename... P>
+        void operator()(const SharedPtr<T, P...>& ptr) {
+            graph_.AddEdge(from_, graph_.Discover(ptr));
+        }
+
+        template <typename T, typename Traits>
+        void operator()(const IntrusivePtr<T, Traits>& ptr) {
+            graph_.AddEdge(from_, graph_.Discover(ptr));
+        }
+
+        // Weak references retain nothing.
+        template <typename T, typename... P>
+        void operator()(const WeakPtr<T, P...>&) {
+        }
+
+    private:
+        friend class HeapGraph;
+
+        Visitor(HeapGraph& graph, size_t from) : graph_(graph), from_(from) {
+        }
+
+        HeapGraph& graph_;
+        size_t from_;
+    };
+
+    HeapGraph() : nodes_(1), edges_(1), in_edges_(1), use_counts_(1) {
+    }
+
+    // Walks everything reachable from `ptr`. Returns the root's node index (0 if null).
+    template <typename Ptr>
+    size_t AddRoot(const Ptr& ptr, std::string name = {}) {
+        size_t root = Discover(ptr);
+        if (root) {
+            AddEdge(0, root);
+            nodes_[root].name = std::move(name);
+        }
+        while (!pending_.empty()) {
+            Pending next = pending_.back();
+            pending_.pop_back();
+            Visitor visitor(*this, next.node);
+            next.expand(next.object, visitor);
+        }
+        analyzed_ = false;
+        return root;
+    }
+
+    // Node 0 stands for the outside world and retains everything.
+    const std::vector<Node>& Nodes() {
+        Analyze();
+        return nodes_;
+    }
+
+    // The `count` nodes with the largest retained sizes, largest first.
+    std::vector<size_t> LargestRetainers(size_t count) {
+        Analyze();
+        std::vector<size_t> order;
+        for (size_t i = 1; i < nodes_.size(); ++i) {
+            order.push_back(i);
+        }
+        count = std::min(count, order.size());
+        std::partial_sort(order.begin(), order.begin() + count, order.end(),
+                          [this](size_t a, size_t b) { return nodes_[a].retained > nodes_[b].retained; });
+        order.resize(count);
+        return order;
+    }
+
+    std::string Report(size_t count = 10) {
+        std::string report = Format("%12s %12s  %s\n", "retained", "shallow", "object");
+        for (size_t i : LargestRetainers(count)) {
+            const Node& node = nodes_[i];
+            report += Format("%12zu %12zu  %s %p", node.retained, node.shallow, Demangle(node.type).c_str(),
+                             node.address);
+            report += node.name.empty() ? "\n" : " (" + node.name + ")\n";
+        }
+        return report;
+    }
+
+    // One line per node and per edge:
+    //     node <index> <address> <shallow> <retained> <dominator> <type>
+    //     edge <from> <to>
+    // The demangled type comes last and runs to the end of the line, since it may
+    // contain spaces ("unsigned int", "std::vector<int, std::allocator<int> >").
+    std::string Dump() {
+        Analyze();
+        std::string dump;
+        for (size_t i = 1; i < nodes_.size(); ++i) {
+            const Node& node = nodes_[i];
+            dump += Format("node %zu %p %zu %zu %zu ", i, node.address, node.shallow, node.retained,
+                           node.dominator);
+            dump += Demangle(node.type) + "\n";
+        }
+        for (size_t from = 1; from < nodes_.size(); ++from) {
+            for (size_t to : edges_[from]) {
+                dump += Format("edge %zu %zu\n", from, to);
+            }
+        }
+        return dump;
+    }
+
+private:
+    using Expand = void (*)(const void*, Visitor&);
+
+    struct Pending {
+        size_t node;
+        const void* object;
+        Expand expand;
+    };
+
+    template <typename T>
+    static void ExpandObject(const void* object, Visitor& visitor) {
+        HeapTraits<T>::ForEachChild(*static_cast<const T*>(object), visitor);
+    }
+
+    template <typename T>
+    static size_t ExtraBytes(const T& object) {
+        if constexpr (requires { HeapTraits<T>::ExtraBytes(object); }) {
+            return HeapTraits<T>::ExtraBytes(object);
+        } else {
+            return 0;
+        }
+    }
+
+    template <typename T, typename... P>
+    size_t Discover(const SharedPtr<T, P...>& ptr) {
+        using Object = std::remove_cv_t<T>;
+        if constexpr (requires { ptr.AsIntrusive(); }) {
+            return Discover(ptr.AsIntrusive());  // No control block
+        } else {
+            if (!ptr) {
+                return 0;
+            }
+            size_t shallow = sizeof(Object) + sizeof(SharedControlBlock<P...>) + ExtraBytes<Object>(*ptr);
+            return Discover<Object>(SharedPtrAccess::Block(ptr), ptr.Get(), shallow, ptr.UseCount());
+        }
+    }
+
+    template <typename T, typename Traits>
+    size_t Discover(const IntrusivePtr<T, Traits>& ptr) {
+        using Object = std::remove_cv_t<T>;
+        if (!ptr) {
+            return 0;
+        }
+        return Discover<Object>(ptr.Get(), ptr.Get(), sizeof(Object) + ExtraBytes<Object>(*ptr), ptr.UseCount());
+    }
+
+    template <typename Object>
+    size_t Discover(const void* address, const Object* object, size_t shallow, size_t use_count) {
+        auto [it, inserted] = index_.emplace(address, nodes_.size());
+        if (inserted) {
+            nodes_.push_back(Node{address, typeid(Object).name(), {}, shallow});
+            edges_.emplace_back();
+            in_edges_.push_back(0);
+            use_counts_.push_back(use_count);
+            pending_.push_back({it->second, object, &ExpandObject<Object>});
+        }
+        return it->second;
+    }
+
+    void AddEdge(size_t from, size_t to) {
+        if (to) {
+            edges_[from].push_back(to);
+            ++in_edges_[to];
+        }
+    }
+
+    // Dominators by Cooper, Harvey and Kennedy, "A Simple, Fast Dominance Algorithm".
+    void Analyze() {
+        if (analyzed_) {
+            return;
+        }
+        const size_t n = nodes_.size();
+
+        // Edges from the outside world: explicit roots plus objects held from outside.
+        std::vector<std::vector<size_t>> successors = edges_;
+        for (size_t i = 1; i < n; ++i) {
+            if (use_counts_[i] > in_edges_[i]) {
+                successors[0].push_back(i);
+            }
+        }
+        std::vector<std::vector<size_t>> predecessors(n);
+        for (size_t from = 0; from < n; ++from) {
+            for (size_t to : successors[from]) {
+                predecessors[to].push_back(from);
+            }
+        }
+
+        // Postorder numbers by an iterative depth-first search.
+        constexpr size_t kNone = ~size_t{0};
+        std::vector<size_t> postorder(n, kNone);
+        std::vector<size_t> order;  // Nodes by postorder number
+        std::vector<bool> visited(n);
+        std::vector<std::pair<size_t, size_t>> stack = {{0, 0}};
+        visited[0] = true;
+        while (!stack.empty()) {
+            auto& [node, next] = stack.back();
+            if (next < successors[node].size()) {
+                size_t child = successors[node][next++];
+                if (!visited[child]) {
+                    visited[child] = true;
+                    stack.push_back({child, 0});
+                }
+            } else {
+                postorder[node] = order.size();
+                order.push_back(node);
+                stack.pop_back();
+            }
+        }
+
+        std::vector<size_t> dominator(n, kNone);
+        dominator[0] = 0;
+        auto intersect = [&](size_t a, size_t b) {
+            while (a != b) {
+                while (postorder[a] < postorder[b]) {
+                    a = dominator[a];
+                }
+                while (postorder[b] < postorder[a]) {
+                    b = dominator[b];
+                }
+            }
+            return a;
+        };
+        for (bool changed = true; changed;) {
+            changed = false;
+            for (size_t k = order.size() - 1; k-- > 0;) {
+                size_t node = order[k];
+                size_t candidate = kNone;
+                for (size_t pred : predecessors[node]) {
+                    if (dominator[pred] != kNone) {
+                        candidate = candidate == kNone ? pred : intersect(pred, candidate);
+                    }
+                }
+                if (dominator[node] != candidate) {
+                    dominator[node] = candidate;
+                    changed = true;
+                }
+            }
+        }
+
+        // Dominators come later in postorder than the nodes they dominate.
+        for (size_t i = 0; i < n; ++i) {
+            nodes_[i].retained = nodes_[i].shallow;
+            nodes_[i].dominator = dominator[i];
+        }
+        for (size_t node : order) {
+            if (node) {
+                nodes_[dominator[node]].retained += nodes_[node].retained;
+            }
+        }
+        analyzed_ = true;
+    }
+
+    template <typename... Args>
+    static std::string Format(const char* format, Args... args) {
+        std::string line(std::snprintf(nullptr, 0, format, args...), '\0');
+        std::snprintf(line.data(), line.size() + 1, format, args...);
+        return line;
+    }
+
+    static std::string Demangle(const char* name) {
+#if __has_include(<cxxabi.h>)
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+        if (demangled) {
+            std::string result = demangled;
+            std::free(demangled);
+            return result;
+        }
+#endif
+        return name;
+    }
+
+    std::vector<Node> nodes_;
+    std::vector<std::vector<size_t>> edges_;
+    std::vector<size_t> in_edges_;
+    std::vector<size_t> use_counts_;
+    std::unordered_map<const void*, size_t> index_;
+    std::vector<Pending> pending_;
+    bool analyzed_ = false;
+};
+
+// Bytes that would be freed if `ptr` were the last reference to its object.
+template <typename Ptr>
+size_t RetainedSize(const Ptr& ptr) {
+    HeapGraph graph;
+    size_t root = graph.AddRoot(ptr);
+    return root ? graph.Nodes()[root].retained : 0;
+}
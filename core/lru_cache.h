@@ -0,0 +1,138 @@
+#pragma once
+
+#include "shared.h"
+
+#include <intrusive/hash_set.h>
+#include <intrusive/list.h>
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+// LRU cache of shared immutable values, split into independently locked shards.
+//
+//  - An entry is one allocation: it carries its own recency-list and index hooks.
+//  - A value that is still referenced outside the cache pins its entry: eviction
+//    skips it (the shard may overflow meanwhile) and retries on later inserts.
+//  - A hit only sets the entry's `referenced` bit instead of relinking it, which
+//    would write to both neighbours and the list head. Eviction gives referenced
+//    entries a second chance (CLOCK), which approximates LRU order.
+//
+// Values are counted atomically whatever `Policies` say, as they cross threads.
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename... Policies>
+class ShardedLruCache {
+public:
+    using ValuePtr = SharedPtr<const Value, AtomicCounting, Policies...>;
+
+private:
+    struct Entry : SimpleRefCounted<Entry>, ListHook<>, HashSetHook<> {
+        Entry(const Key& key, ValuePtr value) : key(key), value(std::move(value)) {
+        }
+
+        const Key key;
+        ValuePtr value;
+        bool referenced = false;
+    };
+
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        IntrusiveList<Entry> lru;  // Front is the eviction candidate.
+        IntrusiveHashSet<Entry, &Entry::key, void, Hash> index;
+    };
+
+public:
+    explicit ShardedLruCache(size_t capacity, size_t shards = 16)
+        : shard_count_(std::bit_ceil(shards ? shards : 1)),
+          shard_capacity_((capacity + shard_count_ - 1) / shard_count_),
+          shards_(new Shard[shard_count_]) {
+    }
+
+    // Null on a miss.
+    ValuePtr Get(const Key& key) {
+        Shard& shard = ShardOf(key);
+        std::lock_guard lock(shard.mutex);
+        Entry* entry = shard.index.Find(key);
+        if (!entry) {
+            return {};
+        }
+        entry->referenced = true;
+        return entry->value;
+    }
+
+    // Inserts or replaces the value of `key`.
+    void Put(const Key& key, ValuePtr value) {
+        Shard& shard = ShardOf(key);
+        std::lock_guard lock(shard.mutex);
+        if (Entry* entry = shard.index.Find(key)) {
+            entry->value = std::move(value);
+            entry->referenced = true;
+            return;
+        }
+        auto entry = MakeIntrusive<Entry>(key, std::move(value));
+        shard.index.Insert(entry);
+        shard.lru.PushBack(std::move(entry));
+        Evict(shard);
+    }
+
+    template <typename... Args>
+    ValuePtr Emplace(const Key& key, Args&&... args) {
+        ValuePtr value = MakeShared<Value, AtomicCounting, Policies...>(std::forward<Args>(args)...);
+        Put(key, value);
+        return value;
+    }
+
+    bool Erase(const Key& key) {
+        Shard& shard = ShardOf(key);
+        std::lock_guard lock(shard.mutex);
+        auto entry = shard.index.Erase(key);
+        if (!entry) {
+            return false;
+        }
+        shard.lru.Erase(*entry);
+        return true;
+    }
+
+    // Entries currently held, including pinned ones over capacity.
+    size_t Size() const {
+        size_t size = 0;
+        for (size_t i = 0; i < shard_count_; ++i) {
+            std::lock_guard lock(shards_[i].mutex);
+            size += shards_[i].lru.Size();
+        }
+        return size;
+    }
+
+    size_t Capacity() const {
+        return shard_capacity_ * shard_count_;
+    }
+
+private:
+    Shard& ShardOf(const Key& key) const {
+        // The index uses the low bits of the same hash; take the shard from the high ones.
+        uint64_t hash = Hash{}(key) * 0x9E3779B97F4A7C15ull;
+        return shards_[(hash >> 32) & (shard_count_ - 1)];
+    }
+
+    // Looks at every entry at most twice (once to clear its `referenced` bit), so a
+    // shard full of pinned values still returns.
+    void Evict(Shard& shard) {
+        for (size_t budget = 2 * shard.lru.Size(); shard.lru.Size() > shard_capacity_ && budget; --budget) {
+            Entry& oldest = shard.lru.Front();
+            if (oldest.referenced || oldest.value.UseCount() > 1) {
+                oldest.referenced = false;
+                shard.lru.MoveToBack(oldest);
+                continue;
+            }
+            shard.index.Erase(oldest);
+            shard.lru.PopFront();
+        }
+    }
+
+    const size_t shard_count_;
+    const size_t shard_capacity_;
+    std::unique_ptr<Shard[]> shards_;
+};
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <common/arena.h>
+#include <common/slab.h>
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+// Compile-time policies of SharedPtr/WeakPtr: `SharedPtr<T, AtomicCounting, ThinLayout>`.
+// Each policy belongs to one category; unspecified categories take the default
+// (the first policy listed below).
+
+struct CountingPolicy {};
+struct LayoutPolicy {};
+struct AllocationPolicy {};
+struct ClassIdPolicy {};
+struct BlockPolicy {};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Counting
+
+struct SingleThreadedCounting {
+    using Category = CountingPolicy;
+    using Counter = size_t;
+
+    static void Increment(Counter& counter) {
+        ++counter;
+    }
+
+    // Returns the new value.
+    static size_t Decrement(Counter& counter) {
+        return --counter;
+    }
+
+    static size_t Subtract(Counter& counter, size_t count) {
+        return counter -= count;
+    }
+
+    static bool IncrementIfNotZero(Counter& counter) {
+        if (!counter) {
+            return false;
+        }
+        ++counter;
+        return true;
+    }
+
+    static size_t Load(const Counter& counter) {
+        return counter;
+    }
+};
+
+struct AtomicCounting {
+    using Category = CountingPolicy;
+    using Counter = std::atomic<size_t>;
+
+    static void Increment(Counter& counter) {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    static size_t Decrement(Counter& counter) {
+        return counter.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    }
+
+    static size_t Subtract(Counter& counter, size_t count) {
+        return counter.fetch_sub(count, std::memory_order_acq_rel) - count;
+    }
+
+    static bool IncrementIfNotZero(Counter& counter) {
+        size_t value = counter.load(std::memory_order_relaxed);
+        while (value) {
+            if (counter.compare_exchange_weak(value, value + 1, std::memory_order_acq_rel)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static size_t Load(const Counter& counter) {
+        return counter.load(std::memory_order_acquire);
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Layout
+
+// Pointer to the control block plus pointer to the object; supports aliasing.
+struct FatLayout {
+    using Category = LayoutPolicy;
+    static constexpr bool kThin = false;
+};
+
+// Pointer to the control block only; the object pointer is read from the block.
+// No aliasing and no conversions other than adding const.
+struct ThinLayout {
+    using Category = LayoutPolicy;
+    static constexpr bool kThin = true;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Allocation of control blocks (and of the object for MakeShared)
+
+struct GlobalAllocation {
+    using Category = AllocationPolicy;
+
+    template <typename Block>
+    static void* Allocate() {
+        return AllocateBytes(sizeof(Block), alignof(Block));
+    }
+
+    template <typename Block>
+    static void Deallocate(void* block) {
+        DeallocateBytes(block, sizeof(Block), alignof(Block));
+    }
+
+    // Variable-sized blocks (MakeSharedBatch)
+    static void* AllocateBytes(size_t size, size_t align) {
+        if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return ::operator new(size, std::align_val_t{align});
+        }
+        return ::operator new(size);
+    }
+
+    static void DeallocateBytes(void* block, size_t size, size_t align) {
+        if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(block, size, std::align_val_t{align});
+        } else {
+            ::operator delete(block, size);
+        }
+    }
+};
+
+// Size-class slabs shared by all blocks of similar size, see common/slab.h.
+struct PoolAllocation {
+    using Category = AllocationPolicy;
+
+    template <typename Block>
+    static void* Allocate() {
+        return SlabAllocatorFor<Block>::Instance().Allocate();
+    }
+
+    template <typename Block>
+    static void Deallocate(void* block) {
+        SlabAllocatorBase::Free(block);
+    }
+
+    // Slabs have fixed size classes, variable-sized blocks use the global heap.
+    static void* AllocateBytes(size_t size, size_t align) {
+        return GlobalAllocation::AllocateBytes(size, align);
+    }
+
+    static void DeallocateBytes(void* block, size_t size, size_t align) {
+        GlobalAllocation::DeallocateBytes(block, size, align);
+    }
+};
+
+// Blocks come from the current HugePageArena and are reclaimed with the arena,
+// which therefore has to outlive every pointer allocated from it.
+struct ArenaAllocation {
+    using Category = AllocationPolicy;
+
+    template <typename Block>
+    static void* Allocate() {
+        return HugePageArena::Current().Allocate(sizeof(Block), alignof(Block));
+    }
+
+    template <typename Block>
+    static void Deallocate(void*) {
+    }
+
+    static void* AllocateBytes(size_t size, size_t align) {
+        return HugePageArena::Current().Allocate(size, align);
+    }
+
+    static void DeallocateBytes(void*, size_t, size_t) {
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// When `SharedPtr(new T)` makes its control block
+
+// Right away, like std::shared_ptr.
+struct EagerBlock {
+    using Category = BlockPolicy;
+    static constexpr bool kLazy = false;
+};
+
+// On the first copy or WeakPtr, so pointers that never share their object cost no
+// block; making a WeakPtr may then allocate. Needs the fat layout and
+// single-threaded counting.
+struct LazyBlock {
+    using Category = BlockPolicy;
+    static constexpr bool kLazy = true;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Dynamic type of the owned object, see class_id.h
+
+struct NoClassIds {
+    using Category = ClassIdPolicy;
+    static constexpr bool kStored = false;
+};
+
+// The control block remembers the class id of the object it was created with,
+// which enables FastPointerCast.
+struct StoreClassIds {
+    using Category = ClassIdPolicy;
+    static constexpr bool kStored = true;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Policy resolution
+
+template <typename Category, typename Default, typename... Policies>
+struct PickPolicy {
+    using Type = Default;
+};
+
+template <typename Category, typename Default, typename First, typename... Rest>
+struct PickPolicy<Category, Default, First, Rest...> {
+    using Type = std::conditional_t<std::is_same_v<typename First::Category, Category>, First,
+                                    typename PickPolicy<Category, Default, Rest...>::Type>;
+};
+
+template <typename... Policies>
+struct SharedPolicies {
+    using Counting = typename PickPolicy<CountingPolicy, SingleThreadedCounting, Policies...>::Type;
+    using Layout = typename PickPolicy<LayoutPolicy, FatLayout, Policies...>::Type;
+    using Allocation = typename PickPolicy<AllocationPolicy, GlobalAllocation, Policies...>::Type;
+    using ClassId = typename PickPolicy<ClassIdPolicy, NoClassIds, Policies...>::Type;
+    using BlockCreation = typename PickPolicy<BlockPolicy, EagerBlock, Policies...>::Type;
+
+    static constexpr bool kThin = Layout::kThin;
+    static constexpr bool kClassIds = ClassId::kStored;
+    static constexpr bool kLazyBlock = BlockCreation::kLazy;
+};
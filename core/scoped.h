@@ -0,0 +1,124 @@
+#pragma once
+
+#include "shared.h"
+#include "weak.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// A shared object that lives in the enclosing scope, e.g. request-local state
+// handed to callees as SharedPtr/WeakPtr. Object and control block are members,
+// so sharing costs no heap allocation:
+//
+//     ScopedShared<Request> request(...);
+//     Handle(request.Share());
+//
+// Every pointer handed out must be gone when the scope ends. With atomic counting
+// the destructor waits for other threads to drop theirs; with single-threaded
+// counting there is nobody to wait for, so a pointer still alive has escaped and
+// the program terminates rather than leave it dangling. Debug builds report the
+// escape on stderr first, and call Traits::SlowRelease once when an atomic wait
+// takes longer than Traits::kEscapeTimeout, then keep waiting.
+struct ScopedSharedTraits {
+    static constexpr std::chrono::milliseconds kEscapeTimeout{1000};
+
+    static void SlowRelease(const char* kind) {
+        std::fprintf(stderr, "ScopedShared: still waiting for a %s after %lldms\n", kind,
+                     static_cast<long long>(kEscapeTimeout.count()));
+    }
+};
+
+template <typename T, typename Traits, typename... Policies>
+class BasicScopedShared {
+    using Block = ControlBlockScoped<T, SharedControlBlock<Policies...>>;
+
+    static constexpr bool kConcurrent =
+        !std::is_base_of_v<SingleThreadedCounting, typename SharedPolicies<Policies...>::Counting>;
+
+public:
+    static constexpr auto kEscapeTimeout = Traits::kEscapeTimeout;
+
+    template <typename... Args>
+    explicit BasicScopedShared(Args&&... args)
+        : block_(std::forward<Args>(args)...),
+          owner_(SharedPtrAccess::Adopt<T, Policies...>(&block_, block_.Object())) {
+    }
+
+    BasicScopedShared(const BasicScopedShared&) = delete;
+    BasicScopedShared& operator=(const BasicScopedShared&) = delete;
+
+    ~BasicScopedShared() {
+        Await([this] { return owner_.UseCount() == 1; }, "SharedPtr");
+        owner_.Reset();
+        Await([this] { return block_.Released(); }, "WeakPtr");
+    }
+
+    SharedPtr<T, Policies...> Share() const {
+        return owner_;
+    }
+
+    WeakPtr<T, Policies...> Weak() const {
+        return WeakPtr<T, Policies...>(owner_);
+    }
+
+    T* Get() const {
+        return owner_.Get();
+    }
+    T& operator*() const {
+        return *Get();
+    }
+    T* operator->() const {
+        return Get();
+    }
+
+    // References handed out and still alive
+    size_t UseCount() const {
+        return owner_.UseCount() - 1;
+    }
+
+private:
+    template <typename Done>
+    static void Await(Done done, const char* kind) {
+        if (done()) {
+            return;
+        }
+        if constexpr (kConcurrent) {
+#ifndef NDEBUG
+            auto deadline = std::chrono::steady_clock::now() + kEscapeTimeout;
+            bool warned = false;
+#endif
+            while (!done()) {
+#ifndef NDEBUG
+                if (!warned && std::chrono::steady_clock::now() > deadline) {
+                    Traits::SlowRelease(kind);
+                    warned = true;
+                }
+#endif
+                std::this_thread::yield();
+            }
+        } else {
+            Escaped(kind);
+        }
+    }
+
+    [[noreturn]] static void Escaped([[maybe_unused]] const char* kind) {
+#ifndef NDEBUG
+        std::fprintf(stderr, "ScopedShared: a %s outlived its scope\n", kind);
+        std::abort();
+#else
+        std::terminate();
+#endif
+    }
+
+    Block block_;
+    SharedPtr<T, Policies...> owner_;
+};
+
+template <typename T, typename... Policies>
+using ScopedShared = BasicScopedShared<T, ScopedSharedTraits, Policies...>;
@@ -0,0 +1,774 @@
+#pragma once
+
+#include "sw_fwd.h"  // Forward declaration
+#include "class_id.h"
+#include "control_block.h"
+#include "policies.h"
+
+#include <common/prefetch.h>
+#include <intrusive/intrusive.h>
+
+#include <cstddef>  // std::nullptr_t
+#include <cstdint>
+#include <memory>   // std::allocator_traits
+#include <type_traits>
+#include <utility>
+
+// https://en.cppreference.com/w/cpp/memory/shared_ptr
+//
+// One implementation for every combination of policies (see policies.h):
+//   SharedPtr<T>                                   - single-threaded, fat, global new
+//   SharedPtr<T, AtomicCounting, ThinLayout>       - thread-safe counters, one word
+//   SharedPtr<T, PoolAllocation>                   - control blocks from slabs
+//   SharedPtr<RefCountedT, EmbeddedCounting>       - the object's own counter, no block
+
+// Object pointer kept next to the control block pointer (fat layout) ...
+template <typename T, bool Thin>
+class ObservedPointer {
+public:
+    ObservedPointer() = default;
+
+    explicit ObservedPointer(T* ptr) : ptr_(ptr) {
+    }
+
+    template <typename Y>
+    ObservedPointer(const ObservedPointer<Y, Thin>& other) : ptr_(other.ptr_) {
+    }
+
+    template <typename Block>
+    T* Get(const Block*) const {
+        return ptr_;
+    }
+
+private:
+    template <typename Y, bool>
+    friend class ObservedPointer;
+
+    T* ptr_ = nullptr;
+};
+
+// ... or read from the control block (thin layout).
+template <typename T>
+class ObservedPointer<T, true> {
+public:
+    ObservedPointer() = default;
+
+    explicit ObservedPointer(T*) {
+    }
+
+    template <typename Y>
+    ObservedPointer(const ObservedPointer<Y, true>&) {
+    }
+
+    template <typename Block>
+    T* Get(const Block* cb) const {
+        return cb ? static_cast<T*>(cb->GetObject()) : nullptr;
+    }
+};
+
+// Control block type shared by all pointers with the same policies
+template <typename... Policies>
+using SharedControlBlock =
+    ControlBlock<typename SharedPolicies<Policies...>::Counting, SharedPolicies<Policies...>::kThin,
+                 SharedPolicies<Policies...>::kClassIds>;
+
+class EnableSharedFromThisTBase {};
+
+class WeakRefCountedBase {};
+
+// What a SharedPtr without a control block (see kLazyBlock) needs to know about the
+// type the object was created as.
+template <typename Object, typename Block>
+struct LazyOwner {
+    void (*destroy)(Object*);
+    Block* (*new_block)(Object*);  // Leaves the object alive if allocation throws.
+    uint32_t class_id;
+};
+
+// Counting policy for objects that count their own references (see external.h)
+template <typename Traits>
+struct ExternalCounting {
+    using Category = CountingPolicy;
+};
+
+template <typename Counting>
+struct ExternalTraitsOf {
+    using Type = void;
+};
+
+template <typename Traits>
+struct ExternalTraitsOf<ExternalCounting<Traits>> {
+    using Type = Traits;
+};
+
+// Counting policy for RefCounted and other types with IncRef/DecRef/RefCount
+// members: the pointer uses the object's own counter (see external.h).
+using EmbeddedCounting = ExternalCounting<IntrusiveTraits>;
+
+// How SharedPtr<T, Policies...> reaches a counter embedded in the object, or void
+// if it needs a control block. Such pointers are specialized in external.h.
+// Decided by the policies alone: looking at `T` would need it complete, and a
+// SharedPtr<T> named inside T would get another layout than the one named after.
+template <typename T, typename... Policies>
+using EmbeddedCountTraits = typename ExternalTraitsOf<typename SharedPolicies<Policies...>::Counting>::Type;
+
+template <typename T, typename... Policies>
+class EnableSharedFromThis;
+
+template <typename T, typename... Policies>
+class SharedPtr {
+    using Traits = SharedPolicies<Policies...>;
+    using Block = SharedControlBlock<Policies...>;
+    using Observed = ObservedPointer<T, Traits::kThin>;
+
+    static constexpr bool kThin = Traits::kThin;
+
+    using Object = std::remove_cv_t<T>;
+    using Lazy = LazyOwner<Object, Block>;
+
+    // Objects that carry a pointer to their own control block
+    template <typename Y>
+    static constexpr bool kWeakRefCounted = std::is_convertible_v<Y*, const volatile WeakRefCountedBase*>;
+
+    // With LazyBlock, `SharedPtr(new Y)` makes the control block on the first copy
+    // or WeakPtr; until then `cb_` points to the static LazyOwner of Y with kLazyBit
+    // set. Atomic counting is excluded because copies of a const pointer could race
+    // to make the block, the thin layout because the object address lives in the
+    // block. Objects that point to their own block (EnableSharedFromThis,
+    // WeakRefCounted) and Y that cannot be reached back from T get it right away.
+    static_assert(!Traits::kLazyBlock ||
+                      (!kThin && std::is_base_of_v<SingleThreadedCounting, typename Traits::Counting>),
+                  "LazyBlock needs the fat layout and single-threaded counting");
+
+    template <typename Y>
+    static constexpr bool kLazyBlock =
+        Traits::kLazyBlock && !std::is_convertible_v<Y*, const volatile EnableSharedFromThisTBase*> &&
+        !kWeakRefCounted<Y> && requires(Object* object) { static_cast<Y*>(object); };
+
+    static constexpr uintptr_t kLazyBit = 1;
+
+    // Thin pointers cannot adjust the object pointer, so they only convert between
+    // cv-variants of the same type.
+    template <typename Y>
+    static constexpr bool kCompatible =
+        std::is_convertible_v<Y*, T*> &&
+        (!kThin || std::is_same_v<std::remove_cv_t<Y>, std::remove_cv_t<T>>);
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    SharedPtr() {
+    }
+    SharedPtr(std::nullptr_t) {
+    }
+
+    template <typename Y>
+    requires std::is_convertible_v<Y*, T*>
+    explicit SharedPtr(Y* ptr) : cb_(AcquireBlock(ptr)), observed_(ptr) {
+        if constexpr (!kWeakRefCounted<Y> && !kLazyBlock<Y>) {
+            AttachObject(ptr);
+        }
+        InitWeakThis(ptr);
+    }
+
+    SharedPtr(const SharedPtr& other) : cb_(other.Share()), observed_(other.observed_) {
+        IncreaseCBCounter();
+    }
+
+    SharedPtr(SharedPtr&& other) : cb_(other.cb_), observed_(other.observed_) {
+        other.cb_ = nullptr;
+        other.observed_ = {};
+    }
+
+    template <typename Y, typename... P>
+    friend class SharedPtr;
+
+    template <typename Y, typename... P>
+    friend class WeakPtr;
+
+    friend struct SharedPtrAccess;
+
+    template <typename Y>
+    requires kCompatible<Y>
+    SharedPtr(const SharedPtr<Y, Policies...>& other) : cb_(other.Share()), observed_(other.observed_) {
+        IncreaseCBCounter();
+    }
+
+    // A pointer without a block stays so between cv-variants of the same type.
+    template <typename Y>
+    requires kCompatible<Y>
+    SharedPtr(SharedPtr<Y, Policies...>&& other)
+        : cb_(std::is_same_v<std::remove_cv_t<Y>, Object> ? other.cb_ : other.Share()),
+          observed_(other.observed_) {
+        other.cb_ = nullptr;
+        other.observed_ = {};
+    }
+
+    // Aliasing constructor
+    // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
+    template <typename Y, typename... P>
+    requires(!kThin)
+    SharedPtr(const SharedPtr<Y, P...>& other, T* ptr) : cb_(other.Share()), observed_(ptr) {
+        static_assert(std::is_same_v<Block, typename SharedPtr<Y, P...>::Block>,
+                      "aliasing requires the same counting policy");
+        IncreaseCBCounter();
+    }
+
+    // Same, but takes over the reference of `other` without touching the counter
+    template <typename Y, typename... P>
+    requires(!kThin)
+    SharedPtr(SharedPtr<Y, P...>&& other, T* ptr) : cb_(other.Share()), observed_(ptr) {
+        static_assert(std::is_same_v<Block, typename SharedPtr<Y, P...>::Block>,
+                      "aliasing requires the same counting policy");
+        other.cb_ = nullptr;
+        other.observed_ = {};
+    }
+
+    // Promote `WeakPtr`
+    // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
+    template <typename Y>
+    requires kCompatible<Y>
+    explicit SharedPtr(const WeakPtr<Y, Policies...>& other) {
+        if (!other.cb_ || !other.cb_->TryIncreaseSharedCounter()) {
+            throw BadWeakPtr();
+        }
+        cb_ = other.cb_;
+        observed_ = other.observed_;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    SharedPtr& operator=(const SharedPtr& other) {
+        SharedPtr(other).Swap(*this);
+        return *this;
+    }
+    SharedPtr& operator=(SharedPtr&& other) {
+        // Via a temporary: `other` may be owned by the object released here.
+        SharedPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~SharedPtr() {
+        DecreaseCBCounter();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        SharedPtr().Swap(*this);
+    }
+
+    // Reuses the control block if this is its only reference and it owns a `Y`.
+    template <typename Y>
+    requires std::is_convertible_v<Y*, T*>
+    void Reset(Y* ptr) {
+        using PointerBlock = ControlBlockPointer<Y, Block, typename Traits::Allocation>;
+        if constexpr (!kWeakRefCounted<Y>) {
+            if (cb_ && !IsLazy() && cb_->Tag() == &kBlockTag<PointerBlock> && cb_->IsUnique()) {
+                Y* previous = static_cast<PointerBlock*>(cb_)->Exchange(ptr);
+                observed_ = Observed(ptr);
+                AttachObject(ptr);
+                delete previous;
+                InitWeakThis(ptr);
+                return;
+            }
+        }
+        SharedPtr(ptr).Swap(*this);
+    }
+
+    // Replaces the object with `T(args...)`. If this is the only reference to a
+    // block made by `MakeShared<T>`, the new object is built in the same storage.
+    template <typename... Args>
+    T& Emplace(Args&&... args) {
+        using ObjectBlock = ControlBlockObject<T, Block, typename Traits::Allocation>;
+        if (cb_ && !IsLazy() && cb_->Tag() == &kBlockTag<ObjectBlock> && cb_->IsUnique()) {
+            auto* block = static_cast<ObjectBlock*>(cb_);
+            try {
+                block->Reconstruct(std::forward<Args>(args)...);
+            } catch (...) {
+                cb_ = nullptr;
+                observed_ = {};
+                throw;
+            }
+            observed_ = Observed(block->Object());
+            InitWeakThis(block->Object());
+            return *block->Object();
+        }
+        *this = MakeShared<T, Policies...>(std::forward<Args>(args)...);
+        return *Get();
+    }
+
+    void Swap(SharedPtr& other) {
+        std::swap(cb_, other.cb_);
+        std::swap(observed_, other.observed_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return observed_.Get(cb_);
+    }
+    T& operator*() const {
+        return *Get();
+    }
+
+    T* operator->() const {
+        return Get();
+    }
+    size_t UseCount() const {
+        if (IsLazy()) {
+            return 1;
+        }
+        return cb_ ? cb_->GetSharedCounter() : 0;
+    }
+    explicit operator bool() const {
+        return Get() != nullptr;
+    }
+
+    // Hints the CPU to start loading the object and the control block.
+    // With the thin layout only the block is prefetched: the object address lives in it.
+    template <PrefetchMode Mode = PrefetchMode::kRead, PrefetchLocality Locality = PrefetchLocality::kHigh>
+    void Prefetch() const {
+        if constexpr (!kThin) {
+            PrefetchAddress<Mode, Locality>(Get());
+        }
+        PrefetchAddress<Mode, Locality>(cb_);
+    }
+
+private:
+    // Takes over a reference already counted in `cb`.
+    SharedPtr(Block* cb, Observed observed) : cb_(cb), observed_(observed) {
+    }
+
+    // A WeakRefCounted object is already owned by its block (made on the first
+    // reference if it was created by `new`); other objects get a new one.
+    template <typename Y>
+    static Block* AcquireBlock(Y* ptr) {
+        if constexpr (kWeakRefCounted<Y>) {
+            if (!ptr) {
+                return nullptr;
+            }
+            auto* object = const_cast<std::remove_cv_t<Y>*>(ptr);
+            object->IncRef();
+            return object->cb_;
+        } else if constexpr (kLazyBlock<Y>) {
+            return reinterpret_cast<Block*>(reinterpret_cast<uintptr_t>(&kLazyOwner<Y>) | kLazyBit);
+        } else {
+            return NewPointerBlock(ptr);
+        }
+    }
+
+    template <typename Y>
+    static void DeleteAs(Object* object) {
+        delete static_cast<Y*>(object);
+    }
+
+    template <typename Y>
+    static Block* NewBlockAs(Object* object) {
+        using PointerBlock = ControlBlockPointer<Y, Block, typename Traits::Allocation>;
+        Block* cb = NewControlBlock<PointerBlock, typename Traits::Allocation>(static_cast<Y*>(object));
+        if constexpr (Traits::kClassIds) {
+            cb->SetClassId(ClassIdOf<Y>());
+        }
+        return cb;
+    }
+
+    template <typename Y>
+    static constexpr Lazy kLazyOwner = {&DeleteAs<Y>, &NewBlockAs<Y>, ClassIdOf<Y>()};
+
+    // Always false without LazyBlock, so other pointers pay nothing for it.
+    bool IsLazy() const {
+        if constexpr (Traits::kLazyBlock) {
+            return reinterpret_cast<uintptr_t>(cb_) & kLazyBit;
+        } else {
+            return false;
+        }
+    }
+
+    const Lazy* LazyOwnerOf() const {
+        return reinterpret_cast<const Lazy*>(reinterpret_cast<uintptr_t>(cb_) & ~kLazyBit);
+    }
+
+    Object* LazyObject() const {
+        return const_cast<Object*>(observed_.Get(cb_));
+    }
+
+    // The control block, made now if the object had none yet. Copies of a const
+    // pointer call this, hence `cb_` is mutable.
+    Block* Share() const {
+        if (IsLazy()) {
+            cb_ = LazyOwnerOf()->new_block(LazyObject());
+        }
+        return cb_;
+    }
+
+    template <typename Y>
+    static Block* NewPointerBlock(Y* ptr) {
+        using PointerBlock = ControlBlockPointer<Y, Block, typename Traits::Allocation>;
+        try {
+            return NewControlBlock<PointerBlock, typename Traits::Allocation>(ptr);
+        } catch (...) {
+            delete ptr;
+            throw;
+        }
+    }
+
+    // `Y` is the type the object was created as.
+    template <typename Y>
+    void AttachObject(Y* ptr) {
+        if constexpr (kThin) {
+            T* object = ptr;
+            cb_->SetObject(const_cast<std::remove_cv_t<T>*>(object));
+        }
+        if constexpr (Traits::kClassIds) {
+            cb_->SetClassId(ClassIdOf<Y>());
+        }
+    }
+
+    // Also points a WeakRefCounted object made in the block (MakeShared, Emplace) at it.
+    template <typename Y>
+    void InitWeakThis(Y* ptr) {
+        if constexpr (std::is_convertible_v<Y*, const volatile EnableSharedFromThisTBase*>) {
+            if (ptr) {
+                auto* object = const_cast<std::remove_cv_t<Y>*>(ptr);
+                AttachWeakThis(object, object);
+            }
+        }
+        if constexpr (kWeakRefCounted<Y>) {
+            auto* object = const_cast<std::remove_cv_t<Y>*>(ptr);
+            if (object && !object->cb_) {
+                object->cb_ = cb_;
+            }
+        }
+    }
+
+    // `object` is passed separately: the base may be virtual.
+    template <typename U, typename Y>
+    void AttachWeakThis(EnableSharedFromThis<U, Policies...>* base, Y* object) {
+        static_assert(!kThin || std::is_same_v<std::remove_cv_t<T>, U>,
+                      "thin pointers need EnableSharedFromThis of the pointee type itself");
+        if (base->weak_this_.Expired()) {
+            base->weak_this_.Assign(cb_, ObservedPointer<U, kThin>(static_cast<U*>(object)));
+        }
+    }
+
+    void IncreaseCBCounter() const {
+        if (cb_) {
+            cb_->IncreaseSharedCounter();
+        }
+    }
+
+    void DecreaseCBCounter() const {
+        if (IsLazy()) {
+            LazyOwnerOf()->destroy(LazyObject());
+        } else if (cb_) {
+            cb_->DecreaseSharedCounter();
+        }
+    }
+
+    mutable Block* cb_ = nullptr;
+    [[no_unique_address]] Observed observed_;
+};
+
+template <typename T>
+SharedPtr(T*) -> SharedPtr<T>;
+
+template <typename T, typename... Policies>
+SharedPtr(const WeakPtr<T, Policies...>&) -> SharedPtr<T, Policies...>;
+
+template <typename T, typename... P, typename U, typename... Q>
+inline bool operator==(const SharedPtr<T, P...>& left, const SharedPtr<U, Q...>& right) {
+    return left.Get() == right.Get();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Casts
+// https://en.cppreference.com/w/cpp/memory/shared_ptr/pointer_cast
+// Built on the aliasing constructors, so they need the fat layout. The rvalue
+// overloads hand the reference over and leave `ptr` empty (unless a dynamic
+// cast fails, in which case `ptr` is untouched).
+
+template <typename T, typename U, typename... P>
+SharedPtr<T, P...> StaticPointerCast(const SharedPtr<U, P...>& ptr) {
+    return SharedPtr<T, P...>(ptr, static_cast<T*>(ptr.Get()));
+}
+
+template <typename T, typename U, typename... P>
+SharedPtr<T, P...> StaticPointerCast(SharedPtr<U, P...>&& ptr) {
+    T* object = static_cast<T*>(ptr.Get());
+    return SharedPtr<T, P...>(std::move(ptr), object);
+}
+
+template <typename T, typename U, typename... P>
+SharedPtr<T, P...> DynamicPointerCast(const SharedPtr<U, P...>& ptr) {
+    if (T* object = dynamic_cast<T*>(ptr.Get())) {
+        return SharedPtr<T, P...>(ptr, object);
+    }
+    return {};
+}
+
+template <typename T, typename U, typename... P>
+SharedPtr<T, P...> DynamicPointerCast(SharedPtr<U, P...>&& ptr) {
+    if (T* object = dynamic_cast<T*>(ptr.Get())) {
+        return SharedPtr<T, P...>(std::move(ptr), object);
+    }
+    return {};
+}
+
+template <typename T, typename U, typename... P>
+SharedPtr<T, P...> ConstPointerCast(const SharedPtr<U, P...>& ptr) {
+    return SharedPtr<T, P...>(ptr, const_cast<T*>(ptr.Get()));
+}
+
+template <typename T, typename U, typename... P>
+SharedPtr<T, P...> ConstPointerCast(SharedPtr<U, P...>&& ptr) {
+    T* object = const_cast<T*>(ptr.Get());
+    return SharedPtr<T, P...>(std::move(ptr), object);
+}
+
+template <typename T, typename U, typename... P>
+SharedPtr<T, P...> ReinterpretPointerCast(const SharedPtr<U, P...>& ptr) {
+    return SharedPtr<T, P...>(ptr, reinterpret_cast<T*>(ptr.Get()));
+}
+
+template <typename T, typename U, typename... P>
+SharedPtr<T, P...> ReinterpretPointerCast(SharedPtr<U, P...>&& ptr) {
+    T* object = reinterpret_cast<T*>(ptr.Get());
+    return SharedPtr<T, P...>(std::move(ptr), object);
+}
+
+// Private entry points for the factories and casts below
+struct SharedPtrAccess {
+    template <typename T, typename... Policies>
+    static uint32_t ClassId(const SharedPtr<T, Policies...>& ptr) {
+        if (ptr.IsLazy()) {
+            return ptr.LazyOwnerOf()->class_id;
+        }
+        return ptr.cb_ ? ptr.cb_->GetClassId() : 0;
+    }
+
+    // Identity of the owned allocation, the same for all aliases
+    template <typename T, typename... Policies>
+    static const void* Block(const SharedPtr<T, Policies...>& ptr) {
+        return ptr.IsLazy() ? static_cast<const void*>(ptr.Get()) : ptr.cb_;
+    }
+
+    template <typename T, typename... Policies>
+    static SharedPtr<T, Policies...> Adopt(SharedControlBlock<Policies...>* cb, T* object) {
+        SharedPtr<T, Policies...> res(cb, ObservedPointer<T, SharedPolicies<Policies...>::kThin>(object));
+        res.AttachObject(object);
+        res.InitWeakThis(object);
+        return res;
+    }
+
+    // Gives up the reference to the caller as the block and the object pointer.
+    template <typename T, typename... Policies>
+    static std::pair<SharedControlBlock<Policies...>*, T*> Detach(SharedPtr<T, Policies...>& ptr) {
+        auto* block = ptr.Share();
+        T* object = ptr.Get();
+        ptr.cb_ = nullptr;
+        ptr.observed_ = {};
+        return {block, object};
+    }
+
+    // Takes over a reference counted in `cb`, the inverse of Detach.
+    template <typename T, typename... Policies>
+    static SharedPtr<T, Policies...> Attach(SharedControlBlock<Policies...>* cb, T* object) {
+        return SharedPtr<T, Policies...>(cb, ObservedPointer<T, SharedPolicies<Policies...>::kThin>(object));
+    }
+
+    // The same for weak references
+    template <typename T, typename... Policies>
+    static std::pair<SharedControlBlock<Policies...>*, T*> Detach(WeakPtr<T, Policies...>& ptr) {
+        auto* block = std::exchange(ptr.cb_, nullptr);
+        T* object = std::exchange(ptr.observed_, {}).Get(block);
+        return {block, object};
+    }
+
+    template <typename T, typename... Policies>
+    static WeakPtr<T, Policies...> AttachWeak(SharedControlBlock<Policies...>* cb, T* object) {
+        WeakPtr<T, Policies...> res;
+        res.cb_ = cb;
+        res.observed_ = ObservedPointer<T, SharedPolicies<Policies...>::kThin>(object);
+        return res;
+    }
+
+    // Gives up the reference without decrementing the count.
+    template <typename T, typename... Policies>
+    static T* Release(SharedPtr<T, Policies...>& ptr) {
+        ptr.Share();
+        T* object = ptr.Get();
+        ptr.cb_ = nullptr;
+        ptr.observed_ = {};
+        return object;
+    }
+
+    // Points `EnableSharedFromThis` of another object owned by `owner` at the block.
+    template <typename T, typename... Policies>
+    static void InitWeakThis(SharedPtr<T, Policies...>& owner, T* object) {
+        owner.InitWeakThis(object);
+    }
+};
+
+// Allocate memory only once
+template <typename T, typename... Policies, typename... Args>
+SharedPtr<T, Policies...> MakeShared(Args&&... args) {
+    if constexpr (!std::is_void_v<EmbeddedCountTraits<T, Policies...>>) {
+        static_assert(std::is_same_v<EmbeddedCountTraits<T, Policies...>, IntrusiveTraits>,
+                      "objects counted by another library are made by that library");
+        return SharedPtr<T, Policies...>(MakeIntrusive<T>(std::forward<Args>(args)...));
+    } else {
+        using Allocation = typename SharedPolicies<Policies...>::Allocation;
+        using Block = ControlBlockObject<T, SharedControlBlock<Policies...>, Allocation>;
+        Block* block = NewControlBlock<Block, Allocation>(std::forward<Args>(args)...);
+        return SharedPtrAccess::Adopt<T, Policies...>(block, block->Object());
+    }
+}
+
+// Like MakeShared, but the single allocation comes from `alloc`
+template <typename T, typename... Policies, typename Alloc, typename... Args>
+SharedPtr<T, Policies...> AllocateShared(const Alloc& alloc, Args&&... args) {
+    using Block = ControlBlockAllocated<T, SharedControlBlock<Policies...>, Alloc>;
+    typename Block::BlockAlloc block_alloc(alloc);
+    Block* block = std::allocator_traits<typename Block::BlockAlloc>::allocate(block_alloc, 1);
+    try {
+        new (block) Block(alloc, std::forward<Args>(args)...);
+    } catch (...) {
+        std::allocator_traits<typename Block::BlockAlloc>::deallocate(block_alloc, block, 1);
+        throw;
+    }
+    return SharedPtrAccess::Adopt<T, Policies...>(block, block->Object());
+}
+
+// Downcast without RTTI: checks the class id recorded when the object was created
+// (see class_id.h) instead of calling dynamic_cast. Needs the StoreClassIds policy,
+// a registered `T` and a non-virtual path from `U` to `T`. `ptr` must point to the
+// object it owns (not to an alias), and objects are only known as precisely as the
+// type they were created as: `SharedPtr<Base>(static_cast<Derived*>(p))` is a Derived.
+template <typename T, typename U, typename... P>
+bool FastIsA(const SharedPtr<U, P...>& ptr) {
+    static_assert(SharedPolicies<P...>::kClassIds, "FastPointerCast needs StoreClassIds");
+    static_assert(HasClassIds<T>, "T has no ClassIds specialization");
+    if constexpr (HasClassIds<U> && !std::is_same_v<std::remove_cv_t<T>, std::remove_cv_t<U>>) {
+        static_assert(kClassIdsNested<T, U>, "class id range of T is not inside the one of U");
+    }
+    return ClassIds<std::remove_cv_t<T>>::Contains(SharedPtrAccess::ClassId(ptr));
+}
+
+template <typename T, typename U, typename... P>
+SharedPtr<T, P...> FastPointerCast(const SharedPtr<U, P...>& ptr) {
+    if (FastIsA<T>(ptr)) {
+        return SharedPtr<T, P...>(ptr, static_cast<T*>(ptr.Get()));
+    }
+    return {};
+}
+
+// `ptr` keeps its reference if the cast fails.
+template <typename T, typename U, typename... P>
+SharedPtr<T, P...> FastPointerCast(SharedPtr<U, P...>&& ptr) {
+    if (FastIsA<T>(ptr)) {
+        T* object = static_cast<T*>(ptr.Get());
+        return SharedPtr<T, P...>(std::move(ptr), object);
+    }
+    return {};
+}
+
+// Look for usage examples in tests
+template <typename T, typename... Policies>
+class EnableSharedFromThis : public EnableSharedFromThisTBase {
+public:
+    SharedPtr<T, Policies...> SharedFromThis() {
+        return SharedPtr<T, Policies...>(weak_this_);
+    }
+    SharedPtr<const T, Policies...> SharedFromThis() const {
+        return SharedPtr<const T, Policies...>(weak_this_);
+    }
+
+    WeakPtr<T, Policies...> WeakFromThis() noexcept {
+        return WeakPtr<T, Policies...>(weak_this_);
+    }
+    WeakPtr<const T, Policies...> WeakFromThis() const noexcept {
+        return WeakPtr<const T, Policies...>(weak_this_);
+    }
+
+    template <typename W, typename... P>
+    friend class SharedPtr;
+
+private:
+    WeakPtr<T, Policies...> weak_this_ = {};
+};
+
+// RefCounted for objects that WeakPtr can watch. The counters live in a SharedPtr
+// control block that the object points to: MakeShared<T> and MakeIntrusive<T>
+// build the object inside the block, `new T` gets one on its first reference.
+// SharedPtr<T, Policies...>, IntrusivePtr<T> and WeakPtr<T, Policies...> of the
+// object all share that block, so each object costs one allocation whichever
+// pointer it is created for and handed to.
+template <typename Derived, typename... Policies>
+class WeakRefCounted : public WeakRefCountedBase {
+    using Block = SharedControlBlock<Policies...>;
+    using Allocation = typename SharedPolicies<Policies...>::Allocation;
+
+public:
+    // For MakeIntrusive: the object comes back with its first reference counted.
+    struct DeleterType {
+        static constexpr bool kCreatesReference = true;
+
+        template <typename T, typename... Args>
+        static T* Create(Args&&... args) {
+            auto ptr = MakeShared<T, Policies...>(std::forward<Args>(args)...);
+            return SharedPtrAccess::Release(ptr);
+        }
+    };
+
+    WeakRefCounted() = default;
+
+    // Copies are new objects without a block.
+    WeakRefCounted(const WeakRefCounted&) {
+    }
+
+    WeakRefCounted& operator=(const WeakRefCounted&) {
+        return *this;
+    }
+
+    ~WeakRefCounted() = default;
+
+    void IncRef() {
+        if (cb_) {
+            cb_->IncreaseSharedCounter();
+            return;
+        }
+        // The new block counts this first reference.
+        using PointerBlock = ControlBlockPointer<Derived, Block, Allocation>;
+        auto* object = static_cast<Derived*>(this);
+        cb_ = NewControlBlock<PointerBlock, Allocation>(object);
+        cb_->SetObject(object);
+        cb_->SetClassId(ClassIdOf<Derived>());
+    }
+
+    // Destroys the object when the last strong reference goes away; the block
+    // stays while WeakPtrs watch it.
+    void DecRef() {
+        cb_->DecreaseSharedCounter();
+    }
+
+    size_t RefCount() const {
+        return cb_ ? cb_->GetSharedCounter() : 0;
+    }
+
+private:
+    template <typename T, typename... P>
+    friend class SharedPtr;
+
+    Block* cb_ = nullptr;
+};
+
+#include "external.h"
+#include "weak.h"
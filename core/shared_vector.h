@@ -0,0 +1,271 @@
+#pragma once
+
+#include "shared.h"
+
+#include <common/prefetch.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// A sequence of SharedPtr<T> kept as two parallel arrays, control blocks and
+// object pointers, instead of 16-byte {block, object} elements:
+//
+//  - Iteration (begin()/end() over T*) reads only the object pointers.
+//  - Releasing many elements (Clear, EraseIf, EraseNull) reads only the blocks,
+//    prefetches ahead and drops a run of one block (aliases from MakeSharedBatch,
+//    a pointer pushed repeatedly) with a single counter update.
+//  - Reset(i) leaves a hole; FindNull and EraseNull look for holes with SSE2
+//    compares of the object pointers and move the stretches between them in bulk.
+//
+// Elements are read as T* (valid while the vector holds them) or copied out with
+// Share(i). Needs the fat layout. A pointer whose block is not made yet (LazyBlock)
+// gets one when it is added. Destructors of released objects must not touch the
+// vector they are being released from.
+template <typename T, typename... Policies>
+class SharedPtrVector {
+    using Shared = SharedPtr<T, Policies...>;
+    using Block = SharedControlBlock<Policies...>;
+
+    static_assert(!SharedPolicies<Policies...>::kThin, "the object pointers are stored, use the fat layout");
+
+    static constexpr size_t kPrefetchDistance = 8;
+
+public:
+    SharedPtrVector() = default;
+
+    SharedPtrVector(const SharedPtrVector& other) : blocks_(other.blocks_), objects_(other.objects_) {
+        for (Block* block : blocks_) {
+            if (block) {
+                block->IncreaseSharedCounter();
+            }
+        }
+    }
+
+    SharedPtrVector(SharedPtrVector&& other) noexcept
+        : blocks_(std::move(other.blocks_)), objects_(std::move(other.objects_)) {
+    }
+
+    SharedPtrVector& operator=(const SharedPtrVector& other) {
+        SharedPtrVector(other).Swap(*this);
+        return *this;
+    }
+
+    SharedPtrVector& operator=(SharedPtrVector&& other) noexcept {
+        SharedPtrVector(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ~SharedPtrVector() {
+        static_assert(std::is_void_v<EmbeddedCountTraits<T, Policies...>>,
+                      "objects with embedded counters have no control block to store");
+        Release(0);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Access
+
+    size_t Size() const {
+        return objects_.size();
+    }
+
+    bool Empty() const {
+        return objects_.empty();
+    }
+
+    size_t Capacity() const {
+        return objects_.capacity();
+    }
+
+    // Null for holes
+    T* operator[](size_t index) const {
+        return objects_[index];
+    }
+
+    T* Front() const {
+        return objects_.front();
+    }
+
+    T* Back() const {
+        return objects_.back();
+    }
+
+    T* const* begin() const {  // NOLINT
+        return objects_.data();
+    }
+
+    T* const* end() const {  // NOLINT
+        return objects_.data() + objects_.size();
+    }
+
+    // Owning pointer to element `index`
+    Shared Share(size_t index) const {
+        if (blocks_[index]) {
+            blocks_[index]->IncreaseSharedCounter();
+        }
+        return SharedPtrAccess::Attach<T, Policies...>(blocks_[index], objects_[index]);
+    }
+
+    // Index of the first hole at or after `from`, Size() if there is none.
+    size_t FindNull(size_t from = 0) const {
+        T* const* objects = objects_.data();
+        const size_t size = objects_.size();
+        size_t index = from;
+#ifdef __SSE2__
+        if constexpr (sizeof(T*) == 8) {
+            // A pointer is null when both of its 32-bit halves compare equal to zero.
+            const __m128i zero = _mm_setzero_si128();
+            for (; index + 4 <= size; index += 4) {
+                auto first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(objects + index));
+                auto second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(objects + index + 2));
+                unsigned halves = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(first, zero))) |
+                                  _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(second, zero))) << 4;
+                if (unsigned nulls = halves & (halves >> 1) & 0x55) {
+                    return index + std::countr_zero(nulls) / 2;
+                }
+            }
+        }
+#endif
+        while (index < size && objects[index]) {
+            ++index;
+        }
+        return index;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reserve(size_t capacity) {
+        blocks_.reserve(capacity);
+        objects_.reserve(capacity);
+    }
+
+    void PushBack(Shared ptr) {
+        if (objects_.size() == objects_.capacity()) {
+            Reserve(objects_.empty() ? 8 : 2 * objects_.size());
+        }
+        auto [block, object] = SharedPtrAccess::Detach(ptr);
+        blocks_.push_back(block);
+        objects_.push_back(object);
+    }
+
+    template <typename... Args>
+    T* EmplaceBack(Args&&... args) {
+        PushBack(MakeShared<T, Policies...>(std::forward<Args>(args)...));
+        return objects_.back();
+    }
+
+    Shared PopBack() {
+        auto last = SharedPtrAccess::Attach<T, Policies...>(blocks_.back(), objects_.back());
+        blocks_.pop_back();
+        objects_.pop_back();
+        return last;
+    }
+
+    // Replaces element `index` and returns the previous one.
+    Shared Exchange(size_t index, Shared ptr) {
+        auto [block, object] = SharedPtrAccess::Detach(ptr);
+        return SharedPtrAccess::Attach<T, Policies...>(std::exchange(blocks_[index], block),
+                                                       std::exchange(objects_[index], object));
+    }
+
+    // Leaves a hole that keeps the other indices valid, see EraseNull.
+    void Reset(size_t index) {
+        Exchange(index, nullptr);
+    }
+
+    // Removes element `index` and moves the following ones down.
+    void Erase(size_t index) {
+        auto erased = SharedPtrAccess::Attach<T, Policies...>(blocks_[index], objects_[index]);
+        blocks_.erase(blocks_.begin() + index);
+        objects_.erase(objects_.begin() + index);
+    }
+
+    // Removes the elements for which `pred(T*)` holds (it sees null for holes) and
+    // keeps the order of the others. Returns the number removed.
+    template <typename Pred>
+    size_t EraseIf(Pred pred) {
+        const size_t size = objects_.size();
+        size_t kept = 0;
+        for (size_t i = 0; i < size; ++i) {
+            if (!pred(objects_[i])) {
+                // Swapped, so that elements stay whole if `pred` throws and the
+                // removed ones gather at the end.
+                std::swap(blocks_[kept], blocks_[i]);
+                std::swap(objects_[kept], objects_[i]);
+                ++kept;
+            }
+        }
+        objects_.resize(kept);
+        Release(kept);
+        return size - kept;
+    }
+
+    // Removes the holes, keeping the order of the other elements. Returns their number.
+    size_t EraseNull() {
+        const size_t size = objects_.size();
+        size_t kept = FindNull();
+        for (size_t index = kept; index < size;) {
+            for (; index < size && !objects_[index]; ++index) {
+                // An alias of null still holds its block.
+                if (Block* block = std::exchange(blocks_[index], nullptr)) {
+                    block->DecreaseSharedCounter();
+                }
+            }
+            size_t next_null = FindNull(index);
+            std::copy(blocks_.begin() + index, blocks_.begin() + next_null, blocks_.begin() + kept);
+            std::copy(objects_.begin() + index, objects_.begin() + next_null, objects_.begin() + kept);
+            kept += next_null - index;
+            index = next_null;
+        }
+        blocks_.resize(kept);
+        objects_.resize(kept);
+        return size - kept;
+    }
+
+    void Clear() {
+        objects_.clear();
+        Release(0);
+    }
+
+    void Swap(SharedPtrVector& other) noexcept {
+        blocks_.swap(other.blocks_);
+        objects_.swap(other.objects_);
+    }
+
+private:
+    // Drops the references of blocks_[from..] with one update per run of the same
+    // block, then shrinks the block array to `from`.
+    void Release(size_t from) {
+        Block* const* block = blocks_.data() + from;
+        Block* const* last = blocks_.data() + blocks_.size();
+        while (block != last) {
+            if (last - block > static_cast<ptrdiff_t>(kPrefetchDistance)) {
+                PrefetchAddress<PrefetchMode::kWrite>(block[kPrefetchDistance]);
+            }
+            Block* current = *block;
+            size_t count = 1;
+            while (++block != last && *block == current) {
+                ++count;
+            }
+            if (current) {
+                current->DecreaseSharedCounter(count);
+            }
+        }
+        blocks_.resize(from);
+    }
+
+    std::vector<Block*> blocks_;
+    std::vector<T*> objects_;
+};
+
+// Containers move rather than copy on reallocation.
+static_assert(std::is_nothrow_move_constructible_v<SharedPtrVector<int>>);
+static_assert(std::is_nothrow_move_assignable_v<SharedPtrVector<int>>);
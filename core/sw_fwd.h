@@ -0,0 +1,15 @@
+#pragma once
+
+#include <exception>
+
+// Instead of std::bad_weak_ptr
+class BadWeakPtr : public std::exception {};
+
+template <typename T, typename... Policies>
+class SharedPtr;
+
+template <typename T, typename... Policies>
+class WeakPtr;
+
+template <typename T, typename... Policies, typename... Args>
+SharedPtr<T, Policies...> MakeShared(Args&&... args);
@@ -0,0 +1,448 @@
+#pragma once
+
+#include "shared.h"
+#include "weak.h"
+
+#include <common/slab.h>
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// C++20 coroutines whose frames are shared objects:
+//
+//     SharedTask<int> Fetch(LocalExecutor& executor) {
+//         co_await executor.Schedule();
+//         co_return 42;
+//     }
+//
+//     SharedTask<> Connection::Serve(LocalExecutor& executor) {
+//         auto weak = WeakFromThis();
+//         for (;;) {
+//             int value = co_await Fetch(executor);
+//             auto self = co_await IfAlive(weak);  // Cancels the task if the connection is gone.
+//             self->Handle(value);
+//         }
+//     }
+//
+// The frame carries a control block in front of it, so SharedTask is a SharedPtr
+// to the frame, awaiters hold SharedPtr or WeakPtr to it, and the frame and the
+// block are one allocation from slab size classes. Tasks start eagerly and hold a
+// reference to themselves until they finish or are cancelled; a task whose
+// executor drops it while suspended is leaked rather than resumed after free.
+
+class TaskCancelled : public std::exception {};
+
+// Frames (with their block) of up to 4 KiB come from slabs, larger ones from the heap.
+struct FramePool {
+    static constexpr size_t kMaxSlabBytes = 4096;
+
+    static void* Allocate(size_t size) {
+        if (size <= 128) {
+            return SlabAllocator<128, 16>::Instance().Allocate();
+        }
+        if (size <= 256) {
+            return SlabAllocator<256, 16>::Instance().Allocate();
+        }
+        if (size <= 512) {
+            return SlabAllocator<512, 16>::Instance().Allocate();
+        }
+        if (size <= 1024) {
+            return SlabAllocator<1024, 16>::Instance().Allocate();
+        }
+        if (size <= 2048) {
+            return SlabAllocator<2048, 16>::Instance().Allocate();
+        }
+        if (size <= kMaxSlabBytes) {
+            return SlabAllocator<kMaxSlabBytes, 16>::Instance().Allocate();
+        }
+        return ::operator new(size);
+    }
+
+    static void Deallocate(void* memory, size_t size) {
+        if (size <= kMaxSlabBytes) {
+            SlabAllocatorBase::Free(memory);
+        } else {
+            ::operator delete(memory, size);
+        }
+    }
+};
+
+// Placed in front of a coroutine frame by the promise's operator new. Destroying
+// the object destroys the frame (and with it the promise and all locals); the
+// memory goes back once the weak references are gone as well.
+template <typename Base>
+class ControlBlockFrame final : public Base {
+public:
+    explicit ControlBlockFrame(size_t bytes) : bytes_(bytes) {
+    }
+
+    const void* Tag() const override {
+        return &kBlockTag<ControlBlockFrame>;
+    }
+
+    void Own(std::coroutine_handle<> frame) {
+        frame_ = frame;
+    }
+
+    // False until the coroutine has returned its SharedTask.
+    bool Owned() const {
+        return static_cast<bool>(frame_);
+    }
+
+    void Free() {
+        size_t bytes = bytes_;
+        this->~ControlBlockFrame();
+        FramePool::Deallocate(this, bytes);
+    }
+
+private:
+    void DestroyObject() override {
+        frame_.destroy();
+    }
+
+    void DestroyBlock() override {
+        Free();
+    }
+
+    std::coroutine_handle<> frame_;
+    size_t bytes_;
+};
+
+template <typename T = void, typename... Policies>
+class SharedTask;
+
+template <typename T>
+class TaskResult {
+public:
+    template <typename U = T>
+    void return_value(U&& value) {
+        value_.emplace(std::forward<U>(value));
+    }
+
+protected:
+    const T& Value() const {
+        return *value_;
+    }
+
+private:
+    std::optional<T> value_;
+};
+
+template <>
+class TaskResult<void> {
+public:
+    void return_void() {
+    }
+
+protected:
+    void Value() const {
+    }
+};
+
+template <typename T, typename... Policies>
+class SharedTaskPromise : public TaskResult<T> {
+    using Block = ControlBlockFrame<SharedControlBlock<Policies...>>;
+    using Handle = std::coroutine_handle<SharedTaskPromise>;
+
+    static constexpr size_t kHeader =
+        (sizeof(Block) + __STDCPP_DEFAULT_NEW_ALIGNMENT__ - 1) / __STDCPP_DEFAULT_NEW_ALIGNMENT__ *
+        __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+
+public:
+    // Awaiting coroutine, linked through the awaiter in its own frame.
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        Waiter* next = nullptr;
+    };
+
+    static void* operator new(size_t size) {
+        void* memory = FramePool::Allocate(kHeader + size);
+        new (memory) Block(kHeader + size);
+        return static_cast<char*>(memory) + kHeader;
+    }
+
+    // Frames of started tasks are freed by their block; this only frees the
+    // memory of a coroutine that failed before returning its SharedTask.
+    static void operator delete(void* frame, size_t) {
+        Block* block = BlockOf(frame);
+        if (!block->Owned()) {
+            block->Free();
+        }
+    }
+
+    SharedTask<T, Policies...> get_return_object() {
+        // The frame address is the one operator new returned.
+        Handle handle = Handle::from_promise(*this);
+        Block* block = BlockOf(handle.address());
+        block->Own(handle);
+        auto task = SharedPtrAccess::Adopt<SharedTaskPromise, Policies...>(block, this);
+        self_ = task;
+        return SharedTask<T, Policies...>(std::move(task));
+    }
+
+    std::suspend_never initial_suspend() noexcept {
+        return {};
+    }
+
+    auto final_suspend() noexcept {
+        struct FinalAwaiter {
+            bool await_ready() noexcept {
+                return false;
+            }
+            std::coroutine_handle<> await_suspend(Handle handle) noexcept {
+                return handle.promise().Finish();
+            }
+            void await_resume() noexcept {
+            }
+        };
+        return FinalAwaiter{};
+    }
+
+    void unhandled_exception() {
+        exception_ = std::current_exception();
+    }
+
+    bool Done() const {
+        return done_;
+    }
+
+    bool Cancelled() const {
+        return cancelled_;
+    }
+
+    decltype(auto) Result() const {
+        if (cancelled_) {
+            throw TaskCancelled();
+        }
+        if (exception_) {
+            std::rethrow_exception(exception_);
+        }
+        return this->Value();
+    }
+
+    // `waiter` is resumed when the task finishes or is cancelled.
+    void AddWaiter(Waiter* waiter) {
+        waiter->next = waiters_;
+        waiters_ = waiter;
+    }
+
+    // Stops at the current suspension point for good; the locals are destroyed
+    // with the frame. Returns the coroutine to resume next.
+    std::coroutine_handle<> Cancel() {
+        cancelled_ = true;
+        return Finish();
+    }
+
+    // Keeps `owner` alive until the task finishes, one owner at a time.
+    template <typename U>
+    void KeepAlive(SharedPtr<U, Policies...> owner) {
+        const auto* address = reinterpret_cast<const std::byte*>(owner.Get());
+        keep_alive_ = SharedPtr<const std::byte, Policies...>(std::move(owner), address);
+    }
+
+private:
+    static Block* BlockOf(void* frame) {
+        return reinterpret_cast<Block*>(static_cast<char*>(frame) - kHeader);
+    }
+
+    // Wakes the waiters and drops the self-reference, which may destroy the frame.
+    std::coroutine_handle<> Finish() noexcept {
+        done_ = true;
+        keep_alive_.Reset();
+        Waiter* waiter = std::exchange(waiters_, nullptr);
+        auto self = std::move(self_);
+        std::coroutine_handle<> next = std::noop_coroutine();
+        while (waiter) {
+            Waiter* following = waiter->next;
+            if (following) {
+                waiter->handle.resume();
+            } else {
+                next = waiter->handle;
+            }
+            waiter = following;
+        }
+        self.Reset();
+        return next;
+    }
+
+    // Keeps the frame alive until the task finishes.
+    SharedPtr<SharedTaskPromise, Policies...> self_;
+    SharedPtr<const std::byte, Policies...> keep_alive_;
+    Waiter* waiters_ = nullptr;
+    std::exception_ptr exception_;
+    bool done_ = false;
+    bool cancelled_ = false;
+};
+
+template <typename T, typename... Policies>
+class SharedTask {
+public:
+    using promise_type = SharedTaskPromise<T, Policies...>;
+
+    SharedTask() = default;
+
+    explicit operator bool() const {
+        return static_cast<bool>(promise_);
+    }
+
+    // Finished, failed or cancelled
+    bool Done() const {
+        return promise_->Done();
+    }
+
+    bool Cancelled() const {
+        return promise_->Cancelled();
+    }
+
+    // The value (a reference into the frame), or the exception the task ended with.
+    // Only for tasks that are Done.
+    decltype(auto) Result() const {
+        return promise_->Result();
+    }
+
+    WeakPtr<promise_type, Policies...> Weak() const {
+        return WeakPtr<promise_type, Policies...>(promise_);
+    }
+
+    size_t UseCount() const {
+        return promise_.UseCount();
+    }
+
+    // The awaiter keeps the frame alive until the result is read.
+    auto operator co_await() const {
+        struct Awaiter {
+            bool await_ready() const {
+                return promise->Done();
+            }
+            void await_suspend(std::coroutine_handle<> handle) {
+                waiter.handle = handle;
+                promise->AddWaiter(&waiter);
+            }
+            decltype(auto) await_resume() const {
+                return promise->Result();
+            }
+
+            SharedPtr<promise_type, Policies...> promise;
+            typename promise_type::Waiter waiter;
+        };
+        return Awaiter{promise_, {}};
+    }
+
+private:
+    friend promise_type;
+
+    explicit SharedTask(SharedPtr<promise_type, Policies...> promise) : promise_(std::move(promise)) {
+    }
+
+    SharedPtr<promise_type, Policies...> promise_;
+};
+
+// `co_await IfAlive(weak)` yields a SharedPtr to a live owner without suspending;
+// if the owner is gone, the task is cancelled instead of resumed.
+template <typename U, typename... P>
+class IfAliveAwaiter {
+public:
+    explicit IfAliveAwaiter(WeakPtr<U, P...> weak) : weak_(std::move(weak)) {
+    }
+
+    bool await_ready() {
+        owner_ = weak_.Lock();
+        return static_cast<bool>(owner_);
+    }
+
+    template <typename T, typename... Q>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<SharedTaskPromise<T, Q...>> handle) {
+        return handle.promise().Cancel();
+    }
+
+    SharedPtr<U, P...> await_resume() {
+        return std::move(owner_);
+    }
+
+private:
+    WeakPtr<U, P...> weak_;
+    SharedPtr<U, P...> owner_;
+};
+
+template <typename U, typename... P>
+IfAliveAwaiter<U, P...> IfAlive(WeakPtr<U, P...> weak) {
+    return IfAliveAwaiter<U, P...>(std::move(weak));
+}
+
+// `co_await KeepAlive(SharedFromThis())` keeps the object alive for the rest of
+// the task with one reference, instead of one captured per continuation.
+template <typename U, typename... P>
+class KeepAliveAwaiter {
+public:
+    explicit KeepAliveAwaiter(SharedPtr<U, P...> owner) : owner_(std::move(owner)) {
+    }
+
+    bool await_ready() const {
+        return false;
+    }
+
+    template <typename T>
+    bool await_suspend(std::coroutine_handle<SharedTaskPromise<T, P...>> handle) {
+        handle.promise().KeepAlive(std::move(owner_));
+        return false;
+    }
+
+    void await_resume() const {
+    }
+
+private:
+    SharedPtr<U, P...> owner_;
+};
+
+template <typename U, typename... P>
+KeepAliveAwaiter<U, P...> KeepAlive(SharedPtr<U, P...> owner) {
+    return KeepAliveAwaiter<U, P...>(std::move(owner));
+}
+
+// Runs scheduled coroutines in FIFO order on the thread that calls Run.
+class LocalExecutor {
+public:
+    auto Schedule() {
+        struct Awaiter {
+            bool await_ready() const {
+                return false;
+            }
+            void await_suspend(std::coroutine_handle<> handle) {
+                executor.Post(handle);
+            }
+            void await_resume() const {
+            }
+
+            LocalExecutor& executor;
+        };
+        return Awaiter{*this};
+    }
+
+    void Post(std::coroutine_handle<> handle) {
+        queue_.push_back(handle);
+    }
+
+    // Until nothing is scheduled; returns the number of resumptions.
+    size_t Run() {
+        size_t resumed = 0;
+        while (!queue_.empty()) {
+            running_.swap(queue_);
+            for (auto handle : running_) {
+                handle.resume();
+            }
+            resumed += running_.size();
+            running_.clear();
+        }
+        return resumed;
+    }
+
+private:
+    std::vector<std::coroutine_handle<>> queue_;
+    std::vector<std::coroutine_handle<>> running_;
+};
@@ -0,0 +1,405 @@
+#include "shared.h"
+#include "weak.h"
+
+#include <common/arena.h>
+#include <common/my_int.h>
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename... Policies>
+struct PolicyList {
+    template <typename T>
+    using Shared = SharedPtr<T, Policies...>;
+
+    template <typename T>
+    using Weak = WeakPtr<T, Policies...>;
+
+    template <typename T, typename... Args>
+    static Shared<T> Make(Args&&... args) {
+        return MakeShared<T, Policies...>(std::forward<Args>(args)...);
+    }
+};
+
+using Default = PolicyList<>;
+using Atomic = PolicyList<AtomicCounting>;
+using Thin = PolicyList<ThinLayout>;
+using AtomicThinPool = PolicyList<PoolAllocation, ThinLayout, AtomicCounting>;
+using Arena = PolicyList<ArenaAllocation>;
+using Lazy = PolicyList<LazyBlock>;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Policy resolution") {
+    using Picked = SharedPolicies<ThinLayout, AtomicCounting>;
+    STATIC_REQUIRE(std::is_same_v<Picked::Counting, AtomicCounting>);
+    STATIC_REQUIRE(std::is_same_v<Picked::Layout, ThinLayout>);
+    STATIC_REQUIRE(std::is_same_v<Picked::Allocation, GlobalAllocation>);
+
+    STATIC_REQUIRE(sizeof(SharedPtr<int>) == 2 * sizeof(void*));
+    STATIC_REQUIRE(sizeof(SharedPtr<int, ThinLayout>) == sizeof(void*));
+    STATIC_REQUIRE(sizeof(WeakPtr<int, ThinLayout>) == sizeof(void*));
+
+    STATIC_REQUIRE(std::is_convertible_v<SharedPtr<int, ThinLayout>, SharedPtr<const int, ThinLayout>>);
+    STATIC_REQUIRE(!std::is_convertible_v<SharedPtr<int, ThinLayout>, SharedPtr<int>>);
+}
+
+TEMPLATE_TEST_CASE("Ownership under every policy", "", Default, Atomic, Thin, AtomicThinPool,
+                   Arena, Lazy) {
+    HugePageArena arena;
+    ArenaScope scope(arena);
+    {
+        auto sp = TestType::template Make<MyInt>(5);
+        REQUIRE(MyInt::AliveCount() == 1);
+        REQUIRE(*sp == 5);
+
+        typename TestType::template Shared<const MyInt> copy = sp;
+        REQUIRE(sp.UseCount() == 2);
+        REQUIRE(copy.Get() == sp.Get());
+
+        typename TestType::template Weak<MyInt> weak(sp);
+        REQUIRE(weak.UseCount() == 2);
+        REQUIRE(weak.Lock().Get() == sp.Get());
+
+        sp.Reset();
+        copy.Reset();
+        REQUIRE(MyInt::AliveCount() == 0);
+        REQUIRE(weak.Expired());
+        REQUIRE(!weak.Lock());
+        REQUIRE_THROWS_AS(typename TestType::template Shared<MyInt>(weak), BadWeakPtr);
+    }
+    {
+        typename TestType::template Shared<MyInt> sp(new MyInt(7));
+        REQUIRE(*sp == 7);
+        sp.Reset(new MyInt(8));
+        REQUIRE(*sp == 8);
+        REQUIRE(MyInt::AliveCount() == 1);
+    }
+    REQUIRE(MyInt::AliveCount() == 0);
+}
+
+namespace {
+
+struct alignas(128) OverAligned {
+    explicit OverAligned(int value) : value(value) {
+    }
+
+    int value;
+};
+
+bool IsAligned(const void* ptr) {
+    return reinterpret_cast<uintptr_t>(ptr) % alignof(OverAligned) == 0;
+}
+
+}  // namespace
+
+TEMPLATE_TEST_CASE("Over-aligned objects under every policy", "", Default, Atomic, Thin,
+                   AtomicThinPool, Arena, Lazy) {
+    HugePageArena arena;
+    ArenaScope scope(arena);
+    std::vector<typename TestType::template Shared<OverAligned>> ptrs;
+    for (int i = 0; i < 64; ++i) {
+        ptrs.push_back(TestType::template Make<OverAligned>(i));
+        ptrs.emplace_back(new OverAligned(i));
+    }
+    for (size_t i = 0; i < ptrs.size(); ++i) {
+        REQUIRE(IsAligned(ptrs[i].Get()));
+        REQUIRE(ptrs[i]->value == static_cast<int>(i / 2));
+    }
+}
+
+TEST_CASE("Arena allocation policy") {
+    HugePageArena arena;
+    arena.Allocate(1);
+    ArenaScope scope(arena);
+    Arena::Shared<std::string> sp;
+    EXPECT_ZERO_ALLOCATIONS(sp = Arena::Make<std::string>("in arena"));
+    REQUIRE(*sp == "in arena");
+    auto copy = sp;
+    REQUIRE(copy.UseCount() == 2);
+}
+
+TEST_CASE("Pool allocation policy") {
+    // Warm the slab and its thread cache up.
+    auto warm = AtomicThinPool::Make<int>(1);
+    AtomicThinPool::Shared<int> sp;
+    EXPECT_ZERO_ALLOCATIONS(sp = AtomicThinPool::Make<int>(2); sp = AtomicThinPool::Make<int>(3));
+    REQUIRE(*sp == 3);
+}
+
+TEMPLATE_TEST_CASE("Control block reuse", "", Default, Thin, AtomicThinPool) {
+    SECTION("Reset") {
+        typename TestType::template Shared<MyInt> sp(new MyInt(1));
+        EXPECT_ONE_ALLOCATION(sp.Reset(new MyInt(2)));
+        REQUIRE(*sp == 2);
+        REQUIRE(MyInt::AliveCount() == 1);
+
+        // A weak reference keeps the old block alive.
+        typename TestType::template Weak<MyInt> weak(sp);
+        sp.Reset(new MyInt(3));
+        REQUIRE(weak.Expired());
+        REQUIRE(*sp == 3);
+    }
+
+    SECTION("Emplace") {
+        auto sp = TestType::template Make<std::string>("first");
+        EXPECT_ZERO_ALLOCATIONS(sp.Emplace(3, 'x'));
+        REQUIRE(*sp == "xxx");
+
+        auto copy = sp;
+        sp.Emplace("second");
+        REQUIRE(*copy == "xxx");
+        REQUIRE(*sp == "second");
+        REQUIRE(sp.UseCount() == 1);
+
+        typename TestType::template Shared<std::string> empty;
+        empty.Emplace("third");
+        REQUIRE(*empty == "third");
+    }
+
+    SECTION("Throwing Emplace") {
+        struct Fragile {
+            Fragile(bool fail) {
+                if (fail) {
+                    throw std::runtime_error("fail");
+                }
+            }
+        };
+        auto sp = TestType::template Make<Fragile>(false);
+        REQUIRE_THROWS_AS(sp.Emplace(true), std::runtime_error);
+        REQUIRE(!sp);
+    }
+    REQUIRE(MyInt::AliveCount() == 0);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct Left {
+    virtual ~Left() = default;
+    int left = 1;
+};
+
+struct Right {
+    virtual ~Right() = default;
+    int right = 2;
+};
+
+struct Both : Left, Right {};
+
+TEST_CASE("Conversions adjust the object pointer") {
+    auto both = MakeShared<Both>();
+    SharedPtr<Right> right = both;
+    REQUIRE(right.Get() == static_cast<Right*>(both.Get()));
+    REQUIRE(right->right == 2);
+
+    SharedPtr<int> alias(both, &both->left);
+    both.Reset();
+    right.Reset();
+    REQUIRE(*alias == 1);
+}
+
+// Single-threaded counting that records every counter operation
+struct RecordingCounting : SingleThreadedCounting {
+    static void Increment(Counter& counter) {
+        ++ops;
+        SingleThreadedCounting::Increment(counter);
+    }
+
+    static size_t Decrement(Counter& counter) {
+        ++ops;
+        return SingleThreadedCounting::Decrement(counter);
+    }
+
+    static inline size_t ops = 0;
+};
+
+TEST_CASE("Lazy control blocks") {
+    SECTION("Sole owners never make one") {
+        {
+            Lazy::Shared<MyInt> sp;
+            EXPECT_ONE_ALLOCATION(sp = Lazy::Shared<MyInt>(new MyInt(1)));
+            REQUIRE(sp.UseCount() == 1);
+            Lazy::Shared<const MyInt> moved;
+            EXPECT_ZERO_ALLOCATIONS(moved = std::move(sp));
+            EXPECT_ONE_ALLOCATION(moved.Reset(new MyInt(2)));
+            REQUIRE(*moved == 2);
+            REQUIRE(MyInt::AliveCount() == 1);
+        }
+        REQUIRE(MyInt::AliveCount() == 0);
+    }
+
+    SECTION("The first copy makes it") {
+        Lazy::Shared<MyInt> sp(new MyInt(3));
+        Lazy::Shared<MyInt> copy;
+        EXPECT_ONE_ALLOCATION(copy = sp);
+        REQUIRE(sp.UseCount() == 2);
+        EXPECT_ZERO_ALLOCATIONS(Lazy::Weak<MyInt> weak(copy));
+        sp.Reset();
+        REQUIRE(*copy == 3);
+    }
+
+    SECTION("Or the first WeakPtr") {
+        const Lazy::Shared<MyInt> sp(new MyInt(4));
+        Lazy::Weak<MyInt> weak;
+        EXPECT_ONE_ALLOCATION(weak = sp);
+        REQUIRE(weak.Lock().Get() == sp.Get());
+    }
+
+    SECTION("Objects are deleted as the type they were created as") {
+        Lazy::Shared<Right> right(new Both);
+        REQUIRE(right->right == 2);
+        Lazy::Shared<Right> copy = right;
+        Lazy::Shared<Left> left(new Both);
+        auto alias = Lazy::Shared<int>(left, &left->left);
+        left.Reset();
+        REQUIRE(*alias == 1);
+    }
+    REQUIRE(MyInt::AliveCount() == 0);
+}
+
+TEST_CASE("Pointer casts") {
+    using Recorded = PolicyList<RecordingCounting>;
+    Recorded::Shared<Left> left = Recorded::Make<Both>();
+
+    SECTION("Copying casts") {
+        auto both = StaticPointerCast<Both>(left);
+        REQUIRE(left.UseCount() == 2);
+        REQUIRE(DynamicPointerCast<Right>(left)->right == 2);
+        REQUIRE(!DynamicPointerCast<Both>(SharedPtr<Left>(new Left)));
+        auto cleft = ConstPointerCast<const Left>(left);
+        REQUIRE(ReinterpretPointerCast<const char>(cleft).Get() == reinterpret_cast<const char*>(left.Get()));
+    }
+
+    SECTION("Moving casts do not touch the counter") {
+        auto ops = RecordingCounting::ops;
+        auto both = StaticPointerCast<Both>(std::move(left));
+        REQUIRE(!left);
+
+        auto failed = DynamicPointerCast<Both>(Recorded::Shared<Left>());
+        auto right = DynamicPointerCast<Right>(std::move(both));
+        REQUIRE(!both);
+        REQUIRE(right->right == 2);
+
+        auto cright = ConstPointerCast<const Right>(std::move(right));
+        auto bytes = ReinterpretPointerCast<const char>(std::move(cright));
+        REQUIRE(!cright);
+        REQUIRE(bytes.UseCount() == 1);
+
+        Recorded::Shared<const Right> aliased(std::move(bytes), static_cast<const Right*>(nullptr));
+        REQUIRE(!bytes);
+        REQUIRE(aliased.UseCount() == 1);
+        REQUIRE(RecordingCounting::ops == ops);
+    }
+}
+
+struct Message {
+    virtual ~Message() = default;
+    int kind = 0;
+};
+struct Request : Message {};
+struct Get : Request {};
+struct Reply : Message {};
+struct Unregistered : Request {};
+
+template <>
+struct ClassIds<Message> : ClassIdRange<1, 4> {};
+template <>
+struct ClassIds<Request> : ClassIdRange<2, 3> {};
+template <>
+struct ClassIds<Get> : ClassIdRange<3, 3> {};
+template <>
+struct ClassIds<Reply> : ClassIdRange<4, 4> {};
+
+TEST_CASE("FastPointerCast") {
+    using Typed = PolicyList<StoreClassIds>;
+
+    Typed::Shared<Message> get = Typed::Make<Get>();
+    REQUIRE(FastPointerCast<Request>(get).Get() == dynamic_cast<Request*>(get.Get()));
+    REQUIRE(FastPointerCast<Get>(get));
+    REQUIRE(!FastPointerCast<Reply>(get));
+    REQUIRE(get.UseCount() == 1);
+
+    Typed::Shared<Message> reply(new Reply);
+    REQUIRE(FastPointerCast<Reply>(reply));
+    REQUIRE(!FastPointerCast<Request>(reply));
+
+    auto moved = FastPointerCast<Request>(std::move(get));
+    REQUIRE(!get);
+    REQUIRE(moved.UseCount() == 1);
+    auto failed = FastPointerCast<Request>(std::move(reply));
+    REQUIRE(!failed);
+    REQUIRE(reply);
+
+    // Objects of unregistered types are not anything.
+    Typed::Shared<Message> unknown = Typed::Make<Unregistered>();
+    REQUIRE(!FastPointerCast<Request>(unknown));
+    REQUIRE(!FastPointerCast<Message>(Typed::Shared<Message>()));
+}
+
+struct Node : EnableSharedFromThis<Node, AtomicCounting, ThinLayout> {
+    int value = 3;
+};
+
+TEST_CASE("EnableSharedFromThis with thin pointers") {
+    auto node = MakeShared<Node, AtomicCounting, ThinLayout>();
+    auto self = node->SharedFromThis();
+    REQUIRE(self.Get() == node.Get());
+    REQUIRE(node.UseCount() == 2);
+
+    const Node& cref = *node;
+    SharedPtr<const Node, AtomicCounting, ThinLayout> cself = cref.SharedFromThis();
+    REQUIRE(cself->value == 3);
+}
+
+TEST_CASE("Atomic counting across threads") {
+    constexpr int kNumThreads = 4;
+    constexpr int kIterations = 20000;
+
+    auto sp = Atomic::Make<MyInt>(1);
+    Atomic::Weak<MyInt> weak(sp);
+    std::atomic<int> failures = 0;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kNumThreads; ++i) {
+        threads.emplace_back([sp, weak, &failures] {
+            for (int j = 0; j < kIterations; ++j) {
+                auto copy = sp;
+                if (!weak.Lock()) {
+                    ++failures;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(failures == 0);
+    REQUIRE(sp.UseCount() == 1);
+
+    // Lock racing with the last release never resurrects the object.
+    std::atomic<bool> go = false;
+    std::thread locker([&] {
+        while (!go) {
+        }
+        while (auto locked = weak.Lock()) {
+            if (!(*locked == 1)) {
+                ++failures;
+            }
+        }
+    });
+    go = true;
+    sp.Reset();
+    locker.join();
+    REQUIRE(failures == 0);
+    REQUIRE(weak.Expired());
+    REQUIRE(MyInt::AliveCount() == 0);
+}
@@ -0,0 +1,88 @@
+#include "batch.h"
+#include "weak.h"
+
+#include <common/arena.h>
+#include <common/my_int.h>
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <stdexcept>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("MakeSharedBatch") {
+    SECTION("One allocation for all elements") {
+        SharedBatch<std::string> batch;
+        EXPECT_ONE_ALLOCATION(batch = MakeSharedBatch<std::string>(
+                                  100, [](size_t i) { return std::string(i % 10, 'a'); }));
+        REQUIRE(batch.Size() == 100);
+        REQUIRE(batch[7] == "aaaaaaa");
+        size_t total = 0;
+        for (const auto& s : batch) {
+            total += s.size();
+        }
+        REQUIRE(total == 450);
+    }
+
+    SECTION("Elements keep the whole batch alive") {
+        SharedPtr<MyInt> element;
+        {
+            auto batch = MakeSharedBatch<MyInt>(5, [](size_t i) { return MyInt(i); });
+            REQUIRE(MyInt::AliveCount() == 5);
+            element = batch.Share(3);
+            REQUIRE(batch.UseCount() == 2);
+        }
+        REQUIRE(MyInt::AliveCount() == 5);
+        REQUIRE(*element == 3);
+        WeakPtr<MyInt> weak(element);
+        element.Reset();
+        REQUIRE(MyInt::AliveCount() == 0);
+        REQUIRE(weak.Expired());
+    }
+
+    SECTION("Default construction and empty batches") {
+        auto batch = MakeSharedBatch<int, AtomicCounting>(3);
+        REQUIRE(batch[0] == 0);
+        REQUIRE(batch.Share(2).UseCount() == 2);
+
+        SharedBatch<int> empty;
+        EXPECT_ZERO_ALLOCATIONS(empty = MakeSharedBatch<int>(0));
+        REQUIRE(empty.Empty());
+    }
+
+    SECTION("Throwing initializer") {
+        auto init = [](size_t i) {
+            if (i == 3) {
+                throw std::runtime_error("bad node");
+            }
+            return MyInt(i);
+        };
+        REQUIRE_THROWS_AS(MakeSharedBatch<MyInt>(5, init), std::runtime_error);
+        REQUIRE(MyInt::AliveCount() == 0);
+    }
+
+    SECTION("Arena allocation") {
+        HugePageArena arena;
+        arena.Allocate(1);
+        ArenaScope scope(arena);
+        using ArenaBatch = SharedBatch<int, ArenaAllocation>;
+        ArenaBatch batch;
+        auto make = [] { return MakeSharedBatch<int, ArenaAllocation>(1000); };
+        EXPECT_ZERO_ALLOCATIONS(batch = make());
+        REQUIRE(batch.Size() == 1000);
+    }
+}
+
+struct Child : EnableSharedFromThis<Child> {
+    int id = 0;
+};
+
+TEST_CASE("MakeSharedBatch with EnableSharedFromThis") {
+    auto batch = MakeSharedBatch<Child>(4);
+    auto self = batch[2].SharedFromThis();
+    REQUIRE(self.Get() == &batch[2]);
+    REQUIRE(batch.UseCount() == 2);
+}
@@ -0,0 +1,231 @@
+#include "heap_graph.h"
+#include "shared.h"
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+int alive = 0;
+
+struct Counted : SimpleRefCounted<Counted> {
+    Counted() {
+        ++alive;
+    }
+    ~Counted() {
+        --alive;
+    }
+    int value = 0;
+};
+
+struct Base : SimpleRefCounted<Base, DefaultDelete> {
+    virtual ~Base() = default;
+};
+
+struct Derived : Base {
+    int value = 7;
+};
+
+struct Watched : WeakRefCounted<Watched> {
+    Watched() {
+        ++alive;
+    }
+    explicit Watched(int v) : value(v) {
+        ++alive;
+    }
+    Watched(const Watched& other) : WeakRefCounted(other), value(other.value) {
+        ++alive;
+    }
+    ~Watched() {
+        --alive;
+    }
+    int value = 0;
+};
+
+struct AtomicWatched : WeakRefCounted<AtomicWatched, AtomicCounting> {
+    int value = 0;
+};
+
+using CountedPtr = SharedPtr<Counted, EmbeddedCounting>;
+
+// Naming SharedPtr<T> must not complete a type that is being defined.
+template <typename T>
+struct Outer {
+    struct Inner : EnableSharedFromThis<Inner> {
+        T value{};
+    };
+};
+
+template <typename T>
+struct ListNode {
+    T value{};
+    SharedPtr<ListNode> next;
+};
+
+template <typename T>
+struct Chain : SimpleRefCounted<Chain<T>> {
+    T value{};
+    SharedPtr<Chain, EmbeddedCounting> next;
+};
+
+// The layout does not depend on where SharedPtr<Node> is first named.
+struct Node : SimpleRefCounted<Node> {
+    SharedPtr<Node> next;
+};
+static_assert(sizeof(SharedPtr<Node>) == 2 * sizeof(void*));
+
+}  // namespace
+
+TEST_CASE("SharedPtr to RefCounted objects") {
+    SECTION("Embedded counter") {
+        STATIC_REQUIRE(sizeof(CountedPtr) == sizeof(void*));
+        STATIC_REQUIRE(sizeof(SharedPtr<const Counted, EmbeddedCounting>) == sizeof(void*));
+        {
+            CountedPtr a;
+            EXPECT_ONE_ALLOCATION(a = CountedPtr(new Counted));
+            REQUIRE(a.UseCount() == 1);
+
+            CountedPtr b;
+            EXPECT_ZERO_ALLOCATIONS(b = a);
+            REQUIRE(a->RefCount() == 2);
+
+            // The same count is seen by intrusive pointers.
+            IntrusivePtr<Counted> c = b.AsIntrusive();
+            REQUIRE(a.UseCount() == 3);
+            SharedPtr<const Counted, EmbeddedCounting> d(std::move(b));
+            REQUIRE(d.UseCount() == 3);
+            REQUIRE(d.Get() == c.Get());
+        }
+        REQUIRE(alive == 0);
+    }
+
+    SECTION("Without the policy the pointer has a control block") {
+        auto a = MakeShared<Counted>();
+        STATIC_REQUIRE(sizeof(a) == 2 * sizeof(void*));
+        REQUIRE(a.UseCount() == 1);
+        REQUIRE(a->RefCount() == 0);
+        WeakPtr<Counted> weak = a;
+        a.Reset();
+        REQUIRE(weak.Expired());
+        REQUIRE(alive == 0);
+    }
+
+    SECTION("MakeShared") {
+        CountedPtr a;
+        EXPECT_ONE_ALLOCATION((a = MakeShared<Counted, EmbeddedCounting>()));
+        REQUIRE(a->RefCount() == 1);
+        a.Reset();
+        REQUIRE(alive == 0);
+    }
+
+    SECTION("MakeIntrusive and conversions") {
+        SharedPtr<Derived, EmbeddedCounting> derived(MakeIntrusive<Derived>());
+        SharedPtr<Base, EmbeddedCounting> base = derived;
+        REQUIRE(base.UseCount() == 2);
+        REQUIRE(static_cast<Derived*>(base.Get())->value == 7);
+        derived.Reset();
+        REQUIRE(base.UseCount() == 1);
+    }
+
+    SECTION("Heap graph") {
+        CountedPtr a(new Counted);
+        REQUIRE(RetainedSize(a) == sizeof(Counted));
+    }
+
+    SECTION("Nested classes of templates derive from EnableSharedFromThis") {
+        auto inner = MakeShared<Outer<int>::Inner>();
+        REQUIRE(inner->SharedFromThis().UseCount() == 2);
+        REQUIRE(inner->WeakFromThis().Lock().Get() == inner.Get());
+    }
+
+    SECTION("Class templates hold pointers to themselves") {
+        auto list = MakeShared<ListNode<int>>();
+        list->next = MakeShared<ListNode<int>>();
+        REQUIRE(list->next.UseCount() == 1);
+
+        auto chain = MakeShared<Chain<int>, EmbeddedCounting>();
+        STATIC_REQUIRE(sizeof(chain->next) == sizeof(void*));
+        chain->next = MakeShared<Chain<int>, EmbeddedCounting>();
+        REQUIRE(chain->next->RefCount() == 1);
+    }
+}
+
+TEST_CASE("WeakRefCounted") {
+    SECTION("MakeShared allocates once") {
+        SharedPtr<Watched> a;
+        EXPECT_ONE_ALLOCATION(a = MakeShared<Watched>(5));
+        WeakPtr<Watched> weak = a;
+        REQUIRE(a->RefCount() == 1);
+
+        // Raw pointers find the block they live in.
+        SharedPtr<Watched> b;
+        EXPECT_ZERO_ALLOCATIONS(b = SharedPtr<Watched>(a.Get()));
+        IntrusivePtr<Watched> c(a.Get());
+        REQUIRE(a.UseCount() == 3);
+
+        a.Reset();
+        b.Reset();
+        REQUIRE(!weak.Expired());
+        REQUIRE(weak.Lock()->value == 5);
+        c.Reset();
+        REQUIRE(weak.Expired());
+        REQUIRE(alive == 0);
+    }
+
+    SECTION("MakeIntrusive allocates once") {
+        IntrusivePtr<Watched> a;
+        EXPECT_ONE_ALLOCATION(a = MakeIntrusive<Watched>(3));
+        REQUIRE(a->RefCount() == 1);
+
+        SharedPtr<Watched> shared(a.Get());
+        WeakPtr<Watched> weak = shared;
+        REQUIRE(shared.UseCount() == 2);
+        shared.Reset();
+        a.Reset();
+        REQUIRE(weak.Expired());
+        REQUIRE(alive == 0);
+    }
+
+    SECTION("Objects created by new get a block on the first reference") {
+        auto* raw = new Watched;
+        REQUIRE(raw->RefCount() == 0);
+        IntrusivePtr<Watched> a(raw);
+        REQUIRE(a->RefCount() == 1);
+        WeakPtr<Watched> weak = SharedPtr<Watched>(raw);
+        REQUIRE(a->RefCount() == 1);
+        REQUIRE(weak.Lock().Get() == raw);
+        a.Reset();
+        REQUIRE(weak.Expired());
+        REQUIRE(alive == 0);
+    }
+
+    SECTION("Copies are separate objects") {
+        auto a = MakeShared<Watched>(1);
+        {
+            auto b = MakeShared<Watched>(*a);
+            REQUIRE(b.UseCount() == 1);
+            REQUIRE(SharedPtr<Watched>(b.Get()).UseCount() == 2);
+        }
+        REQUIRE(a.UseCount() == 1);
+    }
+
+    SECTION("Emplace relinks the rebuilt object") {
+        auto a = MakeShared<Watched>(1);
+        a.Emplace(2);
+        IntrusivePtr<Watched> b(a.Get());
+        REQUIRE(a.UseCount() == 2);
+        REQUIRE(b->value == 2);
+    }
+
+    SECTION("Other policies") {
+        auto a = MakeShared<AtomicWatched, AtomicCounting>();
+        WeakPtr<AtomicWatched, AtomicCounting> weak = a;
+        IntrusivePtr<AtomicWatched> b(a.Get());
+        a.Reset();
+        REQUIRE(weak.Lock().Get() == b.Get());
+    }
+    REQUIRE(alive == 0);
+}
@@ -0,0 +1,75 @@
+#include "external.h"
+
+#include <common/c_handle.h>
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <type_traits>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+using HandleTraits = ExternalRefTraits<&c_handle_ref, &c_handle_unref, &c_handle_refcount>;
+using Handle = SharedPtr<c_handle, ExternalCounting<HandleTraits>>;
+
+template <typename Ptr>
+concept ResetsFromRaw = requires(Ptr ptr, c_handle* raw) { ptr.Reset(raw); };
+
+}  // namespace
+
+TEST_CASE("ExternalCounting") {
+    SECTION("No control block") {
+        STATIC_REQUIRE(sizeof(Handle) == sizeof(void*));
+        Handle handle;
+        EXPECT_ONE_ALLOCATION(handle = Handle(c_handle_new(16), kAdoptRef));
+        REQUIRE(handle.UseCount() == 1);
+        REQUIRE(handle->value == 16);
+    }
+
+    SECTION("Copies call the library") {
+        {
+            Handle a(AdoptIntrusive<HandleTraits>(c_handle_new(8)));
+            REQUIRE(a->refs == 1);
+            Handle b;
+            EXPECT_ZERO_ALLOCATIONS(b = a);
+            REQUIRE(a->refs == 2);
+            REQUIRE(b.UseCount() == 2);
+
+            SharedPtr<const c_handle, ExternalCounting<HandleTraits>> c(std::move(b));
+            REQUIRE(!b);
+            REQUIRE(c.UseCount() == 2);
+            REQUIRE(c == a);
+            REQUIRE(c.AsIntrusive().Get() == a.Get());
+
+            a.Reset();
+            REQUIRE(c.UseCount() == 1);
+            REQUIRE(c_handles_alive == 1);
+        }
+        REQUIRE(c_handles_alive == 0);
+    }
+
+    SECTION("Sharing a handle the caller keeps") {
+        c_handle* raw = c_handle_new(4);
+        {
+            Handle handle(raw, kRetainRef);
+            REQUIRE(raw->refs == 2);
+        }
+        c_handle_unref(raw);
+        REQUIRE(c_handles_alive == 0);
+    }
+
+    SECTION("Raw handles state who owns the reference") {
+        STATIC_REQUIRE(!std::is_constructible_v<Handle, c_handle*>);
+        STATIC_REQUIRE(std::is_constructible_v<Handle, c_handle*, AdoptRef>);
+        STATIC_REQUIRE(std::is_constructible_v<Handle, c_handle*, RetainRef>);
+        STATIC_REQUIRE(!ResetsFromRaw<Handle>);
+        {
+            Handle handle(c_handle_new(2), kAdoptRef);
+            REQUIRE(handle.UseCount() == 1);
+        }
+        REQUIRE(c_handles_alive == 0);
+    }
+}
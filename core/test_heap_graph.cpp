@@ -0,0 +1,173 @@
+#include "heap_graph.h"
+
+#include <catch.hpp>
+
+#include <cstdio>
+#include <map>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Tree {
+    std::vector<SharedPtr<Tree>> children;
+    WeakPtr<Tree> parent;
+};
+
+struct Ring : SimpleRefCounted<Ring> {
+    IntrusivePtr<Ring> next;
+    char payload[100] = {};
+};
+
+size_t Shallow(const SharedPtr<Tree>& tree) {
+    return sizeof(Tree) + sizeof(SharedControlBlock<>) + tree->children.capacity() * sizeof(SharedPtr<Tree>);
+}
+
+SharedPtr<Tree> Child(const SharedPtr<Tree>& parent) {
+    auto child = MakeShared<Tree>();
+    child->parent = parent;
+    parent->children.push_back(child);
+    return child;
+}
+
+}  // namespace
+
+template <>
+struct HeapTraits<Tree> {
+    template <typename Visitor>
+    static void ForEachChild(const Tree& tree, Visitor& visit) {
+        for (const auto& child : tree.children) {
+            visit(child);
+        }
+        visit(tree.parent);
+    }
+
+    static size_t ExtraBytes(const Tree& tree) {
+        return tree.children.capacity() * sizeof(SharedPtr<Tree>);
+    }
+};
+
+template <>
+struct HeapTraits<Ring> {
+    template <typename Visitor>
+    static void ForEachChild(const Ring& ring, Visitor& visit) {
+        visit(ring.next);
+    }
+};
+
+TEST_CASE("RetainedSize") {
+    // a -> b, c; b -> d; c -> d; d -> e
+    auto a = MakeShared<Tree>();
+    auto b = Child(a);
+    auto c = Child(a);
+    auto d = Child(b);
+    c->children.push_back(d);
+    auto e = Child(d);
+    auto shallow = [](const std::vector<SharedPtr<Tree>>& trees) {
+        size_t sum = 0;
+        for (const auto& tree : trees) {
+            sum += Shallow(tree);
+        }
+        return sum;
+    };
+
+    SECTION("Objects held from outside are not retained by their parents") {
+        REQUIRE(RetainedSize(a) == Shallow(a));
+        REQUIRE(RetainedSize(SharedPtr<Tree>()) == 0);
+    }
+
+    SECTION("Shared children are retained by the common dominator") {
+        size_t total = shallow({a, b, c, d, e});
+        size_t d_and_e = shallow({d, e});
+        b.Reset();
+        c.Reset();
+        d.Reset();
+        e.Reset();
+        REQUIRE(RetainedSize(a) == total);
+
+        HeapGraph graph;
+        size_t root = graph.AddRoot(a, "tree");
+        const auto& nodes = graph.Nodes();
+        REQUIRE(nodes.size() == 6);
+        REQUIRE(nodes[root].dominator == 0);
+        REQUIRE(nodes[root].name == "tree");
+        REQUIRE(nodes[root].retained == total);
+        size_t retaining = 0;
+        for (size_t i = 1; i < nodes.size(); ++i) {
+            if (i != root && nodes[i].retained > nodes[i].shallow) {
+                // Only d retains something besides itself, and a dominates it.
+                REQUIRE(nodes[i].retained == d_and_e);
+                REQUIRE(nodes[i].dominator == root);
+                ++retaining;
+            }
+        }
+        REQUIRE(retaining == 1);
+    }
+
+    SECTION("Report and dump") {
+        HeapGraph graph;
+        graph.AddRoot(a, "a");
+        auto largest = graph.LargestRetainers(2);
+        REQUIRE(largest.size() == 2);
+        REQUIRE(graph.Nodes()[largest[0]].retained >= graph.Nodes()[largest[1]].retained);
+
+        std::string report = graph.Report(3);
+        REQUIRE(report.find("Tree") != std::string::npos);
+        REQUIRE(report.find("(a)") != std::string::npos);
+
+        std::string dump = graph.Dump();
+        REQUIRE(dump.find("node 1 ") != std::string::npos);
+        REQUIRE(dump.find("edge 1 2") != std::string::npos);
+    }
+}
+
+TEST_CASE("Dump keeps long and spaced type names") {
+    using Long = std::map<std::string, std::vector<std::pair<std::string, std::map<int, std::string>>>>;
+    using Wide = std::tuple<Long, Long, Long>;
+    auto wide = MakeShared<Wide>();
+    auto number = MakeShared<unsigned int>(7u);
+
+    HeapGraph graph;
+    graph.AddRoot(wide);
+    graph.AddRoot(number);
+    std::string dump = graph.Dump();
+
+    std::vector<std::string> types;
+    std::istringstream lines(dump);
+    for (std::string line; std::getline(lines, line);) {
+        size_t index = 0;
+        void* address = nullptr;
+        size_t shallow = 0;
+        size_t retained = 0;
+        size_t dominator = 0;
+        int type = 0;
+        REQUIRE(std::sscanf(line.c_str(), "node %zu %p %zu %zu %zu %n", &index, &address, &shallow, &retained,
+                            &dominator, &type) == 5);
+        REQUIRE(shallow > 0);
+        types.push_back(line.substr(type));
+    }
+    REQUIRE(types.size() == 2);
+    REQUIRE(types[0].size() > 512);
+    REQUIRE(types[0].find("std::tuple<") == 0);
+    REQUIRE(types[0].back() == '>');
+    REQUIRE(types[1] == "unsigned int");
+}
+
+TEST_CASE("RetainedSize of intrusive cycles") {
+    auto x = MakeIntrusive<Ring>();
+    x->next = MakeIntrusive<Ring>();
+    x->next->next = MakeIntrusive<Ring>();
+    x->next->next->next = x;
+
+    REQUIRE(RetainedSize(x) == 3 * sizeof(Ring));
+    auto y = x->next;
+    REQUIRE(RetainedSize(x) == sizeof(Ring));
+    REQUIRE(RetainedSize(y) == 2 * sizeof(Ring));
+
+    x->next.Reset();
+}
@@ -0,0 +1,113 @@
+#include "lru_cache.h"
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// One shard, so the eviction order is fully visible.
+using Cache = ShardedLruCache<int, std::string>;
+
+TEST_CASE("ShardedLruCache") {
+    SECTION("Hits and misses") {
+        Cache cache(4, 1);
+        REQUIRE(!cache.Get(1));
+        cache.Emplace(1, "one");
+        cache.Put(2, MakeShared<std::string, AtomicCounting>("two"));
+        REQUIRE(*cache.Get(1) == "one");
+        REQUIRE(*cache.Get(2) == "two");
+
+        cache.Emplace(2, "deux");
+        REQUIRE(*cache.Get(2) == "deux");
+        REQUIRE(cache.Size() == 2);
+
+        REQUIRE(cache.Erase(1));
+        REQUIRE(!cache.Erase(1));
+        REQUIRE(!cache.Get(1));
+    }
+
+    SECTION("Evicts the least recently used") {
+        Cache cache(3, 1);
+        for (int key = 0; key < 3; ++key) {
+            cache.Emplace(key, std::to_string(key));
+        }
+        cache.Get(0);
+        cache.Emplace(3, "3");
+        REQUIRE(cache.Size() == 3);
+        REQUIRE(cache.Get(0));
+        REQUIRE(!cache.Get(1));
+        REQUIRE(cache.Get(2));
+        REQUIRE(cache.Get(3));
+    }
+
+    SECTION("Referenced values pin their entries") {
+        Cache cache(2, 1);
+        auto pinned = cache.Emplace(0, "zero");
+        cache.Emplace(1, "one");
+        cache.Emplace(2, "two");
+        REQUIRE(cache.Get(0) == pinned);
+        REQUIRE(!cache.Get(1));
+
+        // Once everything is pinned the shard overflows instead of dropping values in use.
+        auto a = cache.Emplace(3, "three");
+        REQUIRE(!cache.Get(2));
+        auto b = cache.Emplace(4, "four");
+        REQUIRE(cache.Size() == 3);
+
+        pinned.Reset();
+        a.Reset();
+        b.Reset();
+        cache.Emplace(5, "five");
+        REQUIRE(cache.Size() == 2);
+        REQUIRE(cache.Get(5));
+    }
+
+    SECTION("Values outlive eviction") {
+        Cache cache(1, 1);
+        auto value = cache.Emplace(0, "zero");
+        WeakPtr<const std::string, AtomicCounting> weak(value);
+        cache.Emplace(1, "one");
+        value.Reset();
+        cache.Emplace(2, "two");
+        REQUIRE(weak.Expired());
+    }
+
+    SECTION("Shards split the capacity") {
+        ShardedLruCache<int, int> cache(100, 6);
+        REQUIRE(cache.Capacity() == 104);
+        for (int key = 0; key < 10'000; ++key) {
+            cache.Emplace(key, key);
+        }
+        REQUIRE(cache.Size() <= cache.Capacity());
+        REQUIRE(*cache.Get(9'999) == 9'999);
+    }
+
+    SECTION("Concurrent gets and puts") {
+        constexpr int kThreads = 4;
+        constexpr int kKeys = 256;
+        ShardedLruCache<int, int> cache(kKeys / 2, 4);
+        std::atomic<int> failures = 0;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&, t] {
+                for (int i = 0; i < 20'000; ++i) {
+                    int key = (i * 7 + t) % kKeys;
+                    if (auto value = cache.Get(key)) {
+                        failures += *value != key;
+                    } else {
+                        cache.Emplace(key, key);
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        REQUIRE(failures == 0);
+        REQUIRE(cache.Size() <= cache.Capacity());
+    }
+}
@@ -0,0 +1,112 @@
+#include "scoped.h"
+
+#include <common/my_int.h>
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+size_t Callee(SharedPtr<const MyInt> value, WeakPtr<MyInt> weak) {
+    SharedPtr<const MyInt> copy = value;
+    auto locked = weak.Lock();
+    return *locked == 20 ? copy.UseCount() : 0;
+}
+
+struct Session : EnableSharedFromThis<Session> {
+    int requests = 0;
+};
+
+// Counts the slow-release reports instead of printing them
+struct QuickTimeout {
+    static constexpr std::chrono::milliseconds kEscapeTimeout{5};
+
+    static void SlowRelease(const char*) {
+        ++slow_releases;
+    }
+
+    static inline int slow_releases = 0;
+};
+
+}  // namespace
+
+TEST_CASE("ScopedShared") {
+    SECTION("Sharing without allocations") {
+        EXPECT_ZERO_ALLOCATIONS({
+            ScopedShared<MyInt> value(20);
+            REQUIRE(Callee(value.Share(), value.Weak()) == 4);
+            REQUIRE(value.UseCount() == 0);
+            REQUIRE(MyInt::AliveCount() == 1);
+        });
+        REQUIRE(MyInt::AliveCount() == 0);
+    }
+
+    SECTION("Weak references see the object while the scope lives") {
+        WeakPtr<MyInt> inner;
+        {
+            ScopedShared<MyInt> value(5);
+            auto shared = value.Share();
+            REQUIRE(value.UseCount() == 1);
+            REQUIRE(*value == 5);
+            REQUIRE(shared.Get() == value.Get());
+            inner = value.Weak();
+            REQUIRE(inner.Lock().Get() == value.Get());
+            inner.Reset();
+        }
+        REQUIRE(MyInt::AliveCount() == 0);
+    }
+
+    SECTION("EnableSharedFromThis and thin pointers") {
+        ScopedShared<Session> session;
+        REQUIRE(session->SharedFromThis().Get() == session.Get());
+
+        ScopedShared<MyInt, ThinLayout> thin(3);
+        SharedPtr<MyInt, ThinLayout> shared = thin.Share();
+        REQUIRE(*shared == 3);
+    }
+
+    SECTION("Waits for other threads to drop their references") {
+        std::atomic<bool> released = false;
+        std::thread worker;
+        {
+            ScopedShared<MyInt, AtomicCounting> value(1);
+            worker = std::thread([ptr = value.Share(), weak = value.Weak(), &released]() mutable {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                ptr.Reset();
+                weak.Reset();
+                released = true;
+            });
+        }
+        REQUIRE(released);
+        REQUIRE(MyInt::AliveCount() == 0);
+        worker.join();
+    }
+
+    SECTION("Slow threads are waited for past the escape timeout") {
+        std::atomic<bool> released = false;
+        std::thread worker;
+        QuickTimeout::slow_releases = 0;
+        {
+            BasicScopedShared<MyInt, QuickTimeout, AtomicCounting> value(1);
+            worker = std::thread([ptr = value.Share(), &released]() mutable {
+                std::this_thread::sleep_for(QuickTimeout::kEscapeTimeout * 4);
+                ptr.Reset();
+                released = true;
+            });
+        }
+        REQUIRE(released);
+#ifdef NDEBUG
+        REQUIRE(QuickTimeout::slow_releases == 0);
+#else
+        REQUIRE(QuickTimeout::slow_releases == 1);
+#endif
+        worker.join();
+    }
+}
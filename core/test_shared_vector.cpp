@@ -0,0 +1,166 @@
+#include "batch.h"
+#include "shared_vector.h"
+
+#include <common/my_int.h>
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <stdexcept>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+std::vector<int> Values(const SharedPtrVector<int>& vector) {
+    std::vector<int> values;
+    for (int* value : vector) {
+        values.push_back(value ? *value : -1);
+    }
+    return values;
+}
+
+}  // namespace
+
+TEST_CASE("SharedPtrVector") {
+    SECTION("Holds references like a vector of SharedPtr") {
+        auto shared = MakeShared<MyInt>(1);
+        {
+            SharedPtrVector<MyInt> vector;
+            vector.PushBack(shared);
+            vector.PushBack(shared);
+            vector.EmplaceBack(2);
+            REQUIRE(vector.Size() == 3);
+            REQUIRE(shared.UseCount() == 3);
+            REQUIRE(vector[0] == shared.Get());
+            REQUIRE(*vector.Back() == 2);
+
+            auto copy = vector;
+            REQUIRE(shared.UseCount() == 5);
+            SharedPtrVector<MyInt> moved(std::move(copy));
+            REQUIRE(copy.Empty());
+            REQUIRE(shared.UseCount() == 5);
+
+            SharedPtr<MyInt> last = moved.PopBack();
+            REQUIRE(last.UseCount() == 2);
+            REQUIRE(moved.Share(1).UseCount() == 6);
+            REQUIRE(MyInt::AliveCount() == 2);
+        }
+        REQUIRE(shared.UseCount() == 1);
+        REQUIRE(MyInt::AliveCount() == 1);
+    }
+
+    SECTION("Clear drops runs of one block at once") {
+        auto batch = MakeSharedBatch<MyInt>(4, [](size_t i) { return MyInt(i); });
+        SharedPtrVector<MyInt, AtomicCounting> other;
+        {
+            SharedPtrVector<MyInt> vector;
+            for (size_t i = 0; i < 4; ++i) {
+                vector.PushBack(batch.Share(i));
+            }
+            vector.PushBack(MakeShared<MyInt>(4));
+            vector.PushBack(batch.Share(0));
+            REQUIRE(batch.UseCount() == 6);
+            EXPECT_ZERO_ALLOCATIONS(vector.Clear());
+            REQUIRE(vector.Empty());
+            REQUIRE(batch.UseCount() == 1);
+            REQUIRE(MyInt::AliveCount() == 4);
+        }
+
+        auto shared = MakeShared<MyInt, AtomicCounting>(5);
+        for (int i = 0; i < 10; ++i) {
+            other.PushBack(shared);
+        }
+        other.Clear();
+        REQUIRE(shared.UseCount() == 1);
+    }
+
+    SECTION("Holes and EraseNull") {
+        SharedPtrVector<int> vector;
+        for (int i = 0; i < 37; ++i) {
+            vector.EmplaceBack(i);
+        }
+        REQUIRE(vector.FindNull() == 37);
+        for (size_t hole : {0, 3, 4, 5, 17, 18, 31, 36}) {
+            vector.Reset(hole);
+        }
+        REQUIRE(vector.Size() == 37);
+        REQUIRE(vector.FindNull() == 0);
+        REQUIRE(vector.FindNull(1) == 3);
+        REQUIRE(vector.FindNull(6) == 17);
+        REQUIRE(vector.FindNull(19) == 31);
+        REQUIRE(vector.FindNull(32) == 36);
+
+        REQUIRE(vector.EraseNull() == 8);
+        std::vector<int> expected;
+        for (int i = 0; i < 37; ++i) {
+            if (i != 0 && i != 3 && i != 4 && i != 5 && i != 17 && i != 18 && i != 31 && i != 36) {
+                expected.push_back(i);
+            }
+        }
+        REQUIRE(Values(vector) == expected);
+        REQUIRE(vector.EraseNull() == 0);
+
+        // An alias of null still owns its object.
+        auto owner = MakeShared<MyInt>(1);
+        SharedPtrVector<MyInt> aliases;
+        aliases.PushBack(SharedPtr<MyInt>(owner, nullptr));
+        aliases.PushBack(owner);
+        owner.Reset();
+        REQUIRE(aliases.EraseNull() == 1);
+        REQUIRE(aliases.Share(0).UseCount() == 2);
+        aliases.Clear();
+        REQUIRE(MyInt::AliveCount() == 0);
+    }
+
+    SECTION("EraseIf keeps the order of the rest") {
+        SharedPtrVector<int> vector;
+        for (int i = 0; i < 20; ++i) {
+            vector.EmplaceBack(i);
+        }
+        auto kept = vector.Share(1);
+        vector.Reset(2);
+        REQUIRE(vector.EraseIf([](int* value) { return !value || *value % 3 == 0; }) == 8);
+        REQUIRE(Values(vector) == std::vector<int>{1, 4, 5, 7, 8, 10, 11, 13, 14, 16, 17, 19});
+        REQUIRE(kept.UseCount() == 2);
+
+        vector.Erase(0);
+        REQUIRE(kept.UseCount() == 1);
+        REQUIRE(*vector.Front() == 4);
+        auto previous = vector.Exchange(0, kept);
+        REQUIRE(*previous == 4);
+        REQUIRE(*vector[0] == 1);
+    }
+
+    SECTION("A throwing predicate leaves whole elements") {
+        SharedPtrVector<MyInt> vector;
+        for (int i = 0; i < 10; ++i) {
+            vector.EmplaceBack(i);
+        }
+        int calls = 0;
+        REQUIRE_THROWS_AS(vector.EraseIf([&calls](MyInt*) {
+            if (++calls == 5) {
+                throw std::runtime_error("predicate");
+            }
+            return calls % 2 == 0;
+        }),
+                          std::runtime_error);
+        REQUIRE(vector.Size() == 10);
+        for (MyInt* value : vector) {
+            REQUIRE(value);
+        }
+        vector.Clear();
+        REQUIRE(MyInt::AliveCount() == 0);
+    }
+
+    SECTION("Pointers without a block get one") {
+        SharedPtrVector<MyInt, LazyBlock> vector;
+        SharedPtr<MyInt, LazyBlock> lazy(new MyInt(3));
+        vector.PushBack(std::move(lazy));
+        REQUIRE(vector.Share(0).UseCount() == 2);
+        vector.Clear();
+        REQUIRE(MyInt::AliveCount() == 0);
+    }
+}
@@ -0,0 +1,148 @@
+#include "task.h"
+
+#include <common/my_int.h>
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <stdexcept>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+SharedTask<int> Add(LocalExecutor& executor, int a, int b) {
+    co_await executor.Schedule();
+    co_return a + b;
+}
+
+SharedTask<int> Sum(LocalExecutor& executor, int n) {
+    int sum = 0;
+    for (int i = 1; i <= n; ++i) {
+        sum = co_await Add(executor, sum, i);
+    }
+    co_return sum;
+}
+
+SharedTask<> Fail(LocalExecutor& executor) {
+    co_await executor.Schedule();
+    throw std::runtime_error("failed");
+}
+
+SharedTask<int> Twice(SharedTask<int> task) {
+    int first = co_await task;
+    int second = co_await task;
+    co_return first + second;
+}
+
+class Connection : public EnableSharedFromThis<Connection> {
+public:
+    SharedTask<int> Serve(LocalExecutor& executor, int requests) {
+        auto weak = WeakFromThis();
+        MyInt local(0);
+        for (int i = 0; i < requests; ++i) {
+            co_await executor.Schedule();
+            auto self = co_await IfAlive(weak);
+            ++self->served;
+        }
+        co_return served;
+    }
+
+    SharedTask<> Linger(LocalExecutor& executor) {
+        co_await KeepAlive(SharedFromThis());
+        co_await executor.Schedule();
+        ++served;
+    }
+
+    int served = 0;
+};
+
+}  // namespace
+
+TEST_CASE("SharedTask") {
+    LocalExecutor executor;
+
+    SECTION("Chained steps") {
+        auto task = Sum(executor, 10);
+        REQUIRE(!task.Done());
+        REQUIRE(executor.Run() == 10);
+        REQUIRE(task.Done());
+        REQUIRE(task.Result() == 55);
+    }
+
+    SECTION("Exceptions reach the awaiter") {
+        auto task = Fail(executor);
+        executor.Run();
+        REQUIRE_THROWS_AS(task.Result(), std::runtime_error);
+    }
+
+    SECTION("Several awaiters share one result") {
+        auto shared = Add(executor, 2, 3);
+        auto a = Twice(shared);
+        auto b = Twice(shared);
+        executor.Run();
+        REQUIRE(a.Result() == 10);
+        REQUIRE(b.Result() == 10);
+    }
+
+    SECTION("Running tasks keep themselves alive") {
+        WeakPtr<SharedTask<int>::promise_type> weak;
+        {
+            auto task = Add(executor, 1, 1);
+            weak = task.Weak();
+            REQUIRE(task.UseCount() == 2);
+        }
+        REQUIRE(!weak.Expired());
+        executor.Run();
+        REQUIRE(weak.Expired());
+    }
+
+    SECTION("Frames come from the pool") {
+        Sum(executor, 2);
+        executor.Run();
+        EXPECT_ZERO_ALLOCATIONS({
+            auto task = Sum(executor, 2);
+            executor.Run();
+            REQUIRE(task.Result() == 3);
+        });
+    }
+}
+
+TEST_CASE("IfAlive and KeepAlive") {
+    LocalExecutor executor;
+
+    SECTION("Live owners are handed back") {
+        auto connection = MakeShared<Connection>();
+        auto task = connection->Serve(executor, 3);
+        executor.Run();
+        REQUIRE(task.Result() == 3);
+    }
+
+    SECTION("The task is cancelled once the owner is gone") {
+        auto connection = MakeShared<Connection>();
+        auto task = connection->Serve(executor, 3);
+        auto waiter = Twice(task);
+        connection.Reset();
+        executor.Run();
+        REQUIRE(task.Cancelled());
+        REQUIRE_THROWS_AS(task.Result(), TaskCancelled);
+        REQUIRE_THROWS_AS(waiter.Result(), TaskCancelled);
+
+        // Locals go with the frame.
+        REQUIRE(MyInt::AliveCount() == 1);
+        task = {};
+        waiter = {};
+        REQUIRE(MyInt::AliveCount() == 0);
+    }
+
+    SECTION("KeepAlive holds the owner until the task ends") {
+        auto connection = MakeShared<Connection>();
+        WeakPtr<Connection> weak = connection;
+        connection->Linger(executor);
+        connection.Reset();
+        REQUIRE(!weak.Expired());
+        executor.Run();
+        REQUIRE(weak.Expired());
+    }
+}
@@ -0,0 +1,91 @@
+#include "weak_set.h"
+
+#include <common/my_int.h>
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("WeakPtrSet") {
+    SECTION("Holds weak references") {
+        auto first = MakeShared<MyInt>(1);
+        auto second = MakeShared<MyInt>(2);
+        {
+            WeakPtrSet<MyInt> set;
+            set.Insert(first);
+            set.Insert(WeakPtr<MyInt>(second));
+            set.Insert(first);
+            set.Insert(SharedPtr<MyInt>());
+            REQUIRE(set.Size() == 3);
+            REQUIRE(first.UseCount() == 1);
+            REQUIRE(*set.Lock(1) == 2);
+            REQUIRE(set[2].Lock() == first);
+
+            auto copy = set;
+            second.Reset();
+            REQUIRE(MyInt::AliveCount() == 1);
+            REQUIRE(set[1].Expired());
+            REQUIRE(!copy.Lock(1));
+        }
+        REQUIRE(first.UseCount() == 1);
+    }
+
+    SECTION("Sweeps in bulk") {
+        std::vector<SharedPtr<MyInt>> owners;
+        WeakPtrSet<MyInt> set;
+        for (int i = 0; i < 30; ++i) {
+            owners.push_back(MakeShared<MyInt>(i));
+            set.Insert(owners.back());
+        }
+        auto extra = owners[4];
+        for (int i = 0; i < 30; i += 3) {
+            owners[i].Reset();
+        }
+        REQUIRE(MyInt::AliveCount() == 20);
+
+        std::vector<size_t> counts(set.Size());
+        REQUIRE(set.UseCounts(counts.data()) == 20);
+        REQUIRE(counts[0] == 0);
+        REQUIRE(counts[1] == 1);
+        REQUIRE(counts[4] == 2);
+
+        std::vector<SharedPtr<MyInt>> locked(set.Size(), MakeShared<MyInt>(-1));
+        REQUIRE(set.LockAll(locked.data()) == 20);
+        REQUIRE(*locked[0] == 1);
+        REQUIRE(*locked[19] == 29);
+        REQUIRE(*locked[20] == -1);
+        REQUIRE(extra.UseCount() == 3);
+        locked.clear();
+
+        REQUIRE(set.EraseExpired() == 10);
+        REQUIRE(set.Size() == 20);
+        for (size_t i = 0; i < set.Size(); ++i) {
+            REQUIRE(*set.Lock(i) == static_cast<int>(i + i / 2 + 1));
+        }
+        REQUIRE(set.EraseExpired() == 0);
+
+        std::vector<SharedPtr<MyInt>> buffer(set.Size());
+        EXPECT_ZERO_ALLOCATIONS(set.LockAll(buffer.data()));
+        EXPECT_ZERO_ALLOCATIONS(set.EraseExpired());
+    }
+
+    SECTION("Blocks of expired objects are freed with the last entry") {
+        WeakPtrSet<MyInt> set;
+        size_t deallocs = 0;
+        {
+            auto ptr = MakeShared<MyInt>(1);
+            set.Insert(ptr);
+            set.Insert(ptr);
+            deallocs = alloc_checker::DeallocCount();
+        }
+        REQUIRE(MyInt::AliveCount() == 0);
+        REQUIRE(alloc_checker::DeallocCount() == deallocs);
+        REQUIRE(set.EraseExpired() == 2);
+        REQUIRE(set.Empty());
+        REQUIRE(alloc_checker::DeallocCount() == deallocs + 1);
+    }
+}
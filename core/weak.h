@@ -0,0 +1,151 @@
+#pragma once
+
+#include "shared.h"
+#include "sw_fwd.h"  // Forward declaration
+
+// https://en.cppreference.com/w/cpp/memory/weak_ptr
+template <typename T, typename... Policies>
+class WeakPtr {
+    // Not taken from SharedPtr<T>: picking its specialization would need T complete,
+    // and EnableSharedFromThis<T> holds a WeakPtr<T> while T is being defined.
+    using Shared = SharedPtr<T, Policies...>;
+    using Block = SharedControlBlock<Policies...>;
+    using Observed = ObservedPointer<T, SharedPolicies<Policies...>::kThin>;
+
+    template <typename Y>
+    static constexpr bool kCompatible = Shared::template kCompatible<Y>;
+
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    WeakPtr() {
+    }
+
+    WeakPtr(const WeakPtr& other) : cb_(other.cb_), observed_(other.observed_) {
+        IncreaseCBCounter();
+    }
+
+    WeakPtr(WeakPtr&& other) : cb_(other.cb_), observed_(other.observed_) {
+        other.cb_ = nullptr;
+        other.observed_ = {};
+    }
+
+    // Demote `SharedPtr`
+    // #2 from https://en.cppreference.com/w/cpp/memory/weak_ptr/weak_ptr
+    template <typename Y>
+    requires kCompatible<Y>
+    WeakPtr(const SharedPtr<Y, Policies...>& other) : cb_(other.Share()), observed_(other.observed_) {
+        IncreaseCBCounter();
+    }
+
+    template <typename Y>
+    requires kCompatible<Y>
+    WeakPtr(const WeakPtr<Y, Policies...>& other) : cb_(other.cb_), observed_(other.observed_) {
+        IncreaseCBCounter();
+    }
+
+    template <typename Y>
+    requires kCompatible<Y>
+    WeakPtr(WeakPtr<Y, Policies...>&& other) : cb_(other.cb_), observed_(other.observed_) {
+        other.cb_ = nullptr;
+        other.observed_ = {};
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    WeakPtr& operator=(const WeakPtr& other) {
+        WeakPtr(other).Swap(*this);
+        return *this;
+    }
+
+    WeakPtr& operator=(WeakPtr&& other) {
+        WeakPtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    WeakPtr& operator=(const Shared& other) {
+        WeakPtr(other).Swap(*this);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~WeakPtr() {
+        static_assert(std::is_void_v<EmbeddedCountTraits<T, Policies...>>,
+                      "embedded counters have no weak count, derive from WeakRefCounted instead");
+        DecreaseCBCounter();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        WeakPtr().Swap(*this);
+    }
+
+    void Swap(WeakPtr& other) {
+        std::swap(cb_, other.cb_);
+        std::swap(observed_, other.observed_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    size_t UseCount() const {
+        return cb_ ? cb_->GetSharedCounter() : 0;
+    }
+
+    bool Expired() const {
+        return !UseCount();
+    }
+
+    // Never resurrects an object whose last owner is being released concurrently.
+    Shared Lock() const {
+        if (cb_ && cb_->TryIncreaseSharedCounter()) {
+            return Shared(cb_, observed_);
+        }
+        return {};
+    }
+
+    // Hints the CPU to start loading the control block, e.g. before `Lock()`.
+    template <PrefetchMode Mode = PrefetchMode::kRead, PrefetchLocality Locality = PrefetchLocality::kHigh>
+    void Prefetch() const {
+        PrefetchAddress<Mode, Locality>(cb_);
+    }
+
+    template <typename Y, typename... P>
+    friend class SharedPtr;
+
+    template <typename Y, typename... P>
+    friend class WeakPtr;
+
+    friend struct SharedPtrAccess;
+
+private:
+    // Used by SharedPtr to fill `EnableSharedFromThis::weak_this_`.
+    void Assign(Block* cb, Observed observed) {
+        WeakPtr other;
+        other.cb_ = cb;
+        other.observed_ = observed;
+        other.IncreaseCBCounter();
+        other.Swap(*this);
+    }
+
+    void IncreaseCBCounter() const {
+        if (cb_) {
+            cb_->IncreaseWeakCounter();
+        }
+    }
+
+    void DecreaseCBCounter() const {
+        if (cb_) {
+            cb_->DecreaseWeakCounter();
+        }
+    }
+
+    Block* cb_ = nullptr;
+    [[no_unique_address]] Observed observed_;
+};
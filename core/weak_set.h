@@ -0,0 +1,180 @@
+#pragma once
+
+#include "weak.h"
+
+#include <common/prefetch.h>
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+// Weak references to many objects (subscribers, cache entries) that are swept as a
+// whole instead of one `Expired()` at a time. Kept as two parallel arrays, control
+// blocks and object pointers, like SharedPtrVector:
+//
+//  - UseCounts, EraseExpired and LockAll walk the block array once and read the
+//    counters inline; the sweeps that branch on them prefetch the blocks ahead.
+//  - EraseExpired drops the expired entries and moves the live ones down in the
+//    same pass, keeping their order.
+//  - LockAll fills a caller's buffer of SharedPtr, so a sweep allocates nothing.
+//
+// Not deduplicated: an object added twice has two entries. Empty pointers are not
+// added. Needs the fat layout.
+template <typename T, typename... Policies>
+class WeakPtrSet {
+    using Shared = SharedPtr<T, Policies...>;
+    using Weak = WeakPtr<T, Policies...>;
+    using Block = SharedControlBlock<Policies...>;
+
+    static_assert(!SharedPolicies<Policies...>::kThin, "the object pointers are stored, use the fat layout");
+
+    static constexpr size_t kPrefetchDistance = 8;
+
+public:
+    WeakPtrSet() = default;
+
+    WeakPtrSet(const WeakPtrSet& other) : blocks_(other.blocks_), objects_(other.objects_) {
+        for (Block* block : blocks_) {
+            block->IncreaseWeakCounter();
+        }
+    }
+
+    WeakPtrSet(WeakPtrSet&& other) noexcept : blocks_(std::move(other.blocks_)), objects_(std::move(other.objects_)) {
+    }
+
+    WeakPtrSet& operator=(const WeakPtrSet& other) {
+        WeakPtrSet(other).Swap(*this);
+        return *this;
+    }
+
+    WeakPtrSet& operator=(WeakPtrSet&& other) noexcept {
+        WeakPtrSet(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ~WeakPtrSet() {
+        static_assert(std::is_void_v<EmbeddedCountTraits<T, Policies...>>,
+                      "embedded counters have no weak count, derive from WeakRefCounted instead");
+        Clear();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    // Including the expired entries not erased yet
+    size_t Size() const {
+        return blocks_.size();
+    }
+
+    bool Empty() const {
+        return blocks_.empty();
+    }
+
+    Weak operator[](size_t index) const {
+        blocks_[index]->IncreaseWeakCounter();
+        return SharedPtrAccess::AttachWeak<T, Policies...>(blocks_[index], objects_[index]);
+    }
+
+    Shared Lock(size_t index) const {
+        if (blocks_[index]->TryIncreaseSharedCounter()) {
+            return SharedPtrAccess::Attach<T, Policies...>(blocks_[index], objects_[index]);
+        }
+        return {};
+    }
+
+    // Writes the use count of every entry to `counts[0..Size())`, zero for expired ones.
+    // Returns the number of live entries.
+    size_t UseCounts(size_t* counts) const {
+        const size_t size = blocks_.size();
+        size_t alive = 0;
+        // No branches on the counts: the loads overlap without prefetching.
+        for (size_t i = 0; i < size; ++i) {
+            counts[i] = blocks_[i]->GetSharedCounter();
+            alive += counts[i] != 0;
+        }
+        return alive;
+    }
+
+    // Locks every live entry into `out`, which must have room for Size() pointers;
+    // whatever `out` held before is released. Returns the number of pointers written.
+    size_t LockAll(Shared* out) const {
+        const size_t size = blocks_.size();
+        size_t locked = 0;
+        for (size_t i = 0; i < size; ++i) {
+            Prefetch(i);
+            if (blocks_[i]->TryIncreaseSharedCounter()) {
+                out[locked++] = SharedPtrAccess::Attach<T, Policies...>(blocks_[i], objects_[i]);
+            }
+        }
+        return locked;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reserve(size_t capacity) {
+        blocks_.reserve(capacity);
+        objects_.reserve(capacity);
+    }
+
+    // Also takes `SharedPtr`.
+    void Insert(Weak ptr) {
+        if (objects_.size() == objects_.capacity()) {
+            Reserve(objects_.empty() ? 8 : 2 * objects_.size());
+        }
+        auto [block, object] = SharedPtrAccess::Detach(ptr);
+        if (block) {
+            blocks_.push_back(block);
+            objects_.push_back(object);
+        }
+    }
+
+    // Removes the entries whose objects are gone, keeping the order of the others.
+    // Returns their number.
+    size_t EraseExpired() {
+        const size_t size = blocks_.size();
+        size_t kept = 0;
+        for (size_t i = 0; i < size; ++i) {
+            Prefetch(i);
+            Block* block = blocks_[i];
+            if (block->GetSharedCounter()) {
+                blocks_[kept] = block;
+                objects_[kept] = objects_[i];
+                ++kept;
+            } else {
+                block->DecreaseWeakCounter();
+            }
+        }
+        blocks_.resize(kept);
+        objects_.resize(kept);
+        return size - kept;
+    }
+
+    void Clear() {
+        for (size_t i = 0; i < blocks_.size(); ++i) {
+            Prefetch(i);
+            blocks_[i]->DecreaseWeakCounter();
+        }
+        blocks_.clear();
+        objects_.clear();
+    }
+
+    void Swap(WeakPtrSet& other) noexcept {
+        blocks_.swap(other.blocks_);
+        objects_.swap(other.objects_);
+    }
+
+private:
+    void Prefetch(size_t index) const {
+        if (index + kPrefetchDistance < blocks_.size()) {
+            PrefetchAddress(blocks_[index + kPrefetchDistance]);
+        }
+    }
+
+    std::vector<Block*> blocks_;
+    std::vector<T*> objects_;
+};
+
+// Containers move rather than copy on reallocation.
+static_assert(std::is_nothrow_move_constructible_v<WeakPtrSet<int>>);
+static_assert(std::is_nothrow_move_assignable_v<WeakPtrSet<int>>);
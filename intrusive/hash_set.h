@@ -0,0 +1,251 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Per-element state of an IntrusiveHashSet: the element's slot in the table and
+// its cached hash. Knowing the slot makes Erase(element) O(1) without a lookup;
+// the cached hash keeps rehashing and probing from touching keys.
+template <typename Tag = void>
+class HashSetHook {
+    template <typename T, auto, typename, typename>
+    friend class IntrusiveHashSet;
+
+public:
+    HashSetHook() = default;
+
+    // Copies of an element are not linked anywhere.
+    HashSetHook(const HashSetHook&) {
+    }
+
+    HashSetHook& operator=(const HashSetHook&) {
+        return *this;
+    }
+
+    bool IsLinked() const {
+        return slot_ != kUnlinked;
+    }
+
+private:
+    static constexpr size_t kUnlinked = ~size_t{0};
+
+    size_t slot_ = kUnlinked;
+    size_t hash_ = 0;
+};
+
+// Open-addressing hash set of elements that derive from HashSetHook<Tag>, keyed
+// by `Key` (a data member or getter of T, e.g. &Session::id). Linear probing with
+// backward-shift erase, so there are no tombstones. The set owns one reference
+// to each element; memory is only allocated when the table grows.
+template <typename T, auto Key, typename Tag = void,
+          typename Hash = std::hash<std::remove_cvref_t<std::invoke_result_t<decltype(Key), const T&>>>>
+class IntrusiveHashSet {
+    using Hook = HashSetHook<Tag>;
+    using KeyType = std::remove_cvref_t<std::invoke_result_t<decltype(Key), const T&>>;
+
+    static constexpr size_t kMinCapacity = 8;
+
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        Iterator() = default;
+
+        T& operator*() const {
+            return **slot_;
+        }
+        T* operator->() const {
+            return *slot_;
+        }
+
+        Iterator& operator++() {
+            ++slot_;
+            SkipEmpty();
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return slot_ == other.slot_;
+        }
+
+    private:
+        friend class IntrusiveHashSet;
+
+        Iterator(T* const* slot, T* const* end) : slot_(slot), end_(end) {
+            SkipEmpty();
+        }
+
+        void SkipEmpty() {
+            while (slot_ != end_ && !*slot_) {
+                ++slot_;
+            }
+        }
+
+        T* const* slot_ = nullptr;
+        T* const* end_ = nullptr;
+    };
+
+    IntrusiveHashSet() = default;
+
+    IntrusiveHashSet(const IntrusiveHashSet&) = delete;
+    IntrusiveHashSet& operator=(const IntrusiveHashSet&) = delete;
+
+    ~IntrusiveHashSet() {
+        Clear();
+    }
+
+    // Returns false (and drops `object`) if an element with the same key is present.
+    // The element must not be linked into a set with this Tag.
+    bool Insert(IntrusivePtr<T> object) {
+        if ((size_ + 1) * 4 > slots_.size() * 3) {
+            Rehash(std::max(kMinCapacity, slots_.size() * 2));
+        }
+        size_t hash = Hash{}(KeyOf(*object));
+        size_t slot = hash & Mask();
+        for (; slots_[slot]; slot = (slot + 1) & Mask()) {
+            if (Matches(slots_[slot], hash, KeyOf(*object))) {
+                return false;
+            }
+        }
+        Hook& hook = *object;
+        hook.hash_ = hash;
+        Place(IntrusivePtrAccess::Release(object), slot);
+        ++size_;
+        return true;
+    }
+
+    T* Find(const KeyType& key) const {
+        if (!size_) {
+            return nullptr;
+        }
+        size_t hash = Hash{}(key);
+        for (size_t slot = hash & Mask(); slots_[slot]; slot = (slot + 1) & Mask()) {
+            if (Matches(slots_[slot], hash, key)) {
+                return slots_[slot];
+            }
+        }
+        return nullptr;
+    }
+
+    bool Contains(const KeyType& key) const {
+        return Find(key);
+    }
+
+    // `object` must be linked into this set. Returns the set's reference.
+    IntrusivePtr<T> Erase(T& object) {
+        Hook& hook = object;
+        size_t hole = hook.slot_;
+        hook.slot_ = Hook::kUnlinked;
+        // Pull back every following element of the probe run that may live in the hole.
+        for (size_t slot = (hole + 1) & Mask(); T* next = slots_[slot]; slot = (slot + 1) & Mask()) {
+            size_t home = HookOf(next).hash_ & Mask();
+            if (((slot - home) & Mask()) >= ((slot - hole) & Mask())) {
+                Place(next, hole);
+                hole = slot;
+            }
+        }
+        slots_[hole] = nullptr;
+        --size_;
+        return IntrusivePtrAccess::Adopt(&object);
+    }
+
+    // Null if there is no such element.
+    IntrusivePtr<T> Erase(const KeyType& key) {
+        T* object = Find(key);
+        return object ? Erase(*object) : IntrusivePtr<T>();
+    }
+
+    void Clear() {
+        for (T*& object : slots_) {
+            if (object) {
+                HookOf(object).slot_ = Hook::kUnlinked;
+                IntrusivePtrAccess::Adopt(std::exchange(object, nullptr));
+            }
+        }
+        size_ = 0;
+    }
+
+    void Reserve(size_t size) {
+        size_t capacity = kMinCapacity;
+        while (size * 4 > capacity * 3) {
+            capacity *= 2;
+        }
+        if (capacity > slots_.size()) {
+            Rehash(capacity);
+        }
+    }
+
+    // Observers
+    static bool IsLinked(const T& object) {
+        return static_cast<const Hook&>(object).IsLinked();
+    }
+    size_t Size() const {
+        return size_;
+    }
+    bool Empty() const {
+        return !size_;
+    }
+
+    Iterator begin() const {  // NOLINT
+        return Iterator(slots_.data(), slots_.data() + slots_.size());
+    }
+    Iterator end() const {  // NOLINT
+        return Iterator(slots_.data() + slots_.size(), slots_.data() + slots_.size());
+    }
+
+private:
+    static decltype(auto) KeyOf(const T& object) {
+        return std::invoke(Key, object);
+    }
+
+    static Hook& HookOf(T* object) {
+        return *object;
+    }
+
+    static bool Matches(T* object, size_t hash, const KeyType& key) {
+        return HookOf(object).hash_ == hash && KeyOf(*object) == key;
+    }
+
+    size_t Mask() const {
+        return slots_.size() - 1;
+    }
+
+    void Place(T* object, size_t slot) {
+        slots_[slot] = object;
+        HookOf(object).slot_ = slot;
+    }
+
+    void Rehash(size_t capacity) {
+        std::vector<T*> old(capacity);
+        old.swap(slots_);
+        for (T* object : old) {
+            if (object) {
+                size_t slot = HookOf(object).hash_ & Mask();
+                while (slots_[slot]) {
+                    slot = (slot + 1) & Mask();
+                }
+                Place(object, slot);
+            }
+        }
+    }
+
+    std::vector<T*> slots_;
+    size_t size_ = 0;
+};
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <common/prefetch.h>
+
+#include <atomic>
 #include <cstddef>  // for std::nullptr_t
+#include <type_traits>
 #include <utility>  // for std::exchange / std::swap
 
 class SimpleCounter {
@@ -19,6 +23,23 @@ private:
     size_t count_ = 0;
 };
 
+// For objects shared between threads
+class AtomicCounter {
+public:
+    size_t IncRef() {
+        return count_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    size_t DecRef() {
+        return count_.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    }
+    size_t RefCount() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<size_t> count_ = 0;
+};
+
 struct DefaultDelete {
     template <typename T>
     static void Destroy(T* object) {
@@ -29,6 +50,8 @@ struct DefaultDelete {
 template <typename Derived, typename Counter, typename Deleter>
 class RefCounted {
 public:
+    using DeleterType = Deleter;
+
     // Increase reference counter.
 
     RefCounted() = default;
@@ -73,11 +96,70 @@ private:
 template <typename Derived, typename D = DefaultDelete>
 using SimpleRefCounted = RefCounted<Derived, SimpleCounter, D>;
 
-template <typename T>
+template <typename Derived, typename D = DefaultDelete>
+using AtomicRefCounted = RefCounted<Derived, AtomicCounter, D>;
+
+// How IntrusivePtr reaches the counter. The default calls the members of RefCounted.
+// The count is not part of the object's value, so const objects are counted too.
+struct IntrusiveTraits {
+    template <typename T>
+    static void IncRef(T* object) {
+        const_cast<std::remove_cv_t<T>*>(object)->IncRef();
+    }
+
+    template <typename T>
+    static void DecRef(T* object) {
+        const_cast<std::remove_cv_t<T>*>(object)->DecRef();
+    }
+
+    template <typename T>
+    static size_t RefCount(const T* object) {
+        return object->RefCount();
+    }
+};
+
+// Objects counted by a foreign (e.g. C) library:
+//
+//     using FooTraits = ExternalRefTraits<&foo_ref, &foo_unref, &foo_refcount>;
+//     IntrusivePtr<foo, FooTraits> foo = AdoptIntrusive<FooTraits>(foo_new());
+//
+// `Unref` frees the object when the count drops to zero. `Count` is optional;
+// without it UseCount() does not compile.
+// C functions take non-const handles, so constness is cast away here.
+template <auto Ref, auto Unref, auto Count = nullptr>
+struct ExternalRefTraits {
+    template <typename T>
+    static void IncRef(T* object) {
+        Ref(const_cast<std::remove_cv_t<T>*>(object));
+    }
+
+    template <typename T>
+    static void DecRef(T* object) {
+        Unref(const_cast<std::remove_cv_t<T>*>(object));
+    }
+
+    template <typename T>
+    requires(!std::is_null_pointer_v<decltype(Count)>)
+    static size_t RefCount(const T* object) {
+        return Count(const_cast<std::remove_cv_t<T>*>(object));
+    }
+};
+
+template <typename T, unsigned Bits>
+class TaggedIntrusivePtr;
+
+struct IntrusivePtrAccess;
+
+template <typename T, typename Traits = IntrusiveTraits>
 class IntrusivePtr {
-    template <typename Y>
+    template <typename Y, typename>
     friend class IntrusivePtr;
 
+    template <typename Y, unsigned Bits>
+    friend class TaggedIntrusivePtr;
+
+    friend struct IntrusivePtrAccess;
+
 public:
     // Constructors
     IntrusivePtr() {
@@ -90,12 +172,12 @@ public:
     }
 
     template <typename Y>
-    IntrusivePtr(const IntrusivePtr<Y>& other) : ptr_(other.ptr_) {
+    IntrusivePtr(const IntrusivePtr<Y, Traits>& other) : ptr_(other.ptr_) {
         IncRef();
     }
 
     template <typename Y>
-    IntrusivePtr(IntrusivePtr<Y>&& other) : ptr_(other.ptr_) {
+    IntrusivePtr(IntrusivePtr<Y, Traits>&& other) : ptr_(other.ptr_) {
         other.ptr_ = nullptr;
     }
 
@@ -163,33 +245,139 @@ public:
         return ptr_;
     }
 
+    // Hints the CPU to start loading the object together with its counter.
+    template <PrefetchMode Mode = PrefetchMode::kRead, PrefetchLocality Locality = PrefetchLocality::kHigh>
+    void Prefetch() const {
+        PrefetchAddress<Mode, Locality>(ptr_);
+    }
+
     template <typename Y, typename... Args>
     friend IntrusivePtr<Y> MakeIntrusive(Args&&... args);
 
+    template <typename Y, typename U, typename R>
+    friend IntrusivePtr<Y, R> StaticPointerCast(IntrusivePtr<U, R>&& ptr);
+    template <typename Y, typename U, typename R>
+    friend IntrusivePtr<Y, R> DynamicPointerCast(IntrusivePtr<U, R>&& ptr);
+    template <typename Y, typename U, typename R>
+    friend IntrusivePtr<Y, R> ConstPointerCast(IntrusivePtr<U, R>&& ptr);
+    template <typename Y, typename U, typename R>
+    friend IntrusivePtr<Y, R> ReinterpretPointerCast(IntrusivePtr<U, R>&& ptr);
+
 private:
     T* ptr_ = nullptr;
 
     void IncRef() {
         if (ptr_) {
-            ptr_->IncRef();
+            Traits::IncRef(ptr_);
         }
     }
 
     void DecRef() {
         if (ptr_) {
-            ptr_->DecRef();
+            Traits::DecRef(ptr_);
         }
     }
     size_t RefCount() const {
         if (ptr_) {
-            return ptr_->RefCount();
+            return Traits::RefCount(ptr_);
         }
         return 0;
     }
+
+    // Takes over the reference held by `from`.
+    template <typename U>
+    static IntrusivePtr Adopt(IntrusivePtr<U, Traits>& from, T* ptr) {
+        IntrusivePtr res;
+        res.ptr_ = ptr;
+        from.ptr_ = nullptr;
+        return res;
+    }
 };
 
+// Hands references between IntrusivePtr and containers that keep raw pointers
+// to the objects they own (see list.h, hash_set.h).
+struct IntrusivePtrAccess {
+    template <typename T, typename Traits>
+    static T* Release(IntrusivePtr<T, Traits>& ptr) {
+        return std::exchange(ptr.ptr_, nullptr);
+    }
+
+    // Takes over a reference counted earlier by Release.
+    template <typename Traits = IntrusiveTraits, typename T>
+    static IntrusivePtr<T, Traits> Adopt(T* object) {
+        IntrusivePtr<T, Traits> res;
+        res.ptr_ = object;
+        return res;
+    }
+};
+
+// Takes over a reference the caller already owns, e.g. the one a C constructor
+// returns, instead of adding another one as IntrusivePtr(T*) does.
+template <typename Traits = IntrusiveTraits, typename T>
+IntrusivePtr<T, Traits> AdoptIntrusive(T* object) {
+    return IntrusivePtrAccess::Adopt<Traits>(object);
+}
+
+// Deleters that own their memory (e.g. SlabDelete) also provide `Create`. With
+// `kCreatesReference` it returns the object with its first reference counted.
 template <typename T, typename... Args>
 IntrusivePtr<T> MakeIntrusive(Args&&... args) {
-    IntrusivePtr<T> res(new T(args)...);
-    return res;
+    if constexpr (requires { T::DeleterType::template Create<T>(std::forward<Args>(args)...); }) {
+        T* object = T::DeleterType::template Create<T>(std::forward<Args>(args)...);
+        if constexpr (requires { requires T::DeleterType::kCreatesReference; }) {
+            return AdoptIntrusive(object);
+        } else {
+            return IntrusivePtr<T>(object);
+        }
+    } else {
+        IntrusivePtr<T> res(new T(std::forward<Args>(args)...));
+        return res;
+    }
+}
+
+// Casts, see https://en.cppreference.com/w/cpp/memory/shared_ptr/pointer_cast
+// The rvalue overloads move the reference into the result without touching the counter.
+
+template <typename T, typename U, typename R>
+IntrusivePtr<T, R> StaticPointerCast(const IntrusivePtr<U, R>& ptr) {
+    return IntrusivePtr<T, R>(static_cast<T*>(ptr.Get()));
+}
+
+template <typename T, typename U, typename R>
+IntrusivePtr<T, R> StaticPointerCast(IntrusivePtr<U, R>&& ptr) {
+    return IntrusivePtr<T, R>::Adopt(ptr, static_cast<T*>(ptr.Get()));
+}
+
+template <typename T, typename U, typename R>
+IntrusivePtr<T, R> DynamicPointerCast(const IntrusivePtr<U, R>& ptr) {
+    return IntrusivePtr<T, R>(dynamic_cast<T*>(ptr.Get()));
+}
+
+// `ptr` keeps its reference if the cast fails.
+template <typename T, typename U, typename R>
+IntrusivePtr<T, R> DynamicPointerCast(IntrusivePtr<U, R>&& ptr) {
+    if (T* object = dynamic_cast<T*>(ptr.Get())) {
+        return IntrusivePtr<T, R>::Adopt(ptr, object);
+    }
+    return {};
+}
+
+template <typename T, typename U, typename R>
+IntrusivePtr<T, R> ConstPointerCast(const IntrusivePtr<U, R>& ptr) {
+    return IntrusivePtr<T, R>(const_cast<T*>(ptr.Get()));
+}
+
+template <typename T, typename U, typename R>
+IntrusivePtr<T, R> ConstPointerCast(IntrusivePtr<U, R>&& ptr) {
+    return IntrusivePtr<T, R>::Adopt(ptr, const_cast<T*>(ptr.Get()));
+}
+
+template <typename T, typename U, typename R>
+IntrusivePtr<T, R> ReinterpretPointerCast(const IntrusivePtr<U, R>& ptr) {
+    return IntrusivePtr<T, R>(reinterpret_cast<T*>(ptr.Get()));
+}
+
+template <typename T, typename U, typename R>
+IntrusivePtr<T, R> ReinterpretPointerCast(IntrusivePtr<U, R>&& ptr) {
+    return IntrusivePtr<T, R>::Adopt(ptr, reinterpret_cast<T*>(ptr.Get()));
 }
@@ -0,0 +1,202 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <cstddef>
+#include <iterator>
+
+// Doubly linked list whose links live inside the elements. An element derives
+// from ListHook<Tag> once per list it can be in at the same time, e.g.
+//
+//     struct Session : SimpleRefCounted<Session>, ListHook<struct ByAge> {};
+//     IntrusiveList<Session, ByAge> sessions;
+//
+// A linked element is owned by the list (it holds one reference), so linking and
+// unlinking never allocate and unlinking is O(1) given the element itself.
+template <typename Tag = void>
+class ListHook {
+    template <typename T, typename>
+    friend class IntrusiveList;
+
+public:
+    ListHook() = default;
+
+    // Copies of an element are not linked anywhere.
+    ListHook(const ListHook&) {
+    }
+
+    ListHook& operator=(const ListHook&) {
+        return *this;
+    }
+
+    bool IsLinked() const {
+        return next_;
+    }
+
+private:
+    void LinkBefore(ListHook* next) {
+        prev_ = next->prev_;
+        next_ = next;
+        prev_->next_ = this;
+        next_->prev_ = this;
+    }
+
+    void Unlink() {
+        prev_->next_ = next_;
+        next_->prev_ = prev_;
+        prev_ = next_ = nullptr;
+    }
+
+    ListHook* prev_ = nullptr;
+    ListHook* next_ = nullptr;
+};
+
+template <typename T, typename Tag = void>
+class IntrusiveList {
+    using Hook = ListHook<Tag>;
+
+    static T* ObjectOf(Hook* hook) {
+        return static_cast<T*>(hook);
+    }
+
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        Iterator() = default;
+
+        T& operator*() const {
+            return *ObjectOf(hook_);
+        }
+        T* operator->() const {
+            return ObjectOf(hook_);
+        }
+
+        Iterator& operator++() {
+            hook_ = hook_->next_;
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator old = *this;
+            ++*this;
+            return old;
+        }
+        Iterator& operator--() {
+            hook_ = hook_->prev_;
+            return *this;
+        }
+        Iterator operator--(int) {
+            Iterator old = *this;
+            --*this;
+            return old;
+        }
+
+        bool operator==(const Iterator&) const = default;
+
+    private:
+        friend class IntrusiveList;
+
+        explicit Iterator(Hook* hook) : hook_(hook) {
+        }
+
+        Hook* hook_ = nullptr;
+    };
+
+    IntrusiveList() {
+        head_.prev_ = head_.next_ = &head_;
+    }
+
+    IntrusiveList(const IntrusiveList&) = delete;
+    IntrusiveList& operator=(const IntrusiveList&) = delete;
+
+    ~IntrusiveList() {
+        Clear();
+    }
+
+    // Modifiers. The element must not be linked into a list with this Tag.
+    void PushBack(IntrusivePtr<T> object) {
+        Link(std::move(object), &head_);
+    }
+
+    void PushFront(IntrusivePtr<T> object) {
+        Link(std::move(object), head_.next_);
+    }
+
+    void InsertBefore(Iterator pos, IntrusivePtr<T> object) {
+        Link(std::move(object), pos.hook_);
+    }
+
+    // `object` must be linked into this list. Returns the list's reference.
+    IntrusivePtr<T> Erase(T& object) {
+        Hook& hook = object;
+        hook.Unlink();
+        --size_;
+        return IntrusivePtrAccess::Adopt(&object);
+    }
+
+    IntrusivePtr<T> PopFront() {
+        return Erase(Front());
+    }
+
+    IntrusivePtr<T> PopBack() {
+        return Erase(Back());
+    }
+
+    // Relinks a linked element without touching its counter.
+    void MoveToFront(T& object) {
+        Hook& hook = object;
+        hook.Unlink();
+        hook.LinkBefore(head_.next_);
+    }
+
+    void MoveToBack(T& object) {
+        Hook& hook = object;
+        hook.Unlink();
+        hook.LinkBefore(&head_);
+    }
+
+    void Clear() {
+        while (!Empty()) {
+            PopFront();
+        }
+    }
+
+    // Observers
+    static bool IsLinked(const T& object) {
+        return static_cast<const Hook&>(object).IsLinked();
+    }
+    size_t Size() const {
+        return size_;
+    }
+    bool Empty() const {
+        return !size_;
+    }
+    T& Front() const {
+        return *ObjectOf(head_.next_);
+    }
+    T& Back() const {
+        return *ObjectOf(head_.prev_);
+    }
+
+    Iterator begin() const {  // NOLINT
+        return Iterator(head_.next_);
+    }
+    Iterator end() const {  // NOLINT
+        return Iterator(const_cast<Hook*>(&head_));
+    }
+
+private:
+    void Link(IntrusivePtr<T> object, Hook* next) {
+        Hook* hook = IntrusivePtrAccess::Release(object);
+        hook->LinkBefore(next);
+        ++size_;
+    }
+
+    Hook head_;
+    size_t size_ = 0;
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "tagged.h"
+
+#include <optional>
+#include <utility>
+
+// Lock-free containers over AtomicRefCounted nodes. A thread that loaded a node
+// holds a reference to it, so nodes are never freed under a reader and need no
+// hazard pointers or epochs.
+
+// Treiber stack. The head carries a version tag that every successful swap bumps.
+template <typename T>
+class TreiberStack {
+    struct Node : AtomicRefCounted<Node> {
+        template <typename... Args>
+        explicit Node(Args&&... args) : value(std::forward<Args>(args)...) {
+        }
+
+        T value;
+        IntrusivePtr<Node> next;  // Immutable once the node is published.
+    };
+
+    static constexpr unsigned kVersionBits = 16;
+    using Head = TaggedIntrusivePtr<Node, kVersionBits>;
+
+public:
+    TreiberStack() = default;
+
+    TreiberStack(const TreiberStack&) = delete;
+    TreiberStack& operator=(const TreiberStack&) = delete;
+
+    // Iterative: dropping a long chain at once would recurse node by node.
+    ~TreiberStack() {
+        while (Pop()) {
+        }
+    }
+
+    template <typename... Args>
+    void Push(Args&&... args) {
+        auto node = MakeIntrusive<Node>(std::forward<Args>(args)...);
+        Head top = head_.Load();
+        Head desired(node);
+        do {
+            node->next = top.ToIntrusive();
+            desired.SetTag(top.GetTag() + 1);
+        } while (!head_.CompareExchange(top, desired));
+    }
+
+    std::optional<T> Pop() {
+        Head top = head_.Load();
+        while (top) {
+            if (head_.CompareExchange(top, Head(top->next, top.GetTag() + 1))) {
+                // Losers of the race only read `next`, so the value can be moved out.
+                return std::move(top->value);
+            }
+        }
+        return std::nullopt;
+    }
+
+    bool Empty() const {
+        return !head_.Load();
+    }
+
+private:
+    AtomicTaggedIntrusivePtr<Node, kVersionBits> head_;
+};
+
+// Harris's sorted linked list set (with Michael's restart-from-head search).
+// Erase first sets the mark bit on the node's own `next` link, which freezes it,
+// and then unlinks the node; searches unlink marked nodes they pass.
+template <typename Key>
+class HarrisList {
+    struct Node;
+    using Link = TaggedIntrusivePtr<Node, 1>;
+
+    struct Node : AtomicRefCounted<Node> {
+        Node() = default;
+        explicit Node(const Key& key) : key(key) {
+        }
+
+        Key key{};
+        AtomicTaggedIntrusivePtr<Node, 1> next;  // Tag 1: this node is erased.
+    };
+
+public:
+    HarrisList() : head_(MakeIntrusive<Node>()) {
+    }
+
+    HarrisList(const HarrisList&) = delete;
+    HarrisList& operator=(const HarrisList&) = delete;
+
+    // Iterative, see ~TreiberStack.
+    ~HarrisList() {
+        Link node = head_->next.Exchange({});
+        while (node) {
+            node = node->next.Exchange({});
+        }
+    }
+
+    bool Insert(const Key& key) {
+        IntrusivePtr<Node> node;
+        while (true) {
+            auto [prev, curr] = Find(key);
+            if (curr && curr->key == key) {
+                return false;
+            }
+            if (!node) {
+                node = MakeIntrusive<Node>(key);
+            }
+            node->next.Store(curr);
+            if (prev->next.CompareExchange(curr, Link(node))) {
+                return true;
+            }
+        }
+    }
+
+    bool Erase(const Key& key) {
+        while (true) {
+            auto [prev, curr] = Find(key);
+            if (!curr || curr->key != key) {
+                return false;
+            }
+            Link next = curr->next.Load();
+            if (next.GetTag() || !curr->next.CompareExchange(next, next.WithTag(1))) {
+                continue;
+            }
+            if (!prev->next.CompareExchange(curr, next)) {
+                Find(key);
+            }
+            return true;
+        }
+    }
+
+    bool Contains(const Key& key) {
+        Link curr = Find(key).second;
+        return curr && curr->key == key;
+    }
+
+private:
+    // Returns adjacent unmarked `prev` and `curr` with prev->key < key <= curr->key;
+    // `curr` is null past the end.
+    std::pair<IntrusivePtr<Node>, Link> Find(const Key& key) {
+    retry:
+        IntrusivePtr<Node> prev = head_;
+        Link curr = prev->next.Load();
+        while (curr) {
+            Link next = curr->next.Load();
+            if (next.GetTag()) {
+                Link unmarked = next.WithTag(0);
+                if (!prev->next.CompareExchange(curr, unmarked)) {
+                    goto retry;
+                }
+                curr = std::move(unmarked);
+                continue;
+            }
+            if (!(curr->key < key)) {
+                break;
+            }
+            prev = curr.ToIntrusive();
+            curr = std::move(next);
+        }
+        return {std::move(prev), std::move(curr)};
+    }
+
+    IntrusivePtr<Node> head_;
+};
@@ -0,0 +1,212 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <compare>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+// Immutable string with reference-counted storage. Up to kInlineCapacity chars are
+// kept inside the 16-byte object itself, with no heap at all; longer strings keep
+// a RefCounted header and the characters in one allocation, so copies only bump
+// the counter. The hash is computed once when a heap string is made and cached in
+// its header; it equals std::hash<std::string_view> of the contents, so maps keyed
+// by SharedString can be probed with string_views.
+//
+// Inline layout: chars in bytes 0..14, byte 15 holds `kInlineCapacity - size`, which
+// doubles as the terminating zero of a full 15-char string. Heap layout: the header
+// pointer in bytes 0..7 and kHeapTag in byte 15.
+template <typename Counter>
+class BasicSharedString {
+    struct RepDelete {
+        template <typename Rep>
+        static void Destroy(Rep* rep) {
+            rep->~Rep();
+            ::operator delete(rep);
+        }
+    };
+
+    // Followed by `size + 1` chars in the same allocation.
+    struct Rep : RefCounted<Rep, Counter, RepDelete> {
+        size_t size = 0;
+        size_t hash = 0;
+
+        char* Data() {
+            return reinterpret_cast<char*>(this + 1);
+        }
+    };
+
+public:
+    static constexpr size_t kInlineCapacity = 15;
+
+    BasicSharedString() {
+        SetInline({});
+    }
+
+    explicit BasicSharedString(std::string_view str) {
+        if (str.size() <= kInlineCapacity) {
+            SetInline(str);
+            return;
+        }
+        Rep* rep = new (::operator new(sizeof(Rep) + str.size() + 1)) Rep;
+        rep->size = str.size();
+        rep->hash = std::hash<std::string_view>{}(str);
+        std::memcpy(rep->Data(), str.data(), str.size());
+        rep->Data()[str.size()] = '\0';
+        rep->IncRef();
+        SetRep(rep);
+    }
+
+    explicit BasicSharedString(const char* str) : BasicSharedString(std::string_view(str)) {
+    }
+
+    BasicSharedString(const BasicSharedString& other) {
+        std::memcpy(storage_, other.storage_, sizeof(storage_));
+        if (IsHeap()) {
+            GetRep()->IncRef();
+        }
+    }
+
+    BasicSharedString(BasicSharedString&& other) noexcept {
+        std::memcpy(storage_, other.storage_, sizeof(storage_));
+        other.SetInline({});
+    }
+
+    BasicSharedString& operator=(const BasicSharedString& other) {
+        BasicSharedString(other).Swap(*this);
+        return *this;
+    }
+
+    BasicSharedString& operator=(BasicSharedString&& other) noexcept {
+        BasicSharedString(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ~BasicSharedString() {
+        if (IsHeap()) {
+            GetRep()->DecRef();
+        }
+    }
+
+    void Swap(BasicSharedString& other) noexcept {
+        std::swap(storage_, other.storage_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    // Zero-terminated
+    const char* Data() const {
+        return IsHeap() ? GetRep()->Data() : storage_;
+    }
+
+    size_t Size() const {
+        return IsHeap() ? GetRep()->size : kInlineCapacity - static_cast<unsigned char>(storage_[kTagByte]);
+    }
+
+    bool Empty() const {
+        return !Size();
+    }
+
+    std::string_view View() const {
+        if (IsHeap()) {
+            return {GetRep()->Data(), GetRep()->size};
+        }
+        return {storage_, Size()};
+    }
+
+    operator std::string_view() const {  // NOLINT
+        return View();
+    }
+
+    size_t Hash() const {
+        return IsHeap() ? GetRep()->hash : std::hash<std::string_view>{}(View());
+    }
+
+    bool IsInline() const {
+        return !IsHeap();
+    }
+
+    // Strings sharing this one's storage, 0 for inline strings
+    size_t UseCount() const {
+        return IsHeap() ? GetRep()->RefCount() : 0;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Comparisons
+
+    // Shared storage compares equal right away, different cached hashes unequal.
+    friend bool operator==(const BasicSharedString& a, const BasicSharedString& b) {
+        if (a.IsHeap() && b.IsHeap()) {
+            if (a.GetRep() == b.GetRep()) {
+                return true;
+            }
+            if (a.GetRep()->hash != b.GetRep()->hash) {
+                return false;
+            }
+        }
+        return a.View() == b.View();
+    }
+
+    friend bool operator==(const BasicSharedString& a, std::string_view b) {
+        return a.View() == b;
+    }
+
+    friend std::strong_ordering operator<=>(const BasicSharedString& a, const BasicSharedString& b) {
+        return a.View() <=> b.View();
+    }
+
+    friend std::strong_ordering operator<=>(const BasicSharedString& a, std::string_view b) {
+        return a.View() <=> b;
+    }
+
+private:
+    static constexpr size_t kTagByte = kInlineCapacity;
+    static constexpr unsigned char kHeapTag = 0xFF;
+
+    bool IsHeap() const {
+        return static_cast<unsigned char>(storage_[kTagByte]) == kHeapTag;
+    }
+
+    Rep* GetRep() const {
+        Rep* rep;
+        std::memcpy(&rep, storage_, sizeof(rep));
+        return rep;
+    }
+
+    void SetRep(Rep* rep) {
+        std::memcpy(storage_, &rep, sizeof(rep));
+        storage_[kTagByte] = static_cast<char>(kHeapTag);
+    }
+
+    void SetInline(std::string_view str) {
+        if (!str.empty()) {
+            std::memcpy(storage_, str.data(), str.size());
+        }
+        std::memset(storage_ + str.size(), 0, kTagByte - str.size());
+        storage_[kTagByte] = static_cast<char>(kInlineCapacity - str.size());
+    }
+
+    alignas(void*) char storage_[kInlineCapacity + 1];
+};
+
+using SharedString = BasicSharedString<SimpleCounter>;
+
+// For strings shared between threads
+using AtomicSharedString = BasicSharedString<AtomicCounter>;
+
+// Containers move rather than copy on reallocation.
+static_assert(std::is_nothrow_move_constructible_v<SharedString>);
+static_assert(std::is_nothrow_move_assignable_v<SharedString>);
+
+template <typename Counter>
+struct std::hash<BasicSharedString<Counter>> {
+    size_t operator()(const BasicSharedString<Counter>& str) const {
+        return str.Hash();
+    }
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <common/slab.h>
+
+#include <type_traits>
+#include <utility>
+
+// Deleter for RefCounted objects living in slabs. Such objects must be created
+// with MakeIntrusive, which picks up `Create` from the deleter.
+struct SlabDelete {
+    template <typename T, typename... Args>
+    static T* Create(Args&&... args) {
+        void* slot = SlabAllocatorFor<T>::Instance().Allocate();
+        try {
+            return new (slot) T(std::forward<Args>(args)...);
+        } catch (...) {
+            SlabAllocatorBase::Free(slot);
+            throw;
+        }
+    }
+
+    template <typename T>
+    static void Destroy(T* object) {
+        void* slot = object;
+        if constexpr (std::is_polymorphic_v<T>) {
+            slot = dynamic_cast<void*>(object);
+        }
+        object->~T();
+        SlabAllocatorBase::Free(slot);
+    }
+};
+
+template <typename Derived>
+using SlabRefCounted = RefCounted<Derived, SimpleCounter, SlabDelete>;
@@ -0,0 +1,337 @@
+#pragma once
+
+#include "intrusive.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+// IntrusivePtr with a `Bits`-wide tag (mark bits, ABA versions) packed into the
+// same word. The tag lives in the low bits freed by the alignment of T and, on
+// x86-64, in the upper 16 bits of the address. The pointer keeps its reference
+// semantics: copies IncRef, destruction DecRefs; the tag is plain data.
+template <typename T, unsigned Bits>
+class TaggedIntrusivePtr {
+    template <typename Y, unsigned>
+    friend class AtomicTaggedIntrusivePtr;
+
+public:
+    using Tag = uintptr_t;
+
+    TaggedIntrusivePtr() {
+    }
+    TaggedIntrusivePtr(std::nullptr_t) {
+    }
+
+    explicit TaggedIntrusivePtr(T* ptr, Tag tag = 0) : word_(Pack(ptr, tag)) {
+        IncRef();
+    }
+
+    explicit TaggedIntrusivePtr(const IntrusivePtr<T>& ptr, Tag tag = 0) : TaggedIntrusivePtr(ptr.Get(), tag) {
+    }
+
+    // Takes over the reference of `ptr`.
+    explicit TaggedIntrusivePtr(IntrusivePtr<T>&& ptr, Tag tag = 0) : word_(Pack(ptr.ptr_, tag)) {
+        ptr.ptr_ = nullptr;
+    }
+
+    TaggedIntrusivePtr(const TaggedIntrusivePtr& other) : word_(other.word_) {
+        IncRef();
+    }
+
+    TaggedIntrusivePtr(TaggedIntrusivePtr&& other) : word_(std::exchange(other.word_, 0)) {
+    }
+
+    TaggedIntrusivePtr& operator=(const TaggedIntrusivePtr& other) {
+        TaggedIntrusivePtr(other).Swap(*this);
+        return *this;
+    }
+
+    TaggedIntrusivePtr& operator=(TaggedIntrusivePtr&& other) {
+        TaggedIntrusivePtr(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ~TaggedIntrusivePtr() {
+        DecRef();
+    }
+
+    // Modifiers
+    void Reset() {
+        TaggedIntrusivePtr().Swap(*this);
+    }
+
+    void SetTag(Tag tag) {
+        word_ = Pack(Get(), tag);
+    }
+
+    void Swap(TaggedIntrusivePtr& other) {
+        std::swap(word_, other.word_);
+    }
+
+    // Observers
+    T* Get() const {
+        return PointerOf(word_);
+    }
+    Tag GetTag() const {
+        return TagOf(word_);
+    }
+    T& operator*() const {
+        return *Get();
+    }
+    T* operator->() const {
+        return Get();
+    }
+    size_t UseCount() const {
+        T* ptr = Get();
+        return ptr ? ptr->RefCount() : 0;
+    }
+    explicit operator bool() const {
+        return Get();
+    }
+
+    // Same object with another tag
+    TaggedIntrusivePtr WithTag(Tag tag) const {
+        return TaggedIntrusivePtr(Get(), tag);
+    }
+
+    IntrusivePtr<T> ToIntrusive() const {
+        return IntrusivePtr<T>(Get());
+    }
+
+    // Pointer and tag are both equal.
+    bool operator==(const TaggedIntrusivePtr& other) const {
+        return word_ == other.word_;
+    }
+
+    static constexpr unsigned LowBits() {
+        return std::countr_zero(alignof(T));
+    }
+
+    static constexpr unsigned HighBits() {
+#if defined(__x86_64__)
+        return 16;
+#else
+        return 0;
+#endif
+    }
+
+private:
+    static constexpr unsigned kHighShift = 48;
+
+    static constexpr uintptr_t LowMask() {
+        return (uintptr_t{1} << std::min(Bits, LowBits())) - 1;
+    }
+
+    static constexpr uintptr_t PointerMask() {
+        uintptr_t mask = ~LowMask();
+        if constexpr (Bits > LowBits()) {
+            mask &= (uintptr_t{1} << kHighShift) - 1;
+        }
+        return mask;
+    }
+
+    static uintptr_t Pack(T* ptr, Tag tag) {
+        static_assert(Bits <= LowBits() + HighBits(), "not enough free bits in the pointer");
+        tag &= (Tag{1} << Bits) - 1;
+        auto word = reinterpret_cast<uintptr_t>(ptr) | (tag & LowMask());
+        if constexpr (Bits > LowBits()) {
+            word |= (tag >> LowBits()) << kHighShift;
+        }
+        return word;
+    }
+
+    static T* PointerOf(uintptr_t word) {
+        return reinterpret_cast<T*>(word & PointerMask());
+    }
+
+    static Tag TagOf(uintptr_t word) {
+        Tag tag = word & LowMask();
+        if constexpr (Bits > LowBits()) {
+            tag |= (word >> kHighShift) << LowBits();
+        }
+        return tag;
+    }
+
+    // Wraps a word whose reference is already counted.
+    static TaggedIntrusivePtr Adopt(uintptr_t word) {
+        TaggedIntrusivePtr res;
+        res.word_ = word;
+        return res;
+    }
+
+    uintptr_t Release() {
+        return std::exchange(word_, 0);
+    }
+
+    void IncRef() const {
+        if (T* ptr = Get()) {
+            ptr->IncRef();
+        }
+    }
+
+    void DecRef() const {
+        if (T* ptr = Get()) {
+            ptr->DecRef();
+        }
+    }
+
+    uintptr_t word_ = 0;
+};
+
+// Shared slot holding a TaggedIntrusivePtr that many threads load and swap.
+// T must use a thread-safe counter (AtomicRefCounted).
+//
+// Loading has to take a reference to an object that another thread may be
+// swapping out at the same time. Next to the tagged word the slot keeps the
+// number of loads in progress and an era that every swap increments; all three
+// change together with one 16-byte compare-and-swap (a spin lock where that is
+// not available). A loader announces itself, IncRefs the object and then takes
+// its announcement back; if the era moved on meanwhile, the swapper has already
+// turned the announcement into a reference, which the loader drops instead.
+template <typename T, unsigned Bits>
+class AtomicTaggedIntrusivePtr {
+    using Ptr = TaggedIntrusivePtr<T, Bits>;
+
+public:
+    AtomicTaggedIntrusivePtr() = default;
+
+    explicit AtomicTaggedIntrusivePtr(Ptr value) {
+        state_.word = value.Release();
+    }
+
+    AtomicTaggedIntrusivePtr(const AtomicTaggedIntrusivePtr&) = delete;
+    AtomicTaggedIntrusivePtr& operator=(const AtomicTaggedIntrusivePtr&) = delete;
+
+    ~AtomicTaggedIntrusivePtr() {
+        Ptr::Adopt(state_.word);
+    }
+
+    Ptr Load() const {
+        State current = Read();
+        while (true) {
+            if (!Ptr::PointerOf(current.word)) {
+                return Ptr::Adopt(current.word);
+            }
+            State announced = current;
+            ++announced.loads;
+            if (CompareAndSwap(current, announced)) {
+                break;
+            }
+        }
+        T* object = Ptr::PointerOf(current.word);
+        object->IncRef();
+
+        State expected = current;
+        ++expected.loads;
+        while (true) {
+            if (expected.era != current.era) {
+                object->DecRef();
+                break;
+            }
+            State withdrawn = expected;
+            --withdrawn.loads;
+            if (CompareAndSwap(expected, withdrawn)) {
+                break;
+            }
+        }
+        return Ptr::Adopt(current.word);
+    }
+
+    void Store(Ptr desired) {
+        Exchange(std::move(desired));
+    }
+
+    Ptr Exchange(Ptr desired) {
+        State current = Read();
+        while (!CompareAndSwap(current, State{desired.word_, 0, current.era + 1})) {
+        }
+        desired.Release();
+        return Retire(current);
+    }
+
+    // Compares pointer and tag. On failure `expected` receives the current value.
+    bool CompareExchange(Ptr& expected, const Ptr& desired) {
+        State current = Read();
+        while (current.word == expected.word_) {
+            if (CompareAndSwap(current, State{desired.word_, 0, current.era + 1})) {
+                Ptr(desired).Release();
+                Retire(current);
+                return true;
+            }
+        }
+        expected = Load();
+        return false;
+    }
+
+    static constexpr bool IsLockFree() {
+        return kDoubleWordCas;
+    }
+
+private:
+    struct alignas(16) State {
+        uintptr_t word;
+        uint32_t loads;
+        uint32_t era;
+    };
+
+#if defined(__x86_64__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_16)
+    static constexpr bool kDoubleWordCas = true;
+    __extension__ typedef unsigned __int128 DoubleWord;
+
+    bool CompareAndSwap(State& expected, State desired) const {
+        DoubleWord old_value;
+        DoubleWord new_value;
+        std::memcpy(&old_value, &expected, sizeof(State));
+        std::memcpy(&new_value, &desired, sizeof(State));
+        DoubleWord seen =
+            __sync_val_compare_and_swap(reinterpret_cast<DoubleWord*>(&state_), old_value, new_value);
+        if (seen == old_value) {
+            return true;
+        }
+        std::memcpy(&expected, &seen, sizeof(State));
+        return false;
+    }
+#else
+    static constexpr bool kDoubleWordCas = false;
+
+    bool CompareAndSwap(State& expected, State desired) const {
+        while (lock_.test_and_set(std::memory_order_acquire)) {
+        }
+        bool equal = std::memcmp(&state_, &expected, sizeof(State)) == 0;
+        if (equal) {
+            state_ = desired;
+        } else {
+            expected = state_;
+        }
+        lock_.clear(std::memory_order_release);
+        return equal;
+    }
+
+    mutable std::atomic_flag lock_ = ATOMIC_FLAG_INIT;
+#endif
+
+    // A failing compare-and-swap is an atomic read.
+    State Read() const {
+        State state{};
+        CompareAndSwap(state, state);
+        return state;
+    }
+
+    // Turns announced loads of a swapped-out value into references and returns
+    // the slot's own reference.
+    static Ptr Retire(const State& old) {
+        if (T* object = Ptr::PointerOf(old.word)) {
+            for (uint32_t i = 0; i < old.loads; ++i) {
+                object->IncRef();
+            }
+        }
+        return Ptr::Adopt(old.word);
+    }
+
+    mutable State state_{};
+};
@@ -1,5 +1,8 @@
 #include "intrusive.h"
 
+#include <common/arena.h>
+#include <common/c_handle.h>
+
 #include <catch.hpp>
 
 #include "allocations_checker.h"
@@ -110,6 +113,65 @@ TEST_CASE("Conversions") {
     REQUIRE(foo->Kek() == 42);
 }
 
+// Counts every reference count operation.
+class CountingCounter : public SimpleCounter {
+public:
+    size_t IncRef() {
+        ++ops;
+        return SimpleCounter::IncRef();
+    }
+    size_t DecRef() {
+        ++ops;
+        return SimpleCounter::DecRef();
+    }
+
+    static inline size_t ops = 0;
+};
+
+TEST_CASE("Pointer casts") {
+    struct Base : RefCounted<Base, CountingCounter, DefaultDelete> {
+        virtual ~Base() = default;
+    };
+    struct Derived : Base {
+        int value = 5;
+    };
+    struct Other : Base {};
+
+    IntrusivePtr<Base> base = MakeIntrusive<Derived>();
+
+    SECTION("Copying casts") {
+        auto ops = CountingCounter::ops;
+        auto derived = StaticPointerCast<Derived>(base);
+        REQUIRE(derived->value == 5);
+        REQUIRE(base.UseCount() == 2);
+        REQUIRE(CountingCounter::ops == ops + 1);
+
+        REQUIRE(DynamicPointerCast<Derived>(base).Get() == derived.Get());
+        REQUIRE(!DynamicPointerCast<Other>(base));
+        REQUIRE(ReinterpretPointerCast<Base>(derived).Get() == base.Get());
+    }
+
+    SECTION("Moving casts do not touch the counter") {
+        auto ops = CountingCounter::ops;
+        auto derived = StaticPointerCast<Derived>(std::move(base));
+        REQUIRE(!base);
+        REQUIRE(derived.UseCount() == 1);
+
+        auto failed = DynamicPointerCast<Other>(std::move(derived));
+        REQUIRE(!failed);
+        REQUIRE(derived);
+
+        auto back = DynamicPointerCast<Base>(std::move(derived));
+        REQUIRE(!derived);
+        auto same = ReinterpretPointerCast<Base>(std::move(back));
+        REQUIRE(!back);
+        auto again = ConstPointerCast<Base>(std::move(same));
+        REQUIRE(!same);
+        REQUIRE(again.UseCount() == 1);
+        REQUIRE(CountingCounter::ops == ops);
+    }
+}
+
 template <typename T>
 class ObjectCounters {
 public:
@@ -397,3 +459,157 @@ TEST_CASE("Object pool") {
         REQUIRE(strs.NumInUse() == 1);
     }
 }
+
+struct ListNode : SimpleRefCounted<ListNode> {
+    ListNode(int value) : value{value} {
+    }
+
+    int value;
+    IntrusivePtr<ListNode> next;
+    std::vector<IntrusivePtr<ListNode>> children;
+};
+
+TEST_CASE("Prefetching traversals") {
+    SECTION("List") {
+        IntrusivePtr<ListNode> head;
+        for (int i = 100; i > 0; --i) {
+            auto node = MakeIntrusive<ListNode>(i);
+            node->next = std::move(head);
+            head = std::move(node);
+        }
+        head.Prefetch<PrefetchMode::kWrite, PrefetchLocality::kLow>();
+
+        std::vector<int> visited;
+        ForEachPrefetched<4>(head.Get(), [](ListNode* node) { return node->next.Get(); },
+                             [&visited](ListNode* node) { visited.push_back(node->value); });
+        REQUIRE(visited.size() == 100);
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(visited[i] == i + 1);
+        }
+
+        int short_list_sum = 0;
+        ForEachPrefetched<16>(head->next->next->next->next.Get(),
+                              [](ListNode* node) { return node->next.Get(); },
+                              [&short_list_sum](ListNode* node) { short_list_sum += node->value; });
+        REQUIRE(short_list_sum == 5050 - 10);
+
+        while (head) {
+            auto next = std::move(head->next);
+            head = std::move(next);
+        }
+    }
+
+    SECTION("Range of pointers") {
+        std::vector<IntrusivePtr<MyInt>> values;
+        for (int i = 0; i < 20; ++i) {
+            values.push_back(MakeIntrusive<MyInt>(i));
+        }
+        int sum = 0;
+        for (const auto& value : PrefetchAhead<3>(values)) {
+            sum += value->value;
+        }
+        REQUIRE(sum == 190);
+
+        MyInt* raw[20];
+        for (int i = 0; i < 20; ++i) {
+            raw[i] = values[i].Get();
+        }
+        auto view = PrefetchAhead<3>(raw);
+        sum = 0;
+        for (auto it = view.begin(); it != view.end(); ++it) {
+            REQUIRE(it.operator->() == &*it);
+            sum += (*it)->value;
+        }
+        REQUIRE(sum == 190);
+    }
+
+    SECTION("Tree levels") {
+        auto root = MakeIntrusive<ListNode>(0);
+        for (int i = 1; i <= 3; ++i) {
+            root->children.push_back(MakeIntrusive<ListNode>(i));
+            for (int j = 1; j <= 2; ++j) {
+                root->children.back()->children.push_back(MakeIntrusive<ListNode>(i * 10 + j));
+            }
+        }
+        std::vector<int> order;
+        ForEachLevelPrefetched(
+            std::vector<ListNode*>{root.Get()},
+            [](ListNode* node, std::vector<ListNode*>& out) {
+                for (const auto& child : node->children) {
+                    out.push_back(child.Get());
+                }
+            },
+            [&order](ListNode* node) { order.push_back(node->value); });
+        REQUIRE(order == std::vector<int>{0, 1, 2, 3, 11, 12, 21, 22, 31, 32});
+    }
+}
+
+struct ArenaInt : RefCounted<ArenaInt, SimpleCounter, ArenaDelete>, ObjectCounters<ArenaInt> {
+    ArenaInt(int value) : value{value} {
+    }
+
+    int value;
+};
+
+TEST_CASE("Arena allocation") {
+    HugePageArena arena;
+    ArenaInt::ResetCounters();
+    {
+        ArenaScope scope(arena);
+        IntrusivePtr<ArenaInt> a;
+        arena.Allocate(1);  // the first chunk
+        EXPECT_ZERO_ALLOCATIONS(a = MakeIntrusive<ArenaInt>(1));
+        auto b = MakeIntrusive<ArenaInt>(2);
+        REQUIRE(a->value + b->value == 3);
+        REQUIRE(arena.ChunkCount() == 1);
+        REQUIRE(ArenaInt::NumAlive() == 2);
+    }
+    REQUIRE(ArenaInt::NumAlive() == 0);
+}
+
+TEST_CASE("External reference counting") {
+    using Traits = ExternalRefTraits<&c_handle_ref, &c_handle_unref, &c_handle_refcount>;
+    using Handle = IntrusivePtr<c_handle, Traits>;
+
+    SECTION("Copies use the library's counter") {
+        {
+            Handle a = AdoptIntrusive<Traits>(c_handle_new(5));
+            REQUIRE(a.UseCount() == 1);
+            Handle b;
+            EXPECT_ZERO_ALLOCATIONS(b = a);
+            REQUIRE(a->refs == 2);
+            REQUIRE(b.UseCount() == 2);
+            Handle c(std::move(b));
+            REQUIRE(c.UseCount() == 2);
+            REQUIRE(c->value == 5);
+        }
+        REQUIRE(c_handles_alive == 0);
+    }
+
+    SECTION("Raw pointers add a reference") {
+        c_handle* raw = c_handle_new(1);
+        {
+            Handle handle(raw);
+            REQUIRE(raw->refs == 2);
+        }
+        REQUIRE(raw->refs == 1);
+        c_handle_unref(raw);
+        REQUIRE(c_handles_alive == 0);
+    }
+
+    SECTION("Casts keep the traits") {
+        Handle a = AdoptIntrusive<Traits>(c_handle_new(2));
+        IntrusivePtr<const c_handle, Traits> b = ConstPointerCast<const c_handle>(a);
+        REQUIRE(b.UseCount() == 2);
+        auto c = ConstPointerCast<c_handle>(std::move(b));
+        REQUIRE(c.UseCount() == 2);
+        REQUIRE(!b);
+    }
+
+    SECTION("Count is optional") {
+        using NoCount = ExternalRefTraits<&c_handle_ref, &c_handle_unref>;
+        IntrusivePtr<c_handle, NoCount> handle = AdoptIntrusive<NoCount>(c_handle_new(3));
+        auto copy = handle;
+        REQUIRE(handle->refs == 2);
+    }
+}
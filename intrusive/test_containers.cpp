@@ -0,0 +1,186 @@
+#include "hash_set.h"
+#include "list.h"
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <cstdint>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct ByAge;
+struct ById;
+
+struct Session : SimpleRefCounted<Session>, ListHook<ByAge>, HashSetHook<ById> {
+    explicit Session(uint64_t id) : id(id) {
+        ++alive;
+    }
+    Session(const Session& other) : Session(other.id) {
+    }
+    ~Session() {
+        --alive;
+    }
+
+    uint64_t id = 0;
+    static inline int alive = 0;
+};
+
+using SessionList = IntrusiveList<Session, ByAge>;
+using SessionSet = IntrusiveHashSet<Session, &Session::id, ById>;
+
+std::vector<uint64_t> Ids(const SessionList& list) {
+    std::vector<uint64_t> ids;
+    for (const auto& session : list) {
+        ids.push_back(session.id);
+    }
+    return ids;
+}
+
+}  // namespace
+
+TEST_CASE("IntrusiveList") {
+    SECTION("Links and unlinks without allocations") {
+        std::vector<IntrusivePtr<Session>> sessions;
+        for (uint64_t id = 0; id < 4; ++id) {
+            sessions.push_back(MakeIntrusive<Session>(id));
+        }
+        SessionList list;
+        EXPECT_ZERO_ALLOCATIONS({
+            list.PushBack(sessions[1]);
+            list.PushBack(sessions[2]);
+            list.PushFront(sessions[0]);
+            list.InsertBefore(list.end(), sessions[3]);
+        });
+        REQUIRE(list.Size() == 4);
+        REQUIRE(Ids(list) == std::vector<uint64_t>{0, 1, 2, 3});
+        REQUIRE(sessions[2].UseCount() == 2);
+
+        IntrusivePtr<Session> erased;
+        EXPECT_ZERO_ALLOCATIONS(erased = list.Erase(*sessions[2]));
+        REQUIRE(erased.Get() == sessions[2].Get());
+        REQUIRE(!SessionList::IsLinked(*sessions[2]));
+        REQUIRE(Ids(list) == std::vector<uint64_t>{0, 1, 3});
+
+        list.MoveToFront(*sessions[3]);
+        list.MoveToBack(*sessions[0]);
+        REQUIRE(Ids(list) == std::vector<uint64_t>{3, 1, 0});
+        REQUIRE(sessions[3].UseCount() == 2);
+        REQUIRE(list.Front().id == 3);
+        REQUIRE(list.Back().id == 0);
+        REQUIRE((--list.end())->id == 0);
+    }
+
+    SECTION("The list owns its elements") {
+        {
+            SessionList list;
+            list.PushBack(MakeIntrusive<Session>(1));
+            list.PushBack(MakeIntrusive<Session>(2));
+            REQUIRE(Session::alive == 2);
+            REQUIRE(list.PopFront()->id == 1);
+            REQUIRE(Session::alive == 1);
+        }
+        REQUIRE(Session::alive == 0);
+    }
+
+    SECTION("Copies are not linked") {
+        SessionList list;
+        auto session = MakeIntrusive<Session>(1);
+        list.PushBack(session);
+        Session copy = *session;
+        REQUIRE(SessionList::IsLinked(*session));
+        REQUIRE(!SessionList::IsLinked(copy));
+        REQUIRE(copy.RefCount() == 0);
+    }
+}
+
+TEST_CASE("IntrusiveHashSet") {
+    SECTION("Insert, find and erase") {
+        SessionSet set;
+        for (uint64_t id = 0; id < 100; ++id) {
+            REQUIRE(set.Insert(MakeIntrusive<Session>(id * 8)));
+        }
+        REQUIRE(!set.Insert(MakeIntrusive<Session>(16)));
+        REQUIRE(set.Size() == 100);
+        REQUIRE(Session::alive == 100);
+        REQUIRE(set.Find(16)->id == 16);
+        REQUIRE(!set.Find(17));
+
+        for (uint64_t id = 0; id < 100; id += 2) {
+            REQUIRE(set.Erase(id * 8)->id == id * 8);
+        }
+        REQUIRE(!set.Erase(uint64_t{0}));
+        REQUIRE(set.Size() == 50);
+        REQUIRE(Session::alive == 50);
+        for (uint64_t id = 0; id < 100; ++id) {
+            REQUIRE(set.Contains(id * 8) == (id % 2 == 1));
+        }
+
+        uint64_t sum = 0;
+        for (const auto& session : set) {
+            sum += session.id;
+        }
+        REQUIRE(sum == 8 * 50 * 50);
+    }
+
+    SECTION("Erase by element keeps probe runs intact") {
+        // Every key lands in the same home slot.
+        struct Collide {
+            size_t operator()(uint64_t) const {
+                return 3;
+            }
+        };
+        using Colliding = IntrusiveHashSet<Session, &Session::id, ById, Collide>;
+        std::vector<IntrusivePtr<Session>> sessions;
+        Colliding set;
+        for (uint64_t id = 0; id < 5; ++id) {
+            sessions.push_back(MakeIntrusive<Session>(id));
+            set.Insert(sessions.back());
+        }
+        set.Erase(*sessions[1]);
+        set.Erase(*sessions[3]);
+        REQUIRE(!Colliding::IsLinked(*sessions[1]));
+        REQUIRE(Colliding::IsLinked(*sessions[2]));
+        for (uint64_t id = 0; id < 5; ++id) {
+            REQUIRE(set.Contains(id) == (id % 2 == 0));
+        }
+        REQUIRE(sessions[0].UseCount() == 2);
+        REQUIRE(sessions[1].UseCount() == 1);
+    }
+
+    SECTION("No allocations once reserved") {
+        std::vector<IntrusivePtr<Session>> sessions;
+        for (uint64_t id = 0; id < 1000; ++id) {
+            sessions.push_back(MakeIntrusive<Session>(id));
+        }
+        SessionSet set;
+        set.Reserve(sessions.size());
+        EXPECT_ZERO_ALLOCATIONS({
+            for (const auto& session : sessions) {
+                set.Insert(session);
+            }
+            for (const auto& session : sessions) {
+                set.Erase(*session);
+            }
+        });
+        REQUIRE(set.Empty());
+    }
+
+    SECTION("One element in a list and a set") {
+        SessionList list;
+        SessionSet set;
+        {
+            auto session = MakeIntrusive<Session>(7);
+            list.PushBack(session);
+            set.Insert(session);
+        }
+        REQUIRE(list.Front().RefCount() == 2);
+        list.Erase(*set.Find(7));
+        REQUIRE(Session::alive == 1);
+        set.Clear();
+        REQUIRE(Session::alive == 0);
+    }
+}
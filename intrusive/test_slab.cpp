@@ -0,0 +1,89 @@
+#include "intrusive.h"
+#include "slab.h"
+
+#include <catch.hpp>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+struct SlabInt : SlabRefCounted<SlabInt> {
+    SlabInt(int value) : value{value} {
+    }
+
+    int value = 0;
+};
+
+TEST_CASE("Slab allocation") {
+    auto& slab = SlabAllocatorFor<SlabInt>::Instance();
+    slab.Flush();
+    REQUIRE(slab.Stats().in_use == 0);
+
+    SECTION("Objects live in one slab") {
+        auto a = MakeIntrusive<SlabInt>(1);
+        auto b = MakeIntrusive<SlabInt>(2);
+        REQUIRE(a->value == 1);
+        REQUIRE(b->value == 2);
+        REQUIRE(slab.Stats().slabs == 1);
+        REQUIRE(std::abs(reinterpret_cast<char*>(b.Get()) - reinterpret_cast<char*>(a.Get())) == 16);
+
+        SlabInt* old = a.Get();
+        a.Reset();
+        auto c = MakeIntrusive<SlabInt>(3);
+        REQUIRE(c.Get() == old);
+        REQUIRE(slab.Stats().slabs == 1);
+    }
+
+    SECTION("Empty slabs are released") {
+        const size_t count = 3 * SlabAllocatorFor<SlabInt>::kSlotsPerSlab;
+        std::vector<IntrusivePtr<SlabInt>> values;
+        for (size_t i = 0; i < count; ++i) {
+            values.push_back(MakeIntrusive<SlabInt>(static_cast<int>(i)));
+        }
+        slab.Flush();
+        REQUIRE(slab.Stats().slabs == 3);
+        REQUIRE(slab.Stats().Fragmentation() == 0.0);
+
+        for (size_t i = 0; i < count; i += 2) {
+            values[i].Reset();
+        }
+        slab.Flush();
+        REQUIRE(slab.Stats().slabs == 3);
+        REQUIRE(slab.Stats().Fragmentation() == Approx(0.5).margin(0.01));
+
+        values.clear();
+        slab.Flush();
+        REQUIRE(slab.Stats().slabs == 0);
+    }
+
+    slab.Flush();
+    REQUIRE(slab.Stats().in_use == 0);
+}
+
+TEST_CASE("Slab allocation of derived types") {
+    struct Base : SlabRefCounted<Base> {
+        virtual ~Base() = default;
+        virtual std::string Name() const = 0;
+    };
+
+    struct Derived : Base {
+        Derived(std::string name) : name{std::move(name)} {
+        }
+
+        std::string Name() const override {
+            return name;
+        }
+
+        std::string name;
+    };
+
+    auto& slab = SlabAllocatorFor<Derived>::Instance();
+    IntrusivePtr<Base> base = MakeIntrusive<Derived>("derived");
+    REQUIRE(base->Name() == "derived");
+    base.Reset();
+    slab.Flush();
+    REQUIRE(slab.Stats().in_use == 0);
+    REQUIRE(slab.Stats().slabs == 0);
+}
@@ -0,0 +1,90 @@
+#include "shared_string.h"
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+TEMPLATE_TEST_CASE("SharedString", "", SharedString, AtomicSharedString) {
+    const std::string long_text(100, 'x');
+
+    SECTION("Small strings stay inline") {
+        STATIC_REQUIRE(sizeof(TestType) == 16);
+        TestType empty;
+        REQUIRE(empty.Empty());
+        REQUIRE(*empty.Data() == '\0');
+
+        TestType str;
+        EXPECT_ZERO_ALLOCATIONS(str = TestType("fifteen chars!!"));
+        REQUIRE(str.IsInline());
+        REQUIRE(str.Size() == 15);
+        REQUIRE(str.View() == "fifteen chars!!");
+        REQUIRE(str.Data()[15] == '\0');
+
+        TestType copy;
+        EXPECT_ZERO_ALLOCATIONS(copy = str);
+        REQUIRE(copy == str);
+        REQUIRE(copy.UseCount() == 0);
+    }
+
+    SECTION("Long strings share one allocation") {
+        TestType str;
+        EXPECT_ONE_ALLOCATION(str = TestType(long_text));
+        REQUIRE(!str.IsInline());
+        REQUIRE(str.View() == long_text);
+        REQUIRE(std::string_view(str.Data()).size() == 100);
+
+        TestType copy;
+        EXPECT_ZERO_ALLOCATIONS(copy = str);
+        REQUIRE(str.UseCount() == 2);
+        REQUIRE(copy.Data() == str.Data());
+
+        TestType moved(std::move(copy));
+        REQUIRE(copy.Empty());
+        REQUIRE(str.UseCount() == 2);
+        moved = TestType("short");
+        REQUIRE(str.UseCount() == 1);
+    }
+
+    SECTION("Hash and comparisons") {
+        TestType small("abc");
+        TestType big(long_text);
+        REQUIRE(small.Hash() == std::hash<std::string_view>{}("abc"));
+        REQUIRE(big.Hash() == std::hash<std::string_view>{}(long_text));
+        REQUIRE(std::hash<TestType>{}(big) == big.Hash());
+
+        REQUIRE(big == TestType(long_text));
+        REQUIRE(big != TestType(long_text + "y"));
+        REQUIRE(small == "abc");
+        REQUIRE(small < TestType("abd"));
+        REQUIRE(TestType("abc") < big);
+
+        std::unordered_set<TestType> set = {small, big, TestType("abc")};
+        REQUIRE(set.size() == 2);
+        REQUIRE(set.count(TestType(long_text)));
+    }
+}
+
+TEST_CASE("AtomicSharedString across threads") {
+    AtomicSharedString str(std::string(64, 'a'));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([str] {
+            for (int j = 0; j < 10000; ++j) {
+                AtomicSharedString copy = str;
+                (void)copy;
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(str.UseCount() == 1);
+}
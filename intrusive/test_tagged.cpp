@@ -0,0 +1,239 @@
+#include "lock_free.h"
+#include "tagged.h"
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct alignas(8) Item : AtomicRefCounted<Item> {
+    explicit Item(int value) : value(value) {
+        ++alive;
+    }
+    ~Item() {
+        --alive;
+    }
+
+    int value = 0;
+    static inline std::atomic<int> alive = 0;
+};
+
+}  // namespace
+
+TEST_CASE("TaggedIntrusivePtr") {
+    SECTION("Sizeof") {
+        STATIC_REQUIRE(sizeof(TaggedIntrusivePtr<Item, 3>) == sizeof(void*));
+        STATIC_REQUIRE(sizeof(TaggedIntrusivePtr<Item, 19>) == sizeof(void*));
+        STATIC_REQUIRE(TaggedIntrusivePtr<Item, 1>::LowBits() == 3);
+    }
+
+    SECTION("Tags in low and high bits") {
+        auto item = MakeIntrusive<Item>(5);
+        TaggedIntrusivePtr<Item, 19> ptr(item, 0x5A5A5);
+        REQUIRE(ptr.Get() == item.Get());
+        REQUIRE(ptr.GetTag() == 0x5A5A5);
+        REQUIRE(ptr->value == 5);
+
+        ptr.SetTag(0x7FFFF);
+        REQUIRE(ptr.Get() == item.Get());
+        REQUIRE(ptr.GetTag() == 0x7FFFF);
+
+        // Only `Bits` bits are kept.
+        ptr.SetTag(0x80001);
+        REQUIRE(ptr.GetTag() == 1);
+
+        TaggedIntrusivePtr<Item, 19> null(nullptr);
+        REQUIRE(!null);
+        null.SetTag(3);
+        REQUIRE(!null);
+        REQUIRE(null.GetTag() == 3);
+    }
+
+    SECTION("Reference counting") {
+        {
+            auto item = MakeIntrusive<Item>(1);
+            TaggedIntrusivePtr<Item, 2> a(item, 1);
+            REQUIRE(item.UseCount() == 2);
+            auto b = a.WithTag(2);
+            REQUIRE(item.UseCount() == 3);
+            REQUIRE(!(a == b));
+            b.SetTag(1);
+            REQUIRE(a == b);
+
+            TaggedIntrusivePtr<Item, 2> c(std::move(item), 3);
+            REQUIRE(!item);
+            REQUIRE(c.UseCount() == 3);
+            a = c;
+            REQUIRE(a.GetTag() == 3);
+            REQUIRE(c.UseCount() == 3);
+            b.Reset();
+            REQUIRE(c.UseCount() == 2);
+            REQUIRE(c.ToIntrusive().UseCount() == 3);
+        }
+        REQUIRE(Item::alive == 0);
+    }
+}
+
+TEST_CASE("AtomicTaggedIntrusivePtr") {
+    using Ptr = TaggedIntrusivePtr<Item, 4>;
+
+    SECTION("Load, store and exchange") {
+        {
+            AtomicTaggedIntrusivePtr<Item, 4> slot(Ptr(new Item(1), 2));
+            auto loaded = slot.Load();
+            REQUIRE(loaded->value == 1);
+            REQUIRE(loaded.GetTag() == 2);
+            REQUIRE(loaded.UseCount() == 2);
+
+            auto old = slot.Exchange(Ptr(new Item(2), 3));
+            REQUIRE(old == loaded);
+            REQUIRE(old.UseCount() == 2);
+            REQUIRE(slot.Load()->value == 2);
+
+            slot.Store({});
+            REQUIRE(!slot.Load());
+            REQUIRE(Item::alive == 1);
+        }
+        REQUIRE(Item::alive == 0);
+    }
+
+    SECTION("Compare exchange looks at the tag") {
+        {
+            Ptr item(new Item(1), 1);
+            AtomicTaggedIntrusivePtr<Item, 4> slot(item);
+
+            Ptr expected = item.WithTag(2);
+            REQUIRE(!slot.CompareExchange(expected, item.WithTag(3)));
+            REQUIRE(expected == item);
+
+            REQUIRE(slot.CompareExchange(expected, item.WithTag(3)));
+            REQUIRE(slot.Load().GetTag() == 3);
+            REQUIRE(item.UseCount() == 3);
+        }
+        REQUIRE(Item::alive == 0);
+    }
+
+    SECTION("Concurrent loads and exchanges") {
+        constexpr int kThreads = 4;
+        constexpr int kIterations = 20'000;
+        {
+            AtomicTaggedIntrusivePtr<Item, 4> slot(Ptr(new Item(0)));
+            std::atomic<int> failures = 0;
+            std::vector<std::thread> threads;
+            for (int t = 0; t < kThreads; ++t) {
+                threads.emplace_back([&, t] {
+                    for (int i = 0; i < kIterations; ++i) {
+                        if (t % 2) {
+                            slot.Store(Ptr(new Item(i), i));
+                        } else if (auto loaded = slot.Load(); !loaded || loaded->value % 16 != int(loaded.GetTag())) {
+                            ++failures;
+                        }
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            REQUIRE(failures == 0);
+            REQUIRE(slot.Load().UseCount() == 2);
+        }
+        REQUIRE(Item::alive == 0);
+    }
+}
+
+TEST_CASE("TreiberStack") {
+    SECTION("LIFO") {
+        TreiberStack<int> stack;
+        REQUIRE(stack.Empty());
+        for (int i = 0; i < 3; ++i) {
+            stack.Push(i);
+        }
+        REQUIRE(*stack.Pop() == 2);
+        REQUIRE(*stack.Pop() == 1);
+        REQUIRE(*stack.Pop() == 0);
+        REQUIRE(!stack.Pop());
+    }
+
+    SECTION("Long chains are freed") {
+        TreiberStack<int> stack;
+        for (int i = 0; i < 1'000'000; ++i) {
+            stack.Push(i);
+        }
+    }
+
+    SECTION("Concurrent push and pop") {
+        constexpr int kThreads = 4;
+        constexpr int kIterations = 10'000;
+        TreiberStack<int64_t> stack;
+        std::atomic<int64_t> popped = 0;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&] {
+                for (int i = 1; i <= kIterations; ++i) {
+                    stack.Push(i);
+                    if (auto value = stack.Pop()) {
+                        popped += *value;
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        while (auto value = stack.Pop()) {
+            popped += *value;
+        }
+        REQUIRE(popped == int64_t{kThreads} * kIterations * (kIterations + 1) / 2);
+    }
+}
+
+TEST_CASE("HarrisList") {
+    SECTION("Set operations") {
+        HarrisList<int> list;
+        REQUIRE(list.Insert(5));
+        REQUIRE(list.Insert(1));
+        REQUIRE(list.Insert(3));
+        REQUIRE(!list.Insert(3));
+        REQUIRE(list.Contains(1));
+        REQUIRE(list.Contains(3));
+        REQUIRE(!list.Contains(4));
+        REQUIRE(list.Erase(3));
+        REQUIRE(!list.Erase(3));
+        REQUIRE(!list.Contains(3));
+        REQUIRE(list.Contains(5));
+    }
+
+    SECTION("Concurrent inserts and erases") {
+        constexpr int kThreads = 4;
+        constexpr int kKeys = 512;
+        HarrisList<int> list;
+        std::atomic<int> balance = 0;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&, t] {
+                for (int round = 0; round < 10; ++round) {
+                    for (int key = t; key < kKeys; key += 2) {
+                        balance += list.Insert(key);
+                    }
+                    for (int key = t; key < kKeys; key += 3) {
+                        balance -= list.Erase(key);
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        int present = 0;
+        for (int key = 0; key < kKeys; ++key) {
+            present += list.Contains(key);
+        }
+        REQUIRE(present == balance);
+    }
+}
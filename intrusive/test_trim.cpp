@@ -0,0 +1,190 @@
+#include <common/arena.h>
+#include <common/slab.h>
+#include <common/trim.h>
+
+#include <catch.hpp>
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+using namespace std::chrono_literals;
+
+// A size class no other test uses
+using Slab = SlabAllocator<208, 16>;
+
+struct FakePool : Trimmable {
+    size_t Trim(Clock::duration idle) override {
+        calls.push_back(idle);
+        return idle == Clock::duration::zero() ? 100 : 0;
+    }
+
+    std::vector<Clock::duration> calls;
+};
+
+class FakePressureFile {
+public:
+    FakePressureFile()
+        : path_(std::filesystem::temp_directory_path() / ("memory_pressure." + std::to_string(getpid()))) {
+    }
+
+    ~FakePressureFile() {
+        std::filesystem::remove(path_);
+    }
+
+    void Write(double some_avg10) {
+        std::ofstream(path_) << "some avg10=" << some_avg10 << " avg60=0.00 avg300=0.00 total=0\n"
+                             << "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n";
+    }
+
+    std::string Path() const {
+        return path_.string();
+    }
+
+private:
+    std::filesystem::path path_;
+};
+
+}  // namespace
+
+TEST_CASE("Slab trimming") {
+    auto& slab = Slab::Instance();
+    const SlabStats before = slab.Stats();
+
+    std::vector<void*> slots;
+    for (size_t i = 0; i < 2 * Slab::kSlotsPerSlab; ++i) {
+        slots.push_back(slab.Allocate());
+    }
+    slab.Flush();
+    REQUIRE(slab.Stats().slabs == before.slabs + 2);
+    const size_t misses = slab.Stats().misses;
+    REQUIRE(misses >= before.misses + 2);
+
+    slab.SetCachedSlabLimit(1);
+    for (void* slot : slots) {
+        SlabAllocatorBase::Free(slot);
+    }
+    slab.Flush();
+    REQUIRE(slab.Stats().slabs == before.slabs);
+    REQUIRE(slab.Stats().cached == 1);
+
+    SECTION("Cached slabs are reused") {
+        void* slot = slab.Allocate();
+        REQUIRE(slab.Stats().hits == before.hits + 1);
+        REQUIRE(slab.Stats().misses == misses);
+        REQUIRE(slab.Stats().cached == 0);
+        SlabAllocatorBase::Free(slot);
+        slab.Flush();
+        REQUIRE(slab.Stats().cached == 1);
+    }
+
+    SECTION("Trim releases slabs idle for long enough") {
+        REQUIRE(slab.Trim(1h) == 0);
+        REQUIRE(slab.Stats().cached == 1);
+        REQUIRE(slab.Trim(0s) == SlabAllocatorBase::kSlabBytes);
+        REQUIRE(slab.Stats().cached == 0);
+        REQUIRE(slab.Stats().trimmed == before.trimmed + 1);
+    }
+
+    slab.SetCachedSlabLimit(0);
+    REQUIRE(slab.Stats().cached == 0);
+    REQUIRE(slab.Stats().in_use == before.in_use);
+}
+
+TEST_CASE("Arena trimming") {
+    HugePageArena arena;
+    auto* first = static_cast<char*>(arena.Allocate(100));
+    std::memset(first, 1, 100);
+
+    size_t released = arena.Trim(0s);
+    if (arena.HugePageChunkCount()) {
+        REQUIRE(released > 0);
+        REQUIRE(released < HugePageArena::kChunkBytes);
+    } else {
+        REQUIRE(released == 0);
+    }
+    REQUIRE(arena.TrimmedBytes() == released);
+    REQUIRE(arena.Trim(0s) == 0);
+    REQUIRE(first[99] == 1);
+
+    // The released pages can be allocated again.
+    auto* second = static_cast<char*>(arena.Allocate(1 << 16));
+    std::memset(second, 2, 1 << 16);
+    REQUIRE(second[(1 << 16) - 1] == 2);
+    REQUIRE(arena.Trim(1h) == 0);
+}
+
+TEST_CASE("Memory trimmer") {
+    FakePressureFile pressure;
+    FakePool pool;
+    TrimOptions options;
+    options.idle = 1h;
+    options.period = 1ms;
+    options.pressure_percent = 10;
+    options.pressure_path = pressure.Path();
+
+    SECTION("Trims idle memory without pressure") {
+        pressure.Write(0.5);
+        MemoryTrimmer trimmer(options);
+        trimmer.Add(pool);
+        REQUIRE(!trimmer.Poll());
+        REQUIRE(pool.calls == std::vector<Trimmable::Clock::duration>{1h});
+        REQUIRE(trimmer.Stats().checks == 1);
+        REQUIRE(trimmer.Stats().pressure_trims == 0);
+        REQUIRE(trimmer.Stats().bytes_released == 0);
+    }
+
+    SECTION("Trims everything under pressure") {
+        pressure.Write(25);
+        MemoryTrimmer trimmer(options);
+        trimmer.Add(pool);
+        REQUIRE(trimmer.Poll());
+        REQUIRE(pool.calls.back() == Trimmable::Clock::duration::zero());
+        REQUIRE(trimmer.Stats().pressure_trims == 1);
+        REQUIRE(trimmer.Stats().bytes_released == 100);
+
+        pressure.Write(9.99);
+        REQUIRE(!trimmer.Poll());
+        trimmer.Remove(pool);
+        trimmer.Poll();
+        REQUIRE(pool.calls.size() == 2);
+    }
+
+    SECTION("No pressure information") {
+        options.pressure_path = pressure.Path() + ".missing";
+        MemoryTrimmer trimmer(options);
+        REQUIRE(!trimmer.UnderPressure());
+    }
+
+    SECTION("RSS limit") {
+        pressure.Write(0);
+        options.rss_limit = 1;
+        MemoryTrimmer trimmer(options);
+        REQUIRE(trimmer.UnderPressure());
+    }
+
+    SECTION("Background checks") {
+        pressure.Write(50);
+        MemoryTrimmer trimmer(options);
+        trimmer.Add(pool);
+        trimmer.Start();
+        for (int i = 0; i < 1000 && trimmer.Stats().pressure_trims < 2; ++i) {
+            std::this_thread::sleep_for(1ms);
+        }
+        trimmer.Stop();
+        REQUIRE(trimmer.Stats().pressure_trims >= 2);
+        size_t checks = trimmer.Stats().checks;
+        std::this_thread::sleep_for(5ms);
+        REQUIRE(trimmer.Stats().checks == checks);
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "shared.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+// Shared object that is built by `factory` on first dereference.
+// Once constructed, every access is a single acquire load. Concurrent first
+// callers wait on the state word (futex on Linux) instead of building twice.
+// Dereferencing is thread-safe; copies of `Get()` follow the usual SharedPtr rules.
+template <typename T, typename Factory = std::function<T()>>
+class LazySharedPtr {
+public:
+    explicit LazySharedPtr(Factory factory) : factory_(std::move(factory)) {
+    }
+
+    LazySharedPtr(const LazySharedPtr&) = delete;
+    LazySharedPtr& operator=(const LazySharedPtr&) = delete;
+
+    ~LazySharedPtr() = default;
+
+    const SharedPtr<T>& Get() const {
+        if (state_.load(std::memory_order_acquire) != kReady) {
+            Construct();
+        }
+        return value_;
+    }
+
+    T& operator*() const {
+        return *Get();
+    }
+
+    T* operator->() const {
+        return Get().Get();
+    }
+
+    bool IsConstructed() const {
+        return state_.load(std::memory_order_acquire) == kReady;
+    }
+
+private:
+    enum State : uint32_t { kEmpty, kBusy, kReady };
+
+    void Construct() const {
+        uint32_t state = kEmpty;
+        while (!state_.compare_exchange_weak(state, kBusy, std::memory_order_acquire)) {
+            if (state == kReady) {
+                return;
+            }
+            if (state == kBusy) {
+                state_.wait(kBusy, std::memory_order_acquire);
+            }
+            state = kEmpty;
+        }
+        try {
+            value_ = MakeShared<T>(factory_());
+        } catch (...) {
+            state_.store(kEmpty, std::memory_order_release);
+            state_.notify_all();
+            throw;
+        }
+        state_.store(kReady, std::memory_order_release);
+        state_.notify_all();
+    }
+
+    mutable std::atomic<uint32_t> state_ = kEmpty;
+    mutable Factory factory_;
+    mutable SharedPtr<T> value_;
+};
@@ -0,0 +1,104 @@
+#include "shared.h"
+#include "weak.h"
+
+#include <common/arena.h>
+#include <common/my_int.h>
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator(int* live) : live(live) {
+    }
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>& other) : live(other.live) {
+    }
+
+    T* allocate(size_t n) {
+        ++*live;
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t) {
+        --*live;
+        ::operator delete(p);
+    }
+
+    int* live;
+};
+
+TEST_CASE("AllocateShared") {
+    int live = 0;
+    CountingAllocator<int> alloc(&live);
+
+    SECTION("One allocation from the allocator") {
+        {
+            EXPECT_ONE_ALLOCATION(auto sp = AllocateShared<std::string>(alloc, 3, 'x'));
+            auto sp = AllocateShared<std::string>(alloc, "abc");
+            REQUIRE(live == 1);
+            REQUIRE(*sp == "abc");
+            auto copy = sp;
+            REQUIRE(copy.UseCount() == 2);
+        }
+        REQUIRE(live == 0);
+    }
+
+    SECTION("Weak references keep the block") {
+        WeakPtr<MyInt> weak;
+        {
+            auto sp = AllocateShared<MyInt>(alloc, 5);
+            weak = sp;
+            REQUIRE(MyInt::AliveCount() == 1);
+        }
+        REQUIRE(MyInt::AliveCount() == 0);
+        REQUIRE(weak.Expired());
+        REQUIRE(live == 1);
+        weak.Reset();
+        REQUIRE(live == 0);
+    }
+}
+
+TEST_CASE("Huge page arena") {
+    HugePageArena arena;
+
+    SECTION("Objects are bump allocated") {
+        ArenaAllocator<int> alloc(arena);
+        SharedPtr<int> a, b;
+        arena.Allocate(1);  // the first chunk
+        EXPECT_ZERO_ALLOCATIONS(a = AllocateShared<int>(alloc, 1); b = AllocateShared<int>(alloc, 2));
+        REQUIRE(*a + *b == 3);
+        REQUIRE(arena.ChunkCount() == 1);
+        REQUIRE(reinterpret_cast<uintptr_t>(a.Get()) / HugePageArena::kChunkBytes ==
+                reinterpret_cast<uintptr_t>(b.Get()) / HugePageArena::kChunkBytes);
+    }
+
+    SECTION("Large allocations get their own chunks") {
+        void* small = arena.Allocate(16);
+        void* large = arena.Allocate(3 * HugePageArena::kChunkBytes, 64);
+        REQUIRE(small != large);
+        REQUIRE(reinterpret_cast<uintptr_t>(large) % 64 == 0);
+        REQUIRE(arena.ChunkCount() == 2);
+        REQUIRE(arena.HugePageChunkCount() <= arena.ChunkCount());
+    }
+
+    SECTION("Scopes select the default allocator arena") {
+        REQUIRE(&HugePageArena::Current() == &HugePageArena::Default());
+        {
+            ArenaScope scope(arena);
+            REQUIRE(&HugePageArena::Current() == &arena);
+            auto sp = AllocateShared<std::string>(ArenaAllocator<char>(), "in arena");
+            REQUIRE(*sp == "in arena");
+        }
+        REQUIRE(&HugePageArena::Current() == &HugePageArena::Default());
+        REQUIRE(arena.ChunkCount() == 1);
+    }
+}
@@ -0,0 +1,67 @@
+#include "lazy.h"
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("LazySharedPtr constructs on first use") {
+    int calls = 0;
+    LazySharedPtr<std::string> lazy([&calls] {
+        ++calls;
+        return std::string("lookup table");
+    });
+    REQUIRE(!lazy.IsConstructed());
+    REQUIRE(calls == 0);
+
+    REQUIRE(*lazy == "lookup table");
+    REQUIRE(lazy->size() == 12);
+    REQUIRE(lazy.IsConstructed());
+    REQUIRE(calls == 1);
+
+    SharedPtr<std::string> copy = lazy.Get();
+    REQUIRE(copy.UseCount() == 2);
+    REQUIRE(copy.Get() == lazy.Get().Get());
+    REQUIRE(calls == 1);
+}
+
+TEST_CASE("LazySharedPtr retries after a throwing factory") {
+    int calls = 0;
+    LazySharedPtr<int> lazy([&calls] {
+        if (++calls == 1) {
+            throw std::runtime_error("not yet");
+        }
+        return 42;
+    });
+    REQUIRE_THROWS_AS(*lazy, std::runtime_error);
+    REQUIRE(!lazy.IsConstructed());
+    REQUIRE(*lazy == 42);
+    REQUIRE(calls == 2);
+}
+
+TEST_CASE("LazySharedPtr builds once under contention") {
+    std::atomic<int> calls = 0;
+    LazySharedPtr<std::vector<int>> lazy([&calls] {
+        ++calls;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        return std::vector<int>(1000, 7);
+    });
+
+    constexpr int kNumThreads = 8;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> total = 0;
+    for (int i = 0; i < kNumThreads; ++i) {
+        threads.emplace_back([&] { total += lazy->size(); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(calls == 1);
+    REQUIRE(total == kNumThreads * 1000);
+}
@@ -175,3 +175,19 @@ TEST_CASE("Lifetimes") {
         delete wp;
     }
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Prefetch hints") {
+    SharedPtr<int> empty;
+    empty.Prefetch();
+    WeakPtr<int> empty_weak;
+    empty_weak.Prefetch();
+
+    auto sp = MakeShared<int>(42);
+    WeakPtr<int> wp(sp);
+    EXPECT_ZERO_ALLOCATIONS(sp.Prefetch(); sp.Prefetch<PrefetchMode::kWrite>(); wp.Prefetch(););
+    wp.Prefetch<PrefetchMode::kRead, PrefetchLocality::kNone>();
+    REQUIRE(sp.UseCount() == 1);
+    REQUIRE(*wp.Lock() == 42);
+}
@@ -2,9 +2,11 @@
 
 #include "deleters.h"
 
+#include <common/arena.h>
 #include <common/my_int.h>
 
 #include <catch.hpp>
+#include <stdexcept>
 #include <vector>
 #include <tuple>
 
@@ -277,6 +279,16 @@ TEST_CASE("Observers") {
         UniquePtr<A> p(new A);
         REQUIRE(p->i_ == 7);
     }
+
+    SECTION("Prefetch") {
+        UniquePtr<int> p(new int(5));
+        p.Prefetch();
+        p.Prefetch<PrefetchMode::kWrite, PrefetchLocality::kLow>();
+        UniquePtr<int[]> arr(new int[3]{1, 2, 3});
+        arr.Prefetch();
+        REQUIRE(*p == 5);
+        REQUIRE(arr[2] == 3);
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -504,3 +516,64 @@ TEST_CASE("Upcasts") {
         s2 = std::move(s);
     }
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Arena deleter") {
+    HugePageArena arena;
+    int alive_before = MyInt::AliveCount();
+    {
+        UniquePtr<MyInt, ArenaDeleter<MyInt>> p(ArenaNew<MyInt>(arena, 7));
+        UniquePtr<MyInt, ArenaDeleter<MyInt>> q(ArenaNew<MyInt>(arena, 8));
+        REQUIRE(*p == 7);
+        REQUIRE(MyInt::AliveCount() == alive_before + 2);
+        p.Reset(ArenaNew<MyInt>(arena, 9));
+        REQUIRE(*p == 9);
+        REQUIRE(MyInt::AliveCount() == alive_before + 2);
+        static_assert(sizeof(p) == sizeof(void*));
+    }
+    REQUIRE(MyInt::AliveCount() == alive_before);
+    REQUIRE(arena.ChunkCount() == 1);
+}
+
+TEST_CASE("Emplace") {
+    SECTION("Reuses the storage of the same type") {
+        UniquePtr<MyInt> s(new MyInt(1));
+        MyInt* p = s.Get();
+        REQUIRE(s.Emplace(2) == 2);
+        REQUIRE(s.Get() == p);
+        REQUIRE(MyInt::AliveCount() == 1);
+    }
+
+    SECTION("Allocates when empty or of a derived type") {
+        UniquePtr<MyInt> empty;
+        REQUIRE(empty.Emplace(3) == 3);
+        REQUIRE(MyInt::AliveCount() == 1);
+
+        struct Shape {
+            virtual ~Shape() = default;
+        };
+        struct Square : Shape {
+            int side = 1;
+        };
+        UniquePtr<Shape> shape(new Square);
+        Shape* square = shape.Get();
+        shape.Emplace();
+        REQUIRE(dynamic_cast<Square*>(shape.Get()) == nullptr);
+        REQUIRE(shape.Get() != square);
+    }
+
+    SECTION("Throwing constructor leaves the pointer empty") {
+        struct Fragile {
+            Fragile(bool fail) {
+                if (fail) {
+                    throw std::runtime_error("fail");
+                }
+            }
+        };
+        UniquePtr<Fragile> s(new Fragile(false));
+        REQUIRE_THROWS_AS(s.Emplace(true), std::runtime_error);
+        REQUIRE(!s);
+    }
+    REQUIRE(MyInt::AliveCount() == 0);
+}
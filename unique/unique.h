@@ -1,7 +1,11 @@
 #pragma once
 
 #include "compressed_pair.h"
+#include <common/prefetch.h>
 #include <cstddef>
+#include <new>
+#include <type_traits>
+#include <typeinfo>
 
 template <class T>
 class DefaultDeleter {
@@ -109,6 +113,27 @@ public:
         data_.GetSecond()(prev_ptr);
     }
 
+    // Replaces the object with `T(args...)`, reusing its memory when the current
+    // object is exactly a `T`. If the constructor throws, the pointer becomes empty.
+    template <typename... Args>
+    requires std::is_same_v<Deleter, DefaultDeleter<T>>
+    typename std::add_lvalue_reference<T>::type Emplace(Args&&... args) {
+        T* ptr = data_.GetFirst();
+        if (!ptr || !IsExactly(ptr)) {
+            Reset(new T(std::forward<Args>(args)...));
+            return *Get();
+        }
+        ptr->~T();
+        try {
+            new (const_cast<std::remove_cv_t<T>*>(ptr)) T(std::forward<Args>(args)...);
+        } catch (...) {
+            data_.GetFirst() = nullptr;
+            FreeStorage(ptr);
+            throw;
+        }
+        return *ptr;
+    }
+
     void Swap(UniquePtr& other) {
         std::swap(data_, other.data_);
     }
@@ -127,6 +152,12 @@ public:
         return data_.GetFirst();
     }
 
+    // Hints the CPU to start loading the owned object.
+    template <PrefetchMode Mode = PrefetchMode::kRead, PrefetchLocality Locality = PrefetchLocality::kHigh>
+    void Prefetch() const {
+        PrefetchAddress<Mode, Locality>(data_.GetFirst());
+    }
+
     typename std::add_lvalue_reference<T>::type operator*() const {
         return *data_.GetFirst();
     }
@@ -135,6 +166,27 @@ public:
     }
 
 private:
+    // A polymorphic object may be of a derived type with a different size.
+    static bool IsExactly(T* ptr) {
+        if constexpr (std::is_polymorphic_v<T> && !std::is_final_v<T>) {
+            return typeid(*ptr) == typeid(T);
+        } else {
+            return true;
+        }
+    }
+
+    // Frees the memory of `new T` without running the destructor.
+    static void FreeStorage(T* ptr) {
+        void* memory = const_cast<std::remove_cv_t<T>*>(ptr);
+        if constexpr (requires { T::operator delete(memory); }) {
+            T::operator delete(memory);
+        } else if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(memory, std::align_val_t{alignof(T)});
+        } else {
+            ::operator delete(memory);
+        }
+    }
+
     CompressedPair<T*, Deleter> data_;
 };
 
@@ -206,6 +258,12 @@ public:
         return data_.GetFirst();
     }
 
+    // Hints the CPU to start loading the owned object.
+    template <PrefetchMode Mode = PrefetchMode::kRead, PrefetchLocality Locality = PrefetchLocality::kHigh>
+    void Prefetch() const {
+        PrefetchAddress<Mode, Locality>(data_.GetFirst());
+    }
+
     T& operator[](size_t index) const {
         return data_.GetFirst()[index];
     }